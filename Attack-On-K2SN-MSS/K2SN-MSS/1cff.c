@@ -32,52 +32,53 @@ u256 add(u256 a, u256 b);
 u256 sub(u256 a, u256 b);
 u256 binomial(int a, int b);
 void set_binotable();
-void convert_u82u256(u8 *ms);
-int component_key[tb2];
-u256 msg;
-
-
-void convert_u82u256(u8 *ms){
-	msg.v[0]=ms[0];
-	msg.v[0]=msg.v[0]|((u64)ms[1]<<8);
-	msg.v[0]=msg.v[0]|((u64)ms[2]<<16);
-	msg.v[0]=msg.v[0]|((u64)ms[3]<<24);
-	msg.v[0]=msg.v[0]|((u64)ms[4]<<32);
-	msg.v[0]=msg.v[0]|((u64)ms[5]<<40);
-	msg.v[0]=msg.v[0]|((u64)ms[6]<<48);
-	msg.v[0]=msg.v[0]|((u64)ms[7]<<56);
-
-	msg.v[1]=ms[8];
-	msg.v[1]=msg.v[1]|((u64)ms[9]<<8);
-	msg.v[1]=msg.v[1]|((u64)ms[10]<<16);
-	msg.v[1]=msg.v[1]|((u64)ms[11]<<24);
-	msg.v[1]=msg.v[1]|((u64)ms[12]<<32);
-	msg.v[1]=msg.v[1]|((u64)ms[13]<<40);
-	msg.v[1]=msg.v[1]|((u64)ms[14]<<48);
-	msg.v[1]=msg.v[1]|((u64)ms[15]<<56);
-
-	msg.v[2]=ms[16];
-	msg.v[2]=msg.v[2]|((u64)ms[17]<<8);
-	msg.v[2]=msg.v[2]|((u64)ms[18]<<16);
-	msg.v[2]=msg.v[2]|((u64)ms[19]<<24);
-	msg.v[2]=msg.v[2]|((u64)ms[20]<<32);
-	msg.v[2]=msg.v[2]|((u64)ms[21]<<40);
-	msg.v[2]=msg.v[2]|((u64)ms[22]<<48);
-	msg.v[2]=msg.v[2]|((u64)ms[23]<<56);
-
-	msg.v[3]=ms[24];
-	msg.v[3]=msg.v[3]|((u64)ms[25]<<8);
-	msg.v[3]=msg.v[3]|((u64)ms[26]<<16);
-	msg.v[3]=msg.v[3]|((u64)ms[27]<<24);
-	msg.v[3]=msg.v[3]|((u64)ms[28]<<32);
-	msg.v[3]=msg.v[3]|((u64)ms[29]<<40);
-	msg.v[3]=msg.v[3]|((u64)ms[30]<<48);
-	msg.v[3]=msg.v[3]|((u64)ms[31]<<56);
+void convert_u82u256(u8 *ms, u256 *msg);
+void cff(u256 *msg, int component_key[tb2]);
+
+
+// Reads the 32-byte message ms as a little-endian integer into msg
+void convert_u82u256(u8 *ms, u256 *msg){
+	msg->v[0]=ms[0];
+	msg->v[0]=msg->v[0]|((u64)ms[1]<<8);
+	msg->v[0]=msg->v[0]|((u64)ms[2]<<16);
+	msg->v[0]=msg->v[0]|((u64)ms[3]<<24);
+	msg->v[0]=msg->v[0]|((u64)ms[4]<<32);
+	msg->v[0]=msg->v[0]|((u64)ms[5]<<40);
+	msg->v[0]=msg->v[0]|((u64)ms[6]<<48);
+	msg->v[0]=msg->v[0]|((u64)ms[7]<<56);
+
+	msg->v[1]=ms[8];
+	msg->v[1]=msg->v[1]|((u64)ms[9]<<8);
+	msg->v[1]=msg->v[1]|((u64)ms[10]<<16);
+	msg->v[1]=msg->v[1]|((u64)ms[11]<<24);
+	msg->v[1]=msg->v[1]|((u64)ms[12]<<32);
+	msg->v[1]=msg->v[1]|((u64)ms[13]<<40);
+	msg->v[1]=msg->v[1]|((u64)ms[14]<<48);
+	msg->v[1]=msg->v[1]|((u64)ms[15]<<56);
+
+	msg->v[2]=ms[16];
+	msg->v[2]=msg->v[2]|((u64)ms[17]<<8);
+	msg->v[2]=msg->v[2]|((u64)ms[18]<<16);
+	msg->v[2]=msg->v[2]|((u64)ms[19]<<24);
+	msg->v[2]=msg->v[2]|((u64)ms[20]<<32);
+	msg->v[2]=msg->v[2]|((u64)ms[21]<<40);
+	msg->v[2]=msg->v[2]|((u64)ms[22]<<48);
+	msg->v[2]=msg->v[2]|((u64)ms[23]<<56);
+
+	msg->v[3]=ms[24];
+	msg->v[3]=msg->v[3]|((u64)ms[25]<<8);
+	msg->v[3]=msg->v[3]|((u64)ms[26]<<16);
+	msg->v[3]=msg->v[3]|((u64)ms[27]<<24);
+	msg->v[3]=msg->v[3]|((u64)ms[28]<<32);
+	msg->v[3]=msg->v[3]|((u64)ms[29]<<40);
+	msg->v[3]=msg->v[3]|((u64)ms[30]<<48);
+	msg->v[3]=msg->v[3]|((u64)ms[31]<<56);
 	
-	msg.v[4]=0;
+	msg->v[4]=0;
 }
 
-void cff(){
+// Computes the 1-CFF subset of the message integer msg into component_key. Consumes msg.
+void cff(u256 *msg, int component_key[tb2]){
 	
 	u256 temp;
 	u256 m=zero256;
@@ -88,8 +89,8 @@ void cff(){
 	//msg = one256;
 	q = 1;
 	for(int i=1; i<=tb2; i++){
-		while(isgteq(msg,binoTab[t-q][tb2-i])){
-			msg = sub(msg,binoTab[t-q][tb2-i]);
+		while(isgteq(*msg,binoTab[t-q][tb2-i])){
+			*msg = sub(*msg,binoTab[t-q][tb2-i]);
 			q++;
 		}
 		component_key[i-1] = q-1;
@@ -110,7 +111,7 @@ int isgt(u256 a, u256 b){
 int isgteq(u256 a, u256 b){
 	int i=4;
 
-	while((a.v[i]==b.v[i]) && (i>=0))	i--;
+	while((i>=0) && (a.v[i]==b.v[i]))	i--;
 	
 	if(i==-1) return 1;
 	else return (a.v[i]>b.v[i]);
@@ -0,0 +1,125 @@
+/*
+chacha-x8.c
+ChaCha20 on 8 independent keys at once with AVX2. Lane j of every vector
+belongs to the j'th key, so a call produces one block of each of the 8
+keystreams, where chacha.c vectorizes consecutive blocks of a single key.
+Same rounds, state layout and output as chacha.c; include after it.
+*/
+
+#include <immintrin.h>
+
+typedef struct
+{
+  __m256i input[16]; /* word i of the state of key j is lane j of input[i] */
+} ECRYPT_ctx_x8;
+
+#define X8_ROT(a,imm) _mm256_or_si256(_mm256_slli_epi32(a,imm),_mm256_srli_epi32(a,(32-imm)))
+
+#define X8_QUARTERROUND(a,b,c,d) \
+  x[a] = _mm256_add_epi32(x[a],x[b]); x[d] = _mm256_shuffle_epi8(_mm256_xor_si256(x[d],x[a]),rot16); \
+  x[c] = _mm256_add_epi32(x[c],x[d]); x[b] = X8_ROT(_mm256_xor_si256(x[b],x[c]),12); \
+  x[a] = _mm256_add_epi32(x[a],x[b]); x[d] = _mm256_shuffle_epi8(_mm256_xor_si256(x[d],x[a]),rot8); \
+  x[c] = _mm256_add_epi32(x[c],x[d]); x[b] = X8_ROT(_mm256_xor_si256(x[b],x[c]), 7);
+
+/* turns 8 vectors holding word i of every lane into 8 vectors holding
+   words 0..7 of one lane */
+static void transpose_x8(__m256i r[8])
+{
+  __m256i t0, t1, t2, t3, t4, t5, t6, t7;
+  __m256i u0, u1, u2, u3, u4, u5, u6, u7;
+
+  t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+  t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+  t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+  t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+  t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+  t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+  t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+  t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+
+  u0 = _mm256_unpacklo_epi64(t0, t2);
+  u1 = _mm256_unpackhi_epi64(t0, t2);
+  u2 = _mm256_unpacklo_epi64(t1, t3);
+  u3 = _mm256_unpackhi_epi64(t1, t3);
+  u4 = _mm256_unpacklo_epi64(t4, t6);
+  u5 = _mm256_unpackhi_epi64(t4, t6);
+  u6 = _mm256_unpacklo_epi64(t5, t7);
+  u7 = _mm256_unpackhi_epi64(t5, t7);
+
+  r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+  r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+  r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+  r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+  r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+  r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+  r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+  r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+/* 256-bit keys only */
+void ECRYPT_keysetup_x8(ECRYPT_ctx_x8 *x,u8 *k[8])
+{
+  u32 w[8];
+  int i, j;
+
+  for (i = 0;i < 8;++i) {
+    for (j = 0;j < 8;++j) w[j] = U8TO32_LITTLE(k[j] + 4 * i);
+    x->input[4 + i] = _mm256_loadu_si256((__m256i *) w);
+  }
+  for (i = 0;i < 4;++i) x->input[i] = _mm256_set1_epi32(U8TO32_LITTLE(sigma + 4 * i));
+}
+
+void ECRYPT_ivsetup_x8(ECRYPT_ctx_x8 *x,u8 *iv[8])
+{
+  u32 w[8];
+  int i, j;
+
+  x->input[12] = _mm256_setzero_si256();
+  x->input[13] = _mm256_setzero_si256();
+  for (i = 0;i < 2;++i) {
+    for (j = 0;j < 8;++j) w[j] = U8TO32_LITTLE(iv[j] + 4 * i);
+    x->input[14 + i] = _mm256_loadu_si256((__m256i *) w);
+  }
+}
+
+/* moves every lane to the given 64-byte block of its keystream */
+void ECRYPT_seek_x8(ECRYPT_ctx_x8 *x,u32 block)
+{
+  x->input[12] = _mm256_set1_epi32(block);
+  x->input[13] = _mm256_setzero_si256();
+}
+
+/* encrypts the same 64-byte block m under every lane's keystream into c[j],
+   and moves every lane to its next block */
+void ECRYPT_encrypt_block_x8(ECRYPT_ctx_x8 *x_,const u8 *m,u8 *c[8])
+{
+  const __m256i rot16 = _mm256_set_epi8(13,12,15,14,9,8,11,10,5,4,7,6,1,0,3,2,13,12,15,14,9,8,11,10,5,4,7,6,1,0,3,2);
+  const __m256i rot8  = _mm256_set_epi8(14,13,12,15,10,9,8,11,6,5,4,7,2,1,0,3,14,13,12,15,10,9,8,11,6,5,4,7,2,1,0,3);
+  __m256i x[16];
+  __m256i m_lo = _mm256_loadu_si256((__m256i *) m);
+  __m256i m_hi = _mm256_loadu_si256((__m256i *) (m + 32));
+  int i;
+
+  for (i = 0;i < 16;++i) x[i] = x_->input[i];
+  for (i = ROUNDS;i > 0;i -= 2) {
+    X8_QUARTERROUND( 0, 4, 8,12)
+    X8_QUARTERROUND( 1, 5, 9,13)
+    X8_QUARTERROUND( 2, 6,10,14)
+    X8_QUARTERROUND( 3, 7,11,15)
+    X8_QUARTERROUND( 0, 5,10,15)
+    X8_QUARTERROUND( 1, 6,11,12)
+    X8_QUARTERROUND( 2, 7, 8,13)
+    X8_QUARTERROUND( 3, 4, 9,14)
+  }
+  for (i = 0;i < 16;++i) x[i] = _mm256_add_epi32(x[i], x_->input[i]);
+
+  /* blocks stay below 2^32, so the high counter word never changes */
+  x_->input[12] = _mm256_add_epi32(x_->input[12], _mm256_set1_epi32(1));
+
+  transpose_x8(x);
+  transpose_x8(x + 8);
+  for (i = 0;i < 8;++i) {
+    _mm256_storeu_si256((__m256i *) c[i], _mm256_xor_si256(x[i], m_lo));
+    _mm256_storeu_si256((__m256i *) (c[i] + 32), _mm256_xor_si256(x[8 + i], m_hi));
+  }
+}
@@ -0,0 +1,166 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "keypair-file.h"
+
+//Size of a record of a keypair file, with the leaves if it has them
+static u64 keypair_file_record_size(int has_leaves){
+	return sizeof(keypair_record) + (has_leaves ? (u64)usr * sizeof(node) : 0);
+}
+
+// Writes the header of a keypair file. Must be followed by num_keypairs calls to
+// keypair_file_write_record.
+// Params:
+//  FILE *f: file to write, opened in binary mode
+//  u32 num_keypairs: number of keypairs the file will hold
+//  int has_leaves: 1 if every record will be written with the leaves of its tree, 0 otherwise
+// Return: 1 on success, negative number otherwise
+int keypair_file_write_header(FILE *f, u32 num_keypairs, int has_leaves){
+	u8 buf[KEYPAIR_FILE_HEADER_SIZE] = {0};
+	keypair_file_header header;
+
+	memcpy(header.magic, KEYPAIR_FILE_MAGIC, sizeof(header.magic));
+	header.tree_height = h;
+	header.public_key_length = pklen;
+	header.num_keypairs = num_keypairs;
+	header.has_leaves = has_leaves ? 1 : 0;
+	header.record_size = keypair_file_record_size(has_leaves);
+	memcpy(buf, &header, sizeof(header));
+
+	if(fwrite(buf, KEYPAIR_FILE_HEADER_SIZE, 1, f) != 1) return -1;
+	return 1;
+}
+
+// Appends a keypair to a keypair file
+// Params:
+//  FILE *f: file whose header has been written
+//  const k2sn_ctx *ctx: keypair as left by key_generation
+//  const node *leaves: the usr leaves of the keypair, as filled by key_generation. Must be NULL if
+//    and only if the file has no leaves
+// Return: 1 on success, negative number otherwise
+int keypair_file_write_record(FILE *f, const k2sn_ctx *ctx, const node *leaves){
+	keypair_record record;
+
+	//Zero the padding so that files are reproducible
+	memset(&record, 0, sizeof(record));
+	record.chopped_key_size = ctx->chopped_key_size;
+	memcpy(record.system_seed, ctx->system_seed, seedlen);
+	memcpy(record.system_iv, ctx->system_iv, ivlen);
+	memcpy(record.randompad_seed, ctx->randompad_seed, seedlen);
+	memcpy(record.randompad_iv, ctx->randompad_iv, ivlen);
+	memcpy(record.hk_seed, ctx->hk_seed, seedlen);
+	memcpy(record.hk_iv, ctx->hk_iv, ivlen);
+	memcpy(record.auth, ctx->auth, sizeof(record.auth));
+	memcpy(record.keep, ctx->keep, sizeof(record.keep));
+	record.retain = ctx->retain;
+	memcpy(record.instance, ctx->instance, sizeof(record.instance));
+	record.MSSPK = ctx->MSSPK;
+
+	if(fwrite(&record, sizeof(record), 1, f) != 1) return -1;
+	if(leaves != NULL && fwrite(leaves, sizeof(node), usr, f) != usr) return -1;
+	return 1;
+}
+
+// Maps a keypair file into memory and checks that it was written for this build
+// Params:
+//  keypair_file *kf: filled with the mapping
+//  const char *path: path of the keypair file
+// Return: 1 on success, negative number otherwise. An error message is printed on failure
+int keypair_file_open(keypair_file *kf, const char *path){
+	struct stat st;
+	const keypair_file_header *header;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if(fd < 0){
+		perror(path);
+		return -1;
+	}
+	if(fstat(fd, &st) < 0){
+		perror(path);
+		close(fd);
+		return -1;
+	}
+	if(st.st_size < KEYPAIR_FILE_HEADER_SIZE){
+		fprintf(stderr, "%s: not a keypair file\n", path);
+		close(fd);
+		return -1;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED){
+		perror(path);
+		return -1;
+	}
+
+	header = map;
+	if(memcmp(header->magic, KEYPAIR_FILE_MAGIC, sizeof(header->magic)) != 0){
+		fprintf(stderr, "%s: not a keypair file\n", path);
+		munmap(map, st.st_size);
+		return -1;
+	}
+	if(header->tree_height != h || header->public_key_length != pklen ||
+	     header->record_size != keypair_file_record_size(header->has_leaves)){
+		fprintf(stderr, "%s: keypair file was written for different parameters\n", path);
+		munmap(map, st.st_size);
+		return -1;
+	}
+	if((u64)st.st_size < KEYPAIR_FILE_HEADER_SIZE + header->num_keypairs * header->record_size){
+		fprintf(stderr, "%s: keypair file is truncated\n", path);
+		munmap(map, st.st_size);
+		return -1;
+	}
+
+	kf->header = header;
+	kf->records = (const u8 *)map + KEYPAIR_FILE_HEADER_SIZE;
+	kf->map_size = st.st_size;
+	return 1;
+}
+
+// Unmaps a keypair file
+// Params:
+//  keypair_file *kf: file opened by keypair_file_open
+void keypair_file_close(keypair_file *kf){
+	munmap((void *)kf->header, kf->map_size);
+	kf->header = NULL;
+	kf->records = NULL;
+}
+
+// Loads a stored keypair into a context and precomputes what is derived from its seeds, so that
+// ctx signs exactly as it would have after key_generation. The 1-CFF state and gSWIFFT key of ctx
+// are left untouched.
+// Params:
+//  const keypair_file *kf: open keypair file
+//  u32 index: index of the keypair in the file. Must be less than kf->header->num_keypairs
+//  k2sn_ctx *ctx: filled with the keypair
+void keypair_file_load(const keypair_file *kf, u32 index, k2sn_ctx *ctx){
+	const keypair_record *record = (const keypair_record *)(kf->records + index * kf->header->record_size);
+
+	ctx->chopped_key_size = record->chopped_key_size;
+	memcpy(ctx->system_seed, record->system_seed, seedlen);
+	memcpy(ctx->system_iv, record->system_iv, ivlen);
+	memcpy(ctx->randompad_seed, record->randompad_seed, seedlen);
+	memcpy(ctx->randompad_iv, record->randompad_iv, ivlen);
+	memcpy(ctx->hk_seed, record->hk_seed, seedlen);
+	memcpy(ctx->hk_iv, record->hk_iv, ivlen);
+	memcpy(ctx->auth, record->auth, sizeof(ctx->auth));
+	memcpy(ctx->keep, record->keep, sizeof(ctx->keep));
+	ctx->retain = record->retain;
+	memcpy(ctx->instance, record->instance, sizeof(ctx->instance));
+	ctx->MSSPK = record->MSSPK;
+
+	ksnmss_setup(ctx);
+}
+
+// Returns the stored leaves of a keypair, which point into the mapping and stay valid until the
+// file is closed
+// Params:
+//  const keypair_file *kf: open keypair file
+//  u32 index: index of the keypair in the file
+// Return: the usr leaves of the keypair, or NULL if the file has no leaves
+const node *keypair_file_leaves(const keypair_file *kf, u32 index){
+	if(!kf->header->has_leaves) return NULL;
+	return (const node *)(kf->records + index * kf->header->record_size + sizeof(keypair_record));
+}
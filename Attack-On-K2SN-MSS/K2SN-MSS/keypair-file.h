@@ -0,0 +1,95 @@
+#ifndef KEYPAIR_FILE_H_
+#define KEYPAIR_FILE_H_
+
+
+#include "ksnmss.h"
+
+#define KEYPAIR_FILE_MAGIC "K2SNKEYS"
+//Size of the header of a keypair file. The records that follow it start at this offset
+#define KEYPAIR_FILE_HEADER_SIZE 64
+
+// Header of a keypair file. A keypair file holds num_keypairs records of record_size bytes each,
+// in the byte order and struct layout of the machine that wrote it. The parameters of the build are
+// stored so that a file is only loaded by builds it was written for.
+typedef struct keypair_file_header{
+	char magic[8];
+	u32 tree_height;
+	u32 public_key_length;
+	u32 num_keypairs;
+	//1 if the leaves of every keypair are stored after its record
+	u32 has_leaves;
+	u64 record_size;
+}keypair_file_header;
+
+// A stored keypair: its seeds and the signer state key_generation leaves it with. What ksnmss_setup
+// derives from the seeds is recomputed when the keypair is loaded. If the file has leaves, the
+// record is followed by the usr leaves of the tree, indexed by instance id.
+typedef struct keypair_record{
+	int chopped_key_size;
+	u8 system_seed[seedlen];
+	u8 system_iv[ivlen];
+	u8 randompad_seed[seedlen];
+	u8 randompad_iv[ivlen];
+	u8 hk_seed[seedlen];
+	u8 hk_iv[ivlen];
+	node auth[h];
+	node keep[h-1];
+	node retain;
+	treehash instance[h-2];
+	node MSSPK;
+}keypair_record;
+
+// A keypair file mapped read-only into memory
+typedef struct keypair_file{
+	const keypair_file_header *header;
+	const u8 *records;
+	size_t map_size;
+}keypair_file;
+
+// Writes the header of a keypair file. Must be followed by num_keypairs calls to
+// keypair_file_write_record.
+// Params:
+//  FILE *f: file to write, opened in binary mode
+//  u32 num_keypairs: number of keypairs the file will hold
+//  int has_leaves: 1 if every record will be written with the leaves of its tree, 0 otherwise
+// Return: 1 on success, negative number otherwise
+int keypair_file_write_header(FILE *f, u32 num_keypairs, int has_leaves);
+
+// Appends a keypair to a keypair file
+// Params:
+//  FILE *f: file whose header has been written
+//  const k2sn_ctx *ctx: keypair as left by key_generation
+//  const node *leaves: the usr leaves of the keypair, as filled by key_generation. Must be NULL if 
+//    and only if the file has no leaves
+// Return: 1 on success, negative number otherwise
+int keypair_file_write_record(FILE *f, const k2sn_ctx *ctx, const node *leaves);
+
+// Maps a keypair file into memory and checks that it was written for this build
+// Params:
+//  keypair_file *kf: filled with the mapping
+//  const char *path: path of the keypair file
+// Return: 1 on success, negative number otherwise. An error message is printed on failure
+int keypair_file_open(keypair_file *kf, const char *path);
+
+// Unmaps a keypair file
+// Params:
+//  keypair_file *kf: file opened by keypair_file_open
+void keypair_file_close(keypair_file *kf);
+
+// Loads a stored keypair into a context and precomputes what is derived from its seeds, so that
+// ctx signs exactly as it would have after key_generation. The 1-CFF state and gSWIFFT key of ctx
+// are left untouched.
+// Params:
+//  const keypair_file *kf: open keypair file
+//  u32 index: index of the keypair in the file. Must be less than kf->header->num_keypairs
+//  k2sn_ctx *ctx: filled with the keypair
+void keypair_file_load(const keypair_file *kf, u32 index, k2sn_ctx *ctx);
+
+// Returns the stored leaves of a keypair, which point into the mapping and stay valid until the
+// file is closed
+// Params:
+//  const keypair_file *kf: open keypair file
+//  u32 index: index of the keypair in the file
+// Return: the usr leaves of the keypair, or NULL if the file has no leaves
+const node *keypair_file_leaves(const keypair_file *kf, u32 index);
+#endif
@@ -56,15 +56,73 @@ void chop(u8 *ots_key, int num_remaining_bits) {
 }
 
 
+// Adds up the selected component keys bit by bit: coefficient 8*i+j of the sum counts the keys 
+// whose byte i has bit j set. The sum is written as 16-bit coefficients in the layout gSWIFFT_vec 
+// takes, where lane m of vector v holds coefficient 16*v+m, i.e. bits 0..15 of the 16-bit word at 
+// byte 2*v of each key. Eight vectors of the sum are kept in registers while all keys are added.
+// Params:
+//  u8 *keys[tb2]: the selected component keys. Each is an array of length sklen
+//  vec X[16][4]: filled with the sum
+void sksum_accumulate(u8 *keys[tb2], vec X[16][4]){
+	const vec bit = _mm256_setr_epi16(0x0001,0x0002,0x0004,0x0008,0x0010,0x0020,0x0040,0x0080,
+	                                  0x0100,0x0200,0x0400,0x0800,0x1000,0x2000,0x4000,(short)0x8000);
+	vec *sum = &X[0][0];
+	vec acc[8], b;
+	u16 w;
+	int v,le,r;
+
+	for(v=0;v<64;v+=8){
+		for(r=0;r<8;r++) acc[r] = _mm256_setzero_si256();
+		for(le=0;le<tb2;le++){
+			for(r=0;r<8;r++){
+				memcpy(&w, keys[le]+2*(v+r), 2);
+				b = _mm256_and_si256(_mm256_set1_epi16(w), bit);
+				//Lanes with their bit set compare to -1, so subtracting adds 1
+				acc[r] = _mm256_sub_epi16(acc[r], _mm256_cmpeq_epi16(b, bit));
+			}
+		}
+		for(r=0;r<8;r++) sum[v+r] = acc[r];
+	}
+}
+
+// Narrows a sum computed by sksum_accumulate to the byte per coefficient of a KSN-OTS signature
+// Params:
+//  vec X[16][4]: sum of component keys
+//  u8 *sksum: Pointer to array which will be filled with signature. Assumes lenght of *sksum is (sklen * 8)
+void sksum_pack(vec X[16][4], u8 *sksum){
+	vec *sum = &X[0][0];
+	vec p;
+	int v;
+
+	for(v=0;v<64;v+=2){
+		//packus interleaves the 128-bit halves of its inputs, the permute restores the order
+		p = _mm256_packus_epi16(sum[v], sum[v+1]);
+		p = _mm256_permute4x64_epi64(p, 0xD8);
+		_mm256_storeu_si256((vec *) (sksum+16*v), p);
+	}
+}
+
+// Widens a KSN-OTS signature to the layout gSWIFFT_vec takes
+// Params:
+//  const u8 *sksum: KSN-OTS signature. Assumes lenght of *sksum is (sklen * 8)
+//  vec X[16][4]: filled with the coefficients of sksum
+void sksum_unpack(const u8 *sksum, vec X[16][4]){
+	vec *sum = &X[0][0];
+	int v;
+
+	for(v=0;v<64;v++){
+		sum[v] = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (sksum+16*v)));
+	}
+}
+
 // Computes KSN-OTS signature
 // Params:
 //  u8 *OTS_sk: secret OTS key. Assumes this is an array of length seedlen
 //  u8 *ms:	message to sign
 //  u8 *OTS_signature: Pointer to array which will be filled with signature. Assumes lenght of *sksum is (sklen * 8)
-void KSNOTS_sign(u8 *OTS_sk, u8 *ms, u8 *OTS_signature){
-	int i,j,k,le;
+void KSNOTS_sign(k2sn_ctx *ctx, u8 *OTS_sk, u8 *ms, u8 *OTS_signature){
+	int i,le;
 	sk_node OTS_component_sk[t];
-	u8 temp;
 
 	//Compute set of secret component keys from OTS secret key
 	//Initialize chacha with OTS secret key
@@ -95,39 +153,139 @@ void KSNOTS_sign(u8 *OTS_sk, u8 *ms, u8 *OTS_signature){
 	}
 
 	//Generate subset of component keys based on message
-	convert_u82u256(ms);
-	cff();
+	convert_u82u256(ms, &ctx->msg);
+	cff(&ctx->msg, ctx->component_key);
 
 	// print_sk_node(&OTS_component_sk[component_key[0] % 0x100], "In KSN-OTS Signing function, (first) component key is:");
 	// print_u32(component_key, 131, "In KSN-OTS Signing function, just before signing component_key[] is");
 
 	//Compute signature of message
 	u8 sksum[sklen*8];
-	for (int r = 0; r < sklen*8; r++) {
-		sksum[r] = 0;
-	}
-	// print_bytes(sksum, sklen*8, "In KSN-OTS Signign function, just BEFORE signature computation sksum is");
-	k=0;
-	for(i=0;i<sklen;i++){
-		temp=1;
-		for(j=0;j<8;j++){
-			sksum[k]=(u8)(((OTS_component_sk[component_key[0] % 0x100].key[i])&temp)>>j);
-			k++; temp=temp<<1;
+	u8 *selected_sk[tb2];
+	vec X[16][4];
+	for(le=0;le<tb2;le++){
+		selected_sk[le] = OTS_component_sk[ctx->component_key[le] % 0x100].key;
+	}
+	sksum_accumulate(selected_sk, X);
+	sksum_pack(X, sksum);
+
+	// print_bytes(sksum, sklen*8, "In KSN-OTS Signign function, just AFTER signature computation sksum is");
+	memcpy(OTS_signature, sksum, sklen*8);
+}
+
+// Computes the 1-CFF subset of a message for KSNOTS_sign_fixed
+// Params:
+//  u8 *ms: message to sign
+//  ksnots_fixed_msg *fixed_ms: filled with the components selected by ms
+void KSNOTS_fix_message(k2sn_ctx *ctx, u8 *ms, ksnots_fixed_msg *fixed_ms){
+	int le;
+
+	convert_u82u256(ms, &ctx->msg);
+	cff(&ctx->msg, ctx->component_key);
+	for(le=0;le<tb2;le++){
+		fixed_ms->component[le] = ctx->component_key[le] % 0x100;
+	}
+}
+
+// Computes the same KSN-OTS signature as KSNOTS_sign, for a message prepared by 
+// KSNOTS_fix_message. Only the selected component keys are generated, by seeking the ChaCha block 
+// counter to each of them.
+// Params:
+//  u8 *OTS_sk: secret OTS key. Assumes this is an array of length seedlen
+//  const ksnots_fixed_msg *fixed_ms: message to sign
+//  u8 *OTS_signature: Pointer to array which will be filled with signature. Assumes lenght of *sksum is (sklen * 8)
+void KSNOTS_sign_fixed(u8 *OTS_sk, const ksnots_fixed_msg *fixed_ms, u8 *OTS_signature){
+	int le,c;
+	sk_node component_sk[tb2];
+	u8 *selected_sk[tb2];
+	vec X[16][4];
+	ECRYPT_ctx OTS_seed_ctx;
+	u8 component_id[sklen];
+
+	ECRYPT_keysetup(&OTS_seed_ctx,OTS_sk,256,64);
+	ECRYPT_ivsetup(&OTS_seed_ctx,OTS_sk);
+
+	memset(component_id, 0, sklen);
+	for(le=0;le<tb2;le++){
+		c = fixed_ms->component[le];
+
+		//Component key c is the id of component c encrypted with the two ChaCha blocks at 
+		//  128*c bytes into the keystream, see KSNOTS_sign
+		if(c<255){
+			component_id[0]=c+1;
+			component_id[1]=0;
+		}else{
+			component_id[0]=c-255;
+			component_id[1]=1;
 		}
+		OTS_seed_ctx.input[12] = 2*c;
+		OTS_seed_ctx.input[13] = 0;
+		ECRYPT_encrypt_bytes(&OTS_seed_ctx,component_id,component_sk[le].key,sklen);
+		selected_sk[le] = component_sk[le].key;
 	}
-	for(le=1;le<tb2;le++){
-		k=0;
-		for(i=0;i<sklen;i++){
-			temp=1;
-			for(j=0;j<8;j++){
-				sksum[k]=sksum[k]+(u8)(((OTS_component_sk[component_key[le] % 0x100].key[i])&temp)>>j);
-				k++; temp=temp<<1;
-			}
+
+	sksum_accumulate(selected_sk, X);
+	sksum_pack(X, OTS_signature);
+}
+
+// Computes KSNOTS_sign_fixed for 8 secret OTS keys at once, generating their component keys with 
+// the 8-key ChaCha20 of chacha-x8.c
+// Params:
+//  u8 *OTS_sk[8]: secret OTS keys. Assumes each is an array of length seedlen
+//  const ksnots_fixed_msg *fixed_ms: message to sign
+//  u8 *OTS_signature[8]: Pointers to arrays which will be filled with the signature under each key. Assumes lenght of each is (sklen * 8)
+void KSNOTS_sign_x8(u8 *OTS_sk[8], const ksnots_fixed_msg *fixed_ms, u8 *OTS_signature[8]){
+	int le,c,lane;
+	sk_node component_sk[8][tb2];
+	u8 *component_sk_half[8];
+	u8 *selected_sk[tb2];
+	vec X[16][4];
+	ECRYPT_ctx_x8 OTS_seed_ctx;
+	u8 component_id[sklen];
+
+	ECRYPT_keysetup_x8(&OTS_seed_ctx,OTS_sk);
+	ECRYPT_ivsetup_x8(&OTS_seed_ctx,OTS_sk);
+
+	memset(component_id, 0, sklen);
+	for(le=0;le<tb2;le++){
+		c = fixed_ms->component[le];
+		if(c<255){
+			component_id[0]=c+1;
+			component_id[1]=0;
+		}else{
+			component_id[0]=c-255;
+			component_id[1]=1;
 		}
+
+		//Both ChaCha blocks of component c, for every key
+		ECRYPT_seek_x8(&OTS_seed_ctx,2*c);
+		for(lane=0;lane<8;lane++) component_sk_half[lane] = component_sk[lane][le].key;
+		ECRYPT_encrypt_block_x8(&OTS_seed_ctx,component_id,component_sk_half);
+		for(lane=0;lane<8;lane++) component_sk_half[lane] = component_sk[lane][le].key + 64;
+		ECRYPT_encrypt_block_x8(&OTS_seed_ctx,component_id + 64,component_sk_half);
 	}
 
-	// print_bytes(sksum, sklen*8, "In KSN-OTS Signign function, just AFTER signature computation sksum is");
-	memcpy(OTS_signature, sksum, sklen*8);
+	for(lane=0;lane<8;lane++){
+		for(le=0;le<tb2;le++) selected_sk[le] = component_sk[lane][le].key;
+		sksum_accumulate(selected_sk, X);
+		sksum_pack(X, OTS_signature[lane]);
+	}
+}
+
+// Computes the 64-bit fingerprint of a KSN-OTS signature. Never returns 0.
+// Params:
+//  const u8 *sksum: KSN-OTS signature. Assumes length of *sksum is (sklen * 8)
+// Return: fingerprint of sksum
+u64 sksum_fingerprint(const u8 *sksum){
+	u64 word;
+	u64 fingerprint = 0x9E3779B97F4A7C15ULL;
+
+	for (int i = 0; i < sklen * 8; i += 8) {
+		memcpy(&word, sksum + i, 8);
+		fingerprint = (fingerprint ^ word) * 0xFF51AFD7ED558CCDULL;
+		fingerprint ^= fingerprint >> 32;
+	}
+	return fingerprint ? fingerprint : 1;
 }
 
 // Verifies KSN-OTS signature
@@ -137,9 +295,9 @@ void KSNOTS_sign(u8 *OTS_sk, u8 *ms, u8 *OTS_signature){
 //  u8 *OTS_signature: Pointer to array which will be filled with signature. Assumes lenght of *sksum is (sklen * 8)
 //  u32 instance_index: index of KSN-OTS instance used to verify signature - used to compute the gSWIFFT key
 // Return: 1 if signature is valid, negative number otherwise
-int KSNOTS_verify(node *OTS_pk, u8 *ms, u8 *OTS_signature, u32 instance_index) {
+int KSNOTS_verify(k2sn_ctx *ctx, node *OTS_pk, u8 *ms, u8 *OTS_signature, u32 instance_index) {
 	int 	i,j,le;
-	int 	x[16][64];
+	vec 	X[16][4];
 	u8 	idu8[seedlen];
 	u32 	pksum[rglen];
 	rg_elm 	sum,temp;
@@ -153,20 +311,18 @@ int KSNOTS_verify(node *OTS_pk, u8 *ms, u8 *OTS_signature, u32 instance_index) {
 	}
 
 	//Create 1-cff set associated with message ms
-	convert_u82u256(ms);
-	cff();
+	convert_u82u256(ms, &ctx->msg);
+	cff(&ctx->msg, ctx->component_key);
 
 	//Hash signature using gSWIFFT_A, where A is the swifft key of the instance_index'th K2SN-MSS instance
-	for(i=0;i<16;i++){
-		for(j=0;j<64;j++) x[i][j] = OTS_signature[i*64+j];
-	}
-	set_Key(instance_index, 0);
-	gSWIFFT(x,A,pksum);
+	sksum_unpack(OTS_signature, X);
+	set_Key(&ctx->hash_key,instance_index, 0,ctx->A);
+	gSWIFFT_vec(X,ctx->A,pksum);
 
 	//Convert public key so it can be compared with hashed signature
-	convert_ring((OTS_pk[component_key[0] % 0x100]).key,&sum);
+	convert_ring((OTS_pk[ctx->component_key[0] % 0x100]).key,&sum);
 	for(le=1;le<tb2;le++){
-		convert_ring((OTS_pk[component_key[le] % 0x100]).key,&temp);
+		convert_ring((OTS_pk[ctx->component_key[le] % 0x100]).key,&temp);
 		for(i=0;i<rglen;i++){
 			sum.key[i] = sum.key[i]+temp.key[i];
 		}
@@ -186,80 +342,170 @@ int KSNOTS_verify(node *OTS_pk, u8 *ms, u8 *OTS_signature, u32 instance_index) {
 
 
 
-void key_generation(u8 *system_seed, u8 *system_iv){
-	u32	id_t,id;
-	int j;
+// Precomputes what the functions of a keypair derive from its seeds. Must be called once the seeds
+// of ctx are set, before ctx is used; key_generation calls it.
+// Params:
+//  k2sn_ctx *ctx: keypair whose seeds are set
+void ksnmss_setup(k2sn_ctx *ctx){
+	ECRYPT_ctx seed_ctx;
+	u8 zero_bytes[sklen];
+
+	swifft_key_setup(&ctx->hash_key, ctx->hk_seed, ctx->hk_iv);
+
+	memset(zero_bytes, 0, sklen);
+	ECRYPT_keysetup(&seed_ctx,ctx->randompad_seed,256,64);
+	ECRYPT_ivsetup(&seed_ctx,ctx->randompad_iv);
+	ECRYPT_encrypt_bytes(&seed_ctx,zero_bytes,ctx->randompad_keystream,sklen);
+}
+
+// Computes the leaf of the id'th K2SN-MSS instance: the root of the L-tree of its public OTS key
+static node keygen_leaf(k2sn_ctx *ctx, u32 id){
+	u32	id_t;
 	u8 	idu8[seedlen]={0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0};
 	sk_node sk[t];
 	node	pk[t];
-	node	leaf;
+	ECRYPT_ctx seed_ctx;
+
+	id_t=id;
+	idu8[0] = (u8)(id_t & 0xFF);	id_t = id_t >> 8;
+	idu8[1] = (u8)(id_t & 0xFF);	id_t = id_t >> 8;
+	idu8[2] = (u8)(id_t & 0xFF);	id_t = id_t >> 8;
+	idu8[3] = (u8)(id_t & 0xFF);
+	ECRYPT_keysetup(&seed_ctx,ctx->system_seed,256,64);
+	ECRYPT_ivsetup(&seed_ctx,ctx->system_iv);
+	generate_secret_key_OTS(ctx, &seed_ctx, idu8, sk);
+	set_Key(&ctx->hash_key,id,0,ctx->A);
+	generate_public_key_OTS(sk, pk, ctx->A);
+	return create_L_tree(ctx,pk,id);
+}
+
+// Computes the node at (indx, height) of the tree from its children, which are at height-1
+static void hash_node_pair(k2sn_ctx *ctx, const u8 *left, const u8 *right, u32 indx, u32 height, 
+                           u8 *parent){
+	int j;
 	sk_node	temp;
 	int xbyte[16][4];
-	mssnode treestack[h+1];
-	mssnode nodestack;
-	int 	top=-1;
 	u8	rdp[sklen];
-	ECRYPT_ctx seed_ctx;
-	ECRYPT_keysetup(&seed_ctx,system_seed,256,64);
-	ECRYPT_ivsetup(&seed_ctx,system_iv);
-
-	for(id=0;id<usr;id++){
-		id_t=id;
-		idu8[0] = (u8)(id_t & 0xFF);	id_t = id_t >> 8;
-		idu8[1] = (u8)(id_t & 0xFF);	id_t = id_t >> 8;
-		idu8[2] = (u8)(id_t & 0xFF);	id_t = id_t >> 8;
-		idu8[3] = (u8)(id_t & 0xFF);
-		ECRYPT_keysetup(&seed_ctx,system_seed,256,64);
-		ECRYPT_ivsetup(&seed_ctx,system_iv);
-		generate_secret_key_OTS(&seed_ctx, idu8, sk);
-		set_Key(id,0);
-		generate_public_key_OTS(sk, pk, A);
-		leaf = create_L_tree(pk,id);
-		memcpy(nodestack.key, leaf.key,pklen);
-		nodestack.height = 0;
-		nodestack.indx = id;
-
-		while((top!=-1) && (treestack[top].height==nodestack.height)){
-			if (nodestack.indx == 1)
-				memcpy(auth[nodestack.height].key, nodestack.key,pklen);
-
-			if (nodestack.indx == 3){
-				if(nodestack.height < (h-2)){
-					memcpy((instance[nodestack.height].v).key, nodestack.key,pklen);
-					instance[nodestack.height].finalized = 1;
-					instance[nodestack.height].lowheight = infy;
-					instance[nodestack.height].top = -1;
-				}else if (nodestack.height == (h-2)){
-					memcpy(retain.key, nodestack.key,pklen);
-				}
+
+	set_random_pad(ctx,indx,height+l,rdp);
+	memcpy(temp.key, left,pklen);
+	for(j=0;j<merlen;j++) 
+		temp.key[pklen-merlen+j] = temp.key[pklen-merlen+j] ^ right[j];
+	memcpy(temp.key+pklen, right+merlen,pklen-merlen);
+	for(j=0;j<sklen;j++) temp.key[j] = temp.key[j] ^ rdp[j];
+	parse(xbyte, temp.key);
+	set_Key(&ctx->hash_key,indx,height+l,ctx->A);
+	SWIFFT(xbyte,ctx->A,parent);
+}
+
+// Pushes a node onto a treehash stack, merging it with the nodes of the same height on top of it.
+// The nodes of the signer's initial BDS state are recorded in keypair as they are merged: auth 
+// takes the node with index 1 at every height, instance and retain the node with index 3. Nodes 
+// are hashed with the gSWIFFT key scratch of ctx, which may be a copy of keypair.
+static void keygen_push(k2sn_ctx *ctx, k2sn_ctx *keypair, mssnode *treestack, int *top, 
+                        mssnode nodestack){
+	while((*top!=-1) && (treestack[*top].height==nodestack.height)){
+		if (nodestack.indx == 1)
+			memcpy(keypair->auth[nodestack.height].key, nodestack.key,pklen);
+
+		if (nodestack.indx == 3){
+			if(nodestack.height < (h-2)){
+				memcpy((keypair->instance[nodestack.height].v).key, nodestack.key,pklen);
+				keypair->instance[nodestack.height].finalized = 1;
+				keypair->instance[nodestack.height].lowheight = infy;
+				keypair->instance[nodestack.height].top = -1;
+			}else if (nodestack.height == (h-2)){
+				memcpy(keypair->retain.key, nodestack.key,pklen);
 			}
-			set_random_pad(nodestack.indx/2,nodestack.height+l+1,rdp);
-			memcpy(temp.key, treestack[top].key,pklen);
-			for(j=0;j<merlen;j++) 
-				temp.key[pklen-merlen+j] = temp.key[pklen-merlen+j] ^ nodestack.key[j];
-			memcpy(temp.key+pklen, nodestack.key+merlen,pklen-merlen);
-			for(j=0;j<sklen;j++) temp.key[j] = temp.key[j] ^ rdp[j];
-			parse(xbyte, temp.key);
-			set_Key(nodestack.indx/2,nodestack.height+l+1);
-			SWIFFT(xbyte,A,nodestack.key);
-			nodestack.height++;
-			nodestack.indx = nodestack.indx/2;
-			top --;
+		}
+		hash_node_pair(ctx, treestack[*top].key, nodestack.key, nodestack.indx/2, 
+		               nodestack.height+1, nodestack.key);
+		nodestack.height++;
+		nodestack.indx = nodestack.indx/2;
+		(*top)--;
+	}
+	(*top)++;
+	treestack[*top] = nodestack;
+}
 
-			
+// Key generation worker. Claims subtrees until none are left, and computes each one's root on a 
+// treehash stack of its own, hashing with its own copy of the keypair.
+void *keygen_worker_run(void *arg){
+	keygen_worker *worker = arg;
+	keygen_job *job = worker->job;
+	const u32 width = usr >> KEYGEN_LOG_SUBTREES;
+	mssnode treestack[h+1];
+	mssnode nodestack;
+	int top;
+	u32 subtree, id;
+
+	pthread_mutex_lock(&job->lock);
+	while(job->next_subtree < (1 << KEYGEN_LOG_SUBTREES)){
+		subtree = job->next_subtree++;
+		pthread_mutex_unlock(&job->lock);
+
+		top = -1;
+		for(id=subtree*width;id<(subtree+1)*width;id++){
+			nodestack.height = 0;
+			nodestack.indx = id;
+			memcpy(nodestack.key, keygen_leaf(&worker->ctx, id).key, pklen);
+			if(job->leaves != NULL) memcpy(job->leaves[id].key, nodestack.key, pklen);
+			keygen_push(&worker->ctx, job->keypair, treestack, &top, nodestack);
 		}
-		top++;
-		treestack[top] = nodestack;
-	}	
+		job->roots[subtree] = treestack[0];
 
-	memcpy(MSSPK.key,treestack[top].key,pklen);	
-	
-		
+		pthread_mutex_lock(&job->lock);
+	}
+	pthread_mutex_unlock(&job->lock);
+
+	return NULL;
+}
+
+// Generates the keypair of ctx from its seeds and sets up the signer for instance 0. The tree is 
+// split into 2^KEYGEN_LOG_SUBTREES subtrees, which num_threads workers compute in parallel; their 
+// roots are then merged on the calling thread. If leaves is not NULL, the leaves are stored in it.
+void key_generation(k2sn_ctx *ctx, int num_threads, node *leaves){
+	keygen_job job;
+	keygen_worker *workers;
+	pthread_t threads[num_threads];
+	mssnode treestack[h+1];
+	int 	top=-1;
+	u32 subtree;
+	int w;
+
+	ksnmss_setup(ctx);
+
+	job.keypair = ctx;
+	job.leaves = leaves;
+	job.next_subtree = 0;
+	pthread_mutex_init(&job.lock, NULL);
+
+	// Worker 0 runs on the calling thread, so a single-threaded key generation never spawns a thread
+	workers = aligned_alloc(_Alignof(keygen_worker), num_threads * sizeof(keygen_worker));
+	for(w=0;w<num_threads;w++){
+		workers[w].job = &job;
+		workers[w].ctx = *ctx;
+	}
+	for(w=1;w<num_threads;w++){
+		pthread_create(&threads[w], NULL, keygen_worker_run, &workers[w]);
+	}
+	keygen_worker_run(&workers[0]);
+	for(w=1;w<num_threads;w++){
+		pthread_join(threads[w], NULL);
+	}
+	pthread_mutex_destroy(&job.lock);
+	free(workers);
+
+	for(subtree=0;subtree<(1 << KEYGEN_LOG_SUBTREES);subtree++){
+		keygen_push(ctx, ctx, treestack, &top, job.roots[subtree]);
+	}
+
+	memcpy(ctx->MSSPK.key,treestack[top].key,pklen);	
 }
 
 //IMPORTANT: This function does NOT generate a secret OTS key - instead it computes the set of secret OTS component keys
 //Ignores and overwrites value of *seed_ctx
-void generate_secret_key_OTS(ECRYPT_ctx *seed_ctx, u8 *idu8, sk_node *sk){
+void generate_secret_key_OTS(k2sn_ctx *ctx, ECRYPT_ctx *seed_ctx, u8 *idu8, sk_node *sk){
 	int i;
 	
 	u8 key[sklen];
@@ -272,7 +518,7 @@ void generate_secret_key_OTS(ECRYPT_ctx *seed_ctx, u8 *idu8, sk_node *sk){
 	ECRYPT_ctx OTS_seed_ctx, component_seed_ctx;
 	
 	//Set up ChaCha20 instance using system_seed as the seed and idu8 as the message
-	ECRYPT_keysetup(seed_ctx,system_seed,256,64);
+	ECRYPT_keysetup(seed_ctx,ctx->system_seed,256,64);
 	ECRYPT_ivsetup(seed_ctx,idu8);
 
 	u8 zero_bytes[seedlen];
@@ -282,7 +528,7 @@ void generate_secret_key_OTS(ECRYPT_ctx *seed_ctx, u8 *idu8, sk_node *sk){
 	ECRYPT_encrypt_bytes(seed_ctx,zero_bytes,OTS_seed,seedlen);
 	
 	//Chop secret OTS key to be chopped_key_size bits
-	chop(&OTS_seed[0], chopped_key_size);
+	chop(&OTS_seed[0], ctx->chopped_key_size);
 	
 	ECRYPT_keysetup(&OTS_seed_ctx,OTS_seed,256,64);
 	ECRYPT_ivsetup(&OTS_seed_ctx,OTS_seed);
@@ -315,7 +561,7 @@ void generate_public_key_OTS(sk_node *sk, node *pk, vec A[16][4]){
 	}
 }
 
-node create_L_tree(node *pk, u32 id){
+node create_L_tree(k2sn_ctx *ctx, node *pk, u32 id){
 	node 	internal_node[t/2];
 	sk_node	temp;
 	int i,j,k,w,l1;
@@ -324,7 +570,7 @@ node create_L_tree(node *pk, u32 id){
 	u8 rdp[sklen];
 
 	for(i=0;i<6;i++){
-		set_random_pad(id_t+i,0,rdp);
+		set_random_pad(ctx,id_t+i,0,rdp);
 		memcpy(temp.key, (pk+2*i)->key,pklen);
 		for(j=0;j<merlen;j++) 
 			temp.key[pklen-merlen+j] = temp.key[pklen-merlen+j] ^ (pk+2*i+1)->key[j];
@@ -333,34 +579,34 @@ node create_L_tree(node *pk, u32 id){
 		for(j=0;j<sklen;j++) temp.key[j] = temp.key[j] ^ rdp[j];
 		parse(xbyte, temp.key);
 		
-		set_Key(id_t+i,0);
-		SWIFFT(xbyte,A,(internal_node+i)->key);
+		set_Key(&ctx->hash_key,id_t+i,0,ctx->A);
+		SWIFFT(xbyte,ctx->A,(internal_node+i)->key);
 	}
 
 	id_t = id_t/2;
 	for(i=0;i<3;i++){
-		set_random_pad(id_t+i,1,rdp);
+		set_random_pad(ctx,id_t+i,1,rdp);
 		memcpy(temp.key, internal_node[2*i].key,pklen);
 		for(j=0;j<merlen;j++) 
 			temp.key[pklen-merlen+j] = temp.key[pklen-merlen+j] ^ internal_node[2*i+1].key[j];
 		memcpy(temp.key+pklen, internal_node[2*i+1].key+merlen,pklen-merlen);
 		for(j=0;j<sklen;j++) temp.key[j] = temp.key[j] ^ rdp[j];
 		parse(xbyte, temp.key);
-		set_Key(id_t+i,1);
-		SWIFFT(xbyte,A,(internal_node+i)->key);
+		set_Key(&ctx->hash_key,id_t+i,1,ctx->A);
+		SWIFFT(xbyte,ctx->A,(internal_node+i)->key);
 	}
 
 	k=3;
 	for(i=6;i<131;i++){
-		set_random_pad(id_t+i,1,rdp);
+		set_random_pad(ctx,id_t+i,1,rdp);
 		memcpy(temp.key, (pk+2*i)->key,pklen);
 		for(j=0;j<merlen;j++) 
 			temp.key[pklen-merlen+j] = temp.key[pklen-merlen+j] ^ (pk+2*i+1)->key[j];
 		memcpy(temp.key+pklen, (pk+2*i+1)->key+merlen,pklen-merlen);
 		for(j=0;j<sklen;j++) temp.key[j] = temp.key[j] ^ rdp[j];
 		parse(xbyte, temp.key);
-		set_Key(id_t+i,1);
-		SWIFFT(xbyte,A,(internal_node+k)->key);
+		set_Key(&ctx->hash_key,id_t+i,1,ctx->A);
+		SWIFFT(xbyte,ctx->A,(internal_node+k)->key);
 		k++;
 	}
 
@@ -369,15 +615,15 @@ node create_L_tree(node *pk, u32 id){
 	for(k=h+l-2;k>h;k--){
 		id_t = id_t/2;
 		for(i=0;i<w;i++){
-			set_random_pad(id_t+i,l1,rdp);
+			set_random_pad(ctx,id_t+i,l1,rdp);
 			memcpy(temp.key, internal_node[2*i].key,pklen);
 			for(j=0;j<merlen;j++) 
 				temp.key[pklen-merlen+j] = temp.key[pklen-merlen+j]^internal_node[2*i+1].key[j];
 			memcpy(temp.key+pklen, internal_node[2*i+1].key+merlen,pklen-merlen);
 			for(j=0;j<sklen;j++) temp.key[j] = temp.key[j] ^ rdp[j];
 			parse(xbyte, temp.key);
-			set_Key(id_t+i,l1);
-			SWIFFT(xbyte,A,(internal_node+i)->key);
+			set_Key(&ctx->hash_key,id_t+i,l1,ctx->A);
+			SWIFFT(xbyte,ctx->A,(internal_node+i)->key);
 		}
 		w = w>>1;
 		l1++;
@@ -387,7 +633,7 @@ node create_L_tree(node *pk, u32 id){
 }
 
 
-void ksnmss_sign(u32 id, u8 *ms, ksnmss_sig *sig){
+void ksnmss_sign(k2sn_ctx *ctx, u32 id, u8 *ms, ksnmss_sig *sig){
 	int i,j,k,le;
 	u32	id_t;
 	u8 	idu8[seedlen]={0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0};
@@ -409,19 +655,19 @@ void ksnmss_sign(u32 id, u8 *ms, ksnmss_sig *sig){
 	u32 uindx;
 	u8 rdp[sklen];
 	
-	ECRYPT_keysetup(&seed_ctx,system_seed,256,64);
-	ECRYPT_ivsetup(&seed_ctx,system_iv);
+	ECRYPT_keysetup(&seed_ctx,ctx->system_seed,256,64);
+	ECRYPT_ivsetup(&seed_ctx,ctx->system_iv);
 	id_t=id;
 	idu8[0] = (u8)(id_t & 0xFF);	id_t = id_t >> 8;
 	idu8[1] = (u8)(id_t & 0xFF);	id_t = id_t >> 8;
 	idu8[2] = (u8)(id_t & 0xFF);	id_t = id_t >> 8;
 	idu8[3] = (u8)(id_t & 0xFF);
-	generate_secret_key_OTS(&seed_ctx, idu8, sk);
-	set_Key(id,0);
-	generate_public_key_OTS(sk, pk, A);
+	generate_secret_key_OTS(ctx, &seed_ctx, idu8, sk);
+	set_Key(&ctx->hash_key,id,0,ctx->A);
+	generate_public_key_OTS(sk, pk, ctx->A);
 	
-	convert_u82u256(ms);
-	cff();
+	convert_u82u256(ms, &ctx->msg);
+	cff(&ctx->msg, ctx->component_key);
 	
 	// print_sk_node(&sk[component_key[0] % 0x100], "In K2SN-MSS Signing function, (frist) component key is");
 	// print_u32(component_key, 131, "In K2SN-MSS Signing function, just before signing component_key[] is");
@@ -430,24 +676,13 @@ void ksnmss_sign(u32 id, u8 *ms, ksnmss_sig *sig){
 	// }
 	// print_bytes(sksum, sklen*8, "In K2SN-MSS Signing function, just BEFORE signature computation sksum is");
 
-	k=0;
-	for(i=0;i<sklen;i++){
-		temp=1;
-		for(j=0;j<8;j++){
-			sksum[k]=(u8)(((sk[component_key[0] % 0x100].key[i])&temp)>>j);
-			k++; temp=temp<<1;
-		}
-	}
-	for(le=1;le<tb2;le++){
-		k=0;
-		for(i=0;i<sklen;i++){
-			temp=1;
-			for(j=0;j<8;j++){
-				sksum[k]=sksum[k]+(u8)(((sk[component_key[le] % 0x100].key[i])&temp)>>j);
-				k++; temp=temp<<1;
-			}
-		}
+	u8 *selected_sk[tb2];
+	vec X[16][4];
+	for(le=0;le<tb2;le++){
+		selected_sk[le] = sk[ctx->component_key[le] % 0x100].key;
 	}
+	sksum_accumulate(selected_sk, X);
+	sksum_pack(X, sksum);
 
 	// print_bytes(sksum, sklen*8, "In K2SN-MSS Signign function, just AFTER signature computation sksum is");
 
@@ -455,7 +690,7 @@ void ksnmss_sign(u32 id, u8 *ms, ksnmss_sig *sig){
 	memcpy(sig->message,ms,msglen);
 	memcpy(sig->sksum,sksum,sklen*8);
 	memcpy(sig->pk,pk,t*pklen);
-	memcpy(sig->auth,auth,h*pklen);
+	memcpy(sig->auth,ctx->auth,h*pklen);
 
 
 	if(id < usr){
@@ -473,37 +708,37 @@ void ksnmss_sign(u32 id, u8 *ms, ksnmss_sig *sig){
 		//2
 		id_t = id>>(tau+1);
 		if(((id_t&1)==0) && (tau<(h-1)))
-			keep[tau]=auth[tau];
+			ctx->keep[tau]=ctx->auth[tau];
 
 		//3
 		if(eo==0)
-			auth[0]=create_L_tree(pk,id);
+			ctx->auth[0]=create_L_tree(ctx,pk,id);
 	
 		//4
 		//if(eo==1){
 		if(tau>0){
 			id_t = id>>tau;
-			set_random_pad(id_t,tau+l,rdp);
-			memcpy(temp2.key, auth[tau-1].key,pklen);
+			set_random_pad(ctx,id_t,tau+l,rdp);
+			memcpy(temp2.key, ctx->auth[tau-1].key,pklen);
 			for(j=0;j<merlen;j++) 
-				temp2.key[pklen-merlen+j] = temp2.key[pklen-merlen+j]^keep[tau-1].key[j];
-				memcpy(temp2.key+pklen, keep[tau-1].key+merlen,pklen-merlen);
+				temp2.key[pklen-merlen+j] = temp2.key[pklen-merlen+j]^ctx->keep[tau-1].key[j];
+				memcpy(temp2.key+pklen, ctx->keep[tau-1].key+merlen,pklen-merlen);
 				for(j=0;j<sklen;j++) temp2.key[j] = temp2.key[j] ^ rdp[j];
 				parse(xbyte, temp2.key);
-				set_Key(id_t,tau+l);
-				SWIFFT(xbyte,A,auth[tau].key);
+				set_Key(&ctx->hash_key,id_t,tau+l,ctx->A);
+				SWIFFT(xbyte,ctx->A,ctx->auth[tau].key);
 			for(i=0;i<tau;i++){
-				if(i<h-2){ memcpy(auth[i].key, (instance[i].v).key,pklen);
+				if(i<h-2){ memcpy(ctx->auth[i].key, (ctx->instance[i].v).key,pklen);
 				}
-				else if(i==(h-2)) memcpy(auth[i].key, retain.key,pklen);
+				else if(i==(h-2)) memcpy(ctx->auth[i].key, ctx->retain.key,pklen);
 			}
 			for(i=0;i<tau;i++){
 				tempp = id+1+3*(1<<i);
 				if(tempp < usr){
-					instance[i].finalized = 0;
-					instance[i].startleaf = tempp;
-					if(instance[i].top==-1)
-						instance[i].lowheight = 0;
+					ctx->instance[i].finalized = 0;
+					ctx->instance[i].startleaf = tempp;
+					if(ctx->instance[i].top==-1)
+						ctx->instance[i].lowheight = 0;
 				}
 			}
 
@@ -515,73 +750,73 @@ void ksnmss_sign(u32 id, u8 *ms, ksnmss_sig *sig){
 		for(i=0;i< updateiter;i++){
 			minh=infy; //minindx=infy;
 			for(j=0;j<h-2;j++){
-				if((instance[j].lowheight!=infy) && (instance[j].finalized!=1)){
-					if (minh>instance[j].lowheight){
-						minh = instance[j].lowheight;
+				if((ctx->instance[j].lowheight!=infy) && (ctx->instance[j].finalized!=1)){
+					if (minh>ctx->instance[j].lowheight){
+						minh = ctx->instance[j].lowheight;
 						minindx = j;
 					}
 				}
 			}
 			if(minh<infy){
-				id_t=instance[minindx].startleaf;
+				id_t=ctx->instance[minindx].startleaf;
 				idu8[0] = (u8)(id_t & 0xFF);	id_t = id_t >> 8;
 				idu8[1] = (u8)(id_t & 0xFF);	id_t = id_t >> 8;
 				idu8[2] = (u8)(id_t & 0xFF);	id_t = id_t >> 8;
 				idu8[3] = (u8)(id_t & 0xFF);
-				ECRYPT_keysetup(&seed_ctx,system_seed,256,64);
-				ECRYPT_ivsetup(&seed_ctx,system_iv);
-				generate_secret_key_OTS(&seed_ctx, idu8, sk);
-				set_Key(instance[minindx].startleaf,0);
-				generate_public_key_OTS(sk, pk,A);
-				leaf = create_L_tree(pk,instance[minindx].startleaf);
+				ECRYPT_keysetup(&seed_ctx,ctx->system_seed,256,64);
+				ECRYPT_ivsetup(&seed_ctx,ctx->system_iv);
+				generate_secret_key_OTS(ctx, &seed_ctx, idu8, sk);
+				set_Key(&ctx->hash_key,ctx->instance[minindx].startleaf,0,ctx->A);
+				generate_public_key_OTS(sk, pk,ctx->A);
+				leaf = create_L_tree(ctx,pk,ctx->instance[minindx].startleaf);
 
 //set_Key(id_t,tau+l);
 
 				if(minindx==0){
-					memcpy((instance[minindx].v).key, leaf.key,pklen);
-					instance[minindx].finalized = 1;
-					instance[minindx].lowheight = infy;
+					memcpy((ctx->instance[minindx].v).key, leaf.key,pklen);
+					ctx->instance[minindx].finalized = 1;
+					ctx->instance[minindx].lowheight = infy;
 				}
-				else if(instance[minindx].top==-1){
-					instance[minindx].top++;
-					memcpy((instance[minindx].treestack[0]).key,leaf.key,pklen);
-					(instance[minindx].treestack[0]).indx=instance[minindx].startleaf;
-					(instance[minindx].treestack[0]).height=0;
-					instance[minindx].startleaf = instance[minindx].startleaf+1;
+				else if(ctx->instance[minindx].top==-1){
+					ctx->instance[minindx].top++;
+					memcpy((ctx->instance[minindx].treestack[0]).key,leaf.key,pklen);
+					(ctx->instance[minindx].treestack[0]).indx=ctx->instance[minindx].startleaf;
+					(ctx->instance[minindx].treestack[0]).height=0;
+					ctx->instance[minindx].startleaf = ctx->instance[minindx].startleaf+1;
 				}
 				else{
 					memcpy(nodestack.key,leaf.key,pklen);
 					nodestack.height = 0;
-					nodestack.indx = instance[minindx].startleaf;
-					while((instance[minindx].top!=-1) && (nodestack.height==(instance[minindx].treestack[instance[minindx].top]).height)){
-						memcpy(temp2.key, (instance[minindx].treestack[instance[minindx].top]).key,pklen);
+					nodestack.indx = ctx->instance[minindx].startleaf;
+					while((ctx->instance[minindx].top!=-1) && (nodestack.height==(ctx->instance[minindx].treestack[ctx->instance[minindx].top]).height)){
+						memcpy(temp2.key, (ctx->instance[minindx].treestack[ctx->instance[minindx].top]).key,pklen);
 						for(k=0;k<merlen;k++) 
 							temp2.key[pklen-merlen+k] = temp2.key[pklen-merlen+k]^nodestack.key[k];
 						memcpy(temp2.key+pklen, nodestack.key+merlen,pklen-merlen);
-						set_random_pad(nodestack.indx/2,nodestack.height+1+l,rdp);
+						set_random_pad(ctx,nodestack.indx/2,nodestack.height+1+l,rdp);
 						for(k=0;k<sklen;k++) temp2.key[k] = temp2.key[k] ^ rdp[k];
 						parse(xbyte, temp2.key);
-						set_Key(nodestack.indx/2,nodestack.height+1+l);
-						SWIFFT(xbyte,A,nodestack.key);
+						set_Key(&ctx->hash_key,nodestack.indx/2,nodestack.height+1+l,ctx->A);
+						SWIFFT(xbyte,ctx->A,nodestack.key);
 						nodestack.height++;	
-						instance[minindx].top--;
+						ctx->instance[minindx].top--;
 						nodestack.indx=nodestack.indx/2;
 					}
 					if(nodestack.height == minindx){
-						memcpy((instance[minindx].v).key,nodestack.key,pklen);
-						instance[minindx].finalized = 1;
-						instance[minindx].lowheight = infy;
-						instance[minindx].top = -1;
+						memcpy((ctx->instance[minindx].v).key,nodestack.key,pklen);
+						ctx->instance[minindx].finalized = 1;
+						ctx->instance[minindx].lowheight = infy;
+						ctx->instance[minindx].top = -1;
 					}else{
-						instance[minindx].top++;
+						ctx->instance[minindx].top++;
 						//memcpy((instance[minindx].treestack[instance[minindx].top]).key,nodestack.key,pklen);
 						//(instance[minindx].treestack[instance[minindx].top]).height = nodestack.height;
 						//(instance[minindx].treestack[instance[minindx].top]).indx = nodestack.indx;		
-						(instance[minindx].treestack[instance[minindx].top]) = nodestack;
-						instance[minindx].startleaf = instance[minindx].startleaf+1;
+						(ctx->instance[minindx].treestack[ctx->instance[minindx].top]) = nodestack;
+						ctx->instance[minindx].startleaf = ctx->instance[minindx].startleaf+1;
 						
-						if(instance[minindx].top==0)
-							instance[minindx].lowheight = nodestack.height;
+						if(ctx->instance[minindx].top==0)
+							ctx->instance[minindx].lowheight = nodestack.height;
 					}
 				}
 			}else break;
@@ -591,10 +826,142 @@ void ksnmss_sign(u32 id, u8 *ms, ksnmss_sig *sig){
 
 
 
-int ksnmss_verify(u32 id, u8 *ms, ksnmss_sig *sig){
+// Allocates the node table of a tree. Its leaves are left for the caller to fill, and the nodes 
+// above them for ksnmss_tree_build.
+// Params:
+//  ksnmss_tree *tree: tree to allocate
+void ksnmss_tree_init(ksnmss_tree *tree){
+	int height;
+	node *nodes = malloc(2 * usr * sizeof(node));
+
+	for(height=0;height<=h;height++){
+		tree->level[height] = nodes;
+		nodes += usr >> height;
+	}
+}
+
+// Frees the node table of a tree
+// Params:
+//  ksnmss_tree *tree: tree allocated by ksnmss_tree_init
+void ksnmss_tree_free(ksnmss_tree *tree){
+	free(tree->level[0]);
+}
+
+// Computes every node of a tree above its leaves, as key_generation does, so that level[h][0] is 
+// the public key MSSPK
+// Params:
+//  k2sn_ctx *ctx: keypair of the tree. Its gSWIFFT key is overwritten
+//  ksnmss_tree *tree: tree whose leaves are filled
+void ksnmss_tree_build(k2sn_ctx *ctx, ksnmss_tree *tree){
+	int height;
+	u32 indx;
+
+	for(height=1;height<=h;height++){
+		for(indx=0;indx<(usr >> height);indx++){
+			hash_node_pair(ctx, tree->level[height-1][2*indx].key, tree->level[height-1][2*indx+1].key,
+			               indx, height, tree->level[height][indx].key);
+		}
+	}
+}
+
+// Computes the authentication path of the id'th K2SN-MSS instance from the leaves of its tree. Only
+// the subtrees whose roots are on the path are hashed, which takes about usr node hashes in all.
+// Params:
+//  k2sn_ctx *ctx: keypair of the tree. Its gSWIFFT key is overwritten
+//  const node *leaves: leaves of the tree. Assumes array is of length usr
+//  u32 id: index of the K2SN-MSS instance
+//  node *auth: filled with the authentication path. Assumes array is of length h
+// Return: 1 on success, negative number if id is not less than usr or memory runs out
+int ksnmss_auth_path(k2sn_ctx *ctx, const node *leaves, u32 id, node *auth){
+	int height, level;
+	u32 sibling, indx;
+	node *nodes;
+
+	if(id >= usr) return -1;
+	//The largest subtree on the path has usr/2 leaves, hashed into usr/4 nodes
+	nodes = malloc((usr >> 2) * sizeof(node));
+	if(nodes == NULL) return -1;
+
+	auth[0] = leaves[id ^ 1];
+	for(height=1;height<h;height++){
+		//Hash the leaves below the sibling at this height level by level, in place
+		sibling = (id >> height) ^ 1;
+		for(indx=0;indx<(1u << (height-1));indx++){
+			hash_node_pair(ctx, leaves[(sibling << height) + 2*indx].key, 
+			               leaves[(sibling << height) + 2*indx+1].key, 
+			               (sibling << (height-1)) + indx, 1, nodes[indx].key);
+		}
+		for(level=2;level<=height;level++){
+			for(indx=0;indx<(1u << (height-level));indx++){
+				hash_node_pair(ctx, nodes[2*indx].key, nodes[2*indx+1].key, 
+				               (sibling << (height-level)) + indx, level, nodes[indx].key);
+			}
+		}
+		auth[height] = nodes[0];
+	}
+	free(nodes);
+	return 1;
+}
+
+// Computes the secret OTS key of the id'th K2SN-MSS instance, as generate_secret_key_OTS does 
+// before expanding it into component keys
+// Params:
+//  k2sn_ctx *ctx: keypair of the instance
+//  u32 id: index of the instance
+//  u8 *OTS_sk: filled with the secret OTS key. Assumes this is an array of length seedlen
+void generate_seed_OTS(k2sn_ctx *ctx, u32 id, u8 *OTS_sk){
+	u8 	idu8[seedlen];
+	u8 	zero_bytes[seedlen];
+	ECRYPT_ctx seed_ctx;
+
+	memset(idu8, 0, seedlen);
+	idu8[0] = (u8)(id & 0xFF);
+	idu8[1] = (u8)((id >> 8) & 0xFF);
+	idu8[2] = (u8)((id >> 16) & 0xFF);
+	idu8[3] = (u8)((id >> 24) & 0xFF);
+	memset(zero_bytes, 0, seedlen);
+	ECRYPT_keysetup(&seed_ctx,ctx->system_seed,256,64);
+	ECRYPT_ivsetup(&seed_ctx,idu8);
+	ECRYPT_encrypt_bytes(&seed_ctx,zero_bytes,OTS_sk,seedlen);
+	chop(OTS_sk, ctx->chopped_key_size);
+}
+
+// Signs with the id'th K2SN-MSS instance, in any order and without updating the signer state, by 
+// reading its authentication path from the nodes of the tree. Only the component keys selected by
+// the message are generated, and the public OTS key is not computed: sig->pk is left untouched, so 
+// the signature only verifies once it is filled in. Otherwise sig is the signature ksnmss_sign 
+// returns for id.
+// Params:
+//  k2sn_ctx *ctx: keypair of the signer
+//  const ksnmss_tree *tree: nodes of the tree of ctx
+//  u32 id: index of the K2SN-MSS instance. Must be less than usr
+//  u8 *ms: message to sign
+//  const ksnots_fixed_msg *fixed_ms: ms, as prepared by KSNOTS_fix_message
+//  ksnmss_sig *sig: filled with the signature
+// Return: 1 on success, negative number if id is not less than usr
+int ksnmss_sign_from_tree(k2sn_ctx *ctx, const ksnmss_tree *tree, u32 id, u8 *ms, 
+                          const ksnots_fixed_msg *fixed_ms, ksnmss_sig *sig){
+	int height;
+	u8 OTS_sk[seedlen];
+
+	//The tree only holds the nodes of the usr instances
+	if(id >= usr) return -1;
+
+	generate_seed_OTS(ctx, id, OTS_sk);
+	KSNOTS_sign_fixed(OTS_sk, fixed_ms, sig->sksum);
+
+	sig->id = id;
+	memcpy(sig->message,ms,msglen);
+	for(height=0;height<h;height++){
+		sig->auth[height] = tree->level[height][(id >> height) ^ 1];
+	}
+	return 1;
+}
+
+int ksnmss_verify(k2sn_ctx *ctx, u32 id, u8 *ms, ksnmss_sig *sig){
 	int 	i,j,k,le;
 	u32	id_t;
-	int 	x[16][64];
+	vec 	X[16][4];
 	u8 	idu8[seedlen];
 	sk_node sk[t];
 	node	pk[t];
@@ -612,19 +979,17 @@ int ksnmss_verify(u32 id, u8 *ms, ksnmss_sig *sig){
 	for(i=0;i<1024;i++){
 		if(sig->sksum[i]>131) return 3;
 	}
-	convert_u82u256(ms);
-	cff();
+	convert_u82u256(ms, &ctx->msg);
+	cff(&ctx->msg, ctx->component_key);
 
-	for(i=0;i<16;i++){
-		for(j=0;j<64;j++) x[i][j] = sig->sksum[i*64+j];
-	}
-	set_Key(id,0);
-	gSWIFFT(x,A,pksum);
+	sksum_unpack(sig->sksum, X);
+	set_Key(&ctx->hash_key,id,0,ctx->A);
+	gSWIFFT_vec(X,ctx->A,pksum);
 
-	convert_ring((sig->pk[component_key[0]]).key,&sum);
+	convert_ring((sig->pk[ctx->component_key[0]]).key,&sum);
 
 	for(le=1;le<tb2;le++){
-		convert_ring((sig->pk[component_key[le]]).key,&temp);
+		convert_ring((sig->pk[ctx->component_key[le]]).key,&temp);
 		for(i=0;i<rglen;i++){
 			sum.key[i] = sum.key[i]+temp.key[i];
 		}
@@ -640,7 +1005,7 @@ int ksnmss_verify(u32 id, u8 *ms, ksnmss_sig *sig){
 	if (verified != 0) return 2;
 	
 	node present,left,right;
-	present= create_L_tree(sig->pk,id);
+	present= create_L_tree(ctx,sig->pk,id);
 
 	for(i=0;i<h;i++){
 		if(id%2==0){
@@ -653,18 +1018,18 @@ int ksnmss_verify(u32 id, u8 *ms, ksnmss_sig *sig){
 		for(j=0;j<merlen;j++) 
 			temp_node.key[pklen-merlen+j] = temp_node.key[pklen-merlen+j] ^ right.key[j];
 		memcpy(temp_node.key+pklen, right.key+merlen,pklen-merlen);
-		set_random_pad(id/2,i+l+1,rdp);	
+		set_random_pad(ctx,id/2,i+l+1,rdp);	
 		for(j=0;j<sklen;j++) temp_node.key[j] = temp_node.key[j] ^ rdp[j];
 		parse(xbyte, temp_node.key);
-		set_Key(id/2,i+l+1);
-		SWIFFT(xbyte,A,present.key);
+		set_Key(&ctx->hash_key,id/2,i+l+1,ctx->A);
+		SWIFFT(xbyte,ctx->A,present.key);
 		id = id/2;
 	}
 
 	verified = 0;
 	for(i=0;i<pklen;i++){
 		//verified = verified + (MSS[mmsize-1].key[i]-present.key[i]);
-		verified = verified + (MSSPK.key[i]-present.key[i]);
+		verified = verified + (ctx->MSSPK.key[i]-present.key[i]);
 	}
 	
 	if (verified == 0) {
@@ -711,21 +1076,21 @@ void pn(node *r){
 	printf("\n");
 }
 
-void set_random_pad(u32 indx, u32 height, u8 randpad[sklen]){
-	ECRYPT_ctx seed_ctx;
-	ECRYPT_keysetup(&seed_ctx,randompad_seed,256,64);
-	ECRYPT_ivsetup(&seed_ctx,randompad_iv);
-	u8 ina[sklen]={0};
-
-
-	ina[0] = indx & 255; indx = indx >>8;
-	ina[1] = indx & 255; indx = indx >>8;
-	ina[2] = indx & 255; indx = indx >>8;
-	ina[3] = indx & 255;
-
-	ina[64] = height;
-
-	ECRYPT_encrypt_bytes(&seed_ctx,ina,randpad,128);
-	
+// Computes the random pad of the node at (indx, height): the 128-byte ChaCha20 encryption, under 
+// the random pad seed and iv, of a buffer holding only indx in bytes 0..3 and height in byte 64. 
+// Built from the keystream precomputed by ksnmss_setup by patching those 5 bytes.
+// Params:
+//  k2sn_ctx *ctx: keypair of the node
+//  u32 indx, u32 height: position of the node
+//  u8 randpad[sklen]: filled with the random pad
+void set_random_pad(k2sn_ctx *ctx, u32 indx, u32 height, u8 randpad[sklen]){
+	memcpy(randpad, ctx->randompad_keystream, sklen);
+
+	randpad[0] ^= indx & 255; indx = indx >>8;
+	randpad[1] ^= indx & 255; indx = indx >>8;
+	randpad[2] ^= indx & 255; indx = indx >>8;
+	randpad[3] ^= indx & 255;
+
+	randpad[64] ^= height;
 }
 
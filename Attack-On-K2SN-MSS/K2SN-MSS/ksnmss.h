@@ -2,6 +2,7 @@
 #define KSNMSS_H_
 
 
+#include <pthread.h>
 #include "merkle-tree.c"
 #include "1cff.c"
 
@@ -9,20 +10,65 @@
 #define msglen 32
 #define ivlen 8
 
-//Size of the shortened secret KSN-OTS keys in bits
-int chopped_key_size;
+//key_generation splits the tree into 2^KEYGEN_LOG_SUBTREES subtrees. Must be at most h-1
+#define KEYGEN_LOG_SUBTREES 6
 
 int updateiter = h/2-1;
-u8 system_seed[seedlen];
-u8 system_iv[ivlen];	
-u8 randompad_seed[seedlen];
-u8 randompad_iv[ivlen];
 
-sk_node random_pad[h+l];
-node auth[h];
-node keep[h-1];
-node retain;
-node MSSPK;
+// A K2SN-MSS keypair together with everything its signing and verifying functions write. Only
+// set_binotable() writes state outside of a context, so each thread can work on its own context.
+typedef struct k2sn_ctx{
+	//Size of the shortened secret KSN-OTS keys in bits
+	int chopped_key_size;
+
+	u8 system_seed[seedlen];
+	u8 system_iv[ivlen];	
+	u8 randompad_seed[seedlen];
+	u8 randompad_iv[ivlen];
+	//Keystream of randompad_seed and randompad_iv that every random pad is patched from. Derived by 
+	//  ksnmss_setup
+	u8 randompad_keystream[sklen];
+	u8 hk_seed[seedlen];
+	u8 hk_iv[ivlen];
+	//Derived from hk_seed and hk_iv by ksnmss_setup
+	swifft_key hash_key;
+
+	//Signer state: the authentication path of the next instance and the treehash instances that 
+	//  compute the ones after it
+	node auth[h];
+	node keep[h-1];
+	node retain;
+	treehash instance[h-2];
+	node MSSPK;
+
+	//1-CFF subset of the last message signed or verified
+	u256 msg;
+	int component_key[tb2];
+
+	//gSWIFFT key of the last node hashed
+	vec A[16][4];
+}k2sn_ctx;
+
+// Subtrees of a key generation, shared by its workers. next_subtree is protected by lock.
+typedef struct keygen_job{
+	k2sn_ctx *keypair;
+	node *leaves;
+	pthread_mutex_t lock;
+	u32 next_subtree;
+	mssnode roots[1 << KEYGEN_LOG_SUBTREES];
+}keygen_job;
+
+// A key generation worker, with its own copy of the keypair for the gSWIFFT key scratch
+typedef struct keygen_worker{
+	keygen_job *job;
+	k2sn_ctx ctx;
+}keygen_worker;
+
+// Every node of a K2SN-MSS tree, from which any instance can sign. level[height] holds the 
+// usr>>height nodes at that height, from left to right; level[0] holds the leaves.
+typedef struct ksnmss_tree{
+	node *level[h+1];
+}ksnmss_tree;
 
 typedef struct signature{
 	u32 id;
@@ -46,31 +92,162 @@ const u8 enc_two[sklen]={2,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0
 // Zeros every bit of ots_key except the least significant num_remaining_bits bits
 void chop(u8 *ots_key, int num_remaining_bits);
 
+// Adds up the selected component keys bit by bit: coefficient 8*i+j of the sum counts the keys 
+// whose byte i has bit j set. The sum is written as 16-bit coefficients in the layout gSWIFFT_vec 
+// takes.
+// Params:
+//  u8 *keys[tb2]: the selected component keys. Each is an array of length sklen
+//  vec X[16][4]: filled with the sum
+void sksum_accumulate(u8 *keys[tb2], vec X[16][4]);
+
+// Narrows a sum computed by sksum_accumulate to the byte per coefficient of a KSN-OTS signature
+// Params:
+//  vec X[16][4]: sum of component keys
+//  u8 *sksum: Pointer to array which will be filled with signature. Assumes lenght of *sksum is (sklen * 8)
+void sksum_pack(vec X[16][4], u8 *sksum);
+
+// Widens a KSN-OTS signature to the layout gSWIFFT_vec takes
+// Params:
+//  const u8 *sksum: KSN-OTS signature. Assumes lenght of *sksum is (sklen * 8)
+//  vec X[16][4]: filled with the coefficients of sksum
+void sksum_unpack(const u8 *sksum, vec X[16][4]);
+
 // Computes KSN-OTS signature
 // Params:
+//  k2sn_ctx *ctx: context whose 1-CFF state is used
 //  u8 *OTS_sk: secret OTS key. Assumes this is an array of length seedlen
 //  u8 *ms:	message to sign
 //  u8 *sksum: Pointer to array which will be filled with signature. Assumes lenght of *sksum is (sklen * 8)
-void KSNOTS_sign(u8 *OTS_sk, u8 *ms, u8 *OTS_signature);
+void KSNOTS_sign(k2sn_ctx *ctx, u8 *OTS_sk, u8 *ms, u8 *OTS_signature);
+
+// Secret component keys selected by a fixed message, so that many secret OTS keys can sign the 
+// same message without recomputing its 1-CFF subset. component[le] is component_key[le] % 0x100,
+// the component KSNOTS_sign uses for the le'th element of the subset.
+typedef struct ksnots_fixed_msg{
+	int component[tb2];
+}ksnots_fixed_msg;
+
+// Computes the 1-CFF subset of a message for KSNOTS_sign_fixed
+// Params:
+//  k2sn_ctx *ctx: context whose 1-CFF state is used
+//  u8 *ms: message to sign
+//  ksnots_fixed_msg *fixed_ms: filled with the components selected by ms
+void KSNOTS_fix_message(k2sn_ctx *ctx, u8 *ms, ksnots_fixed_msg *fixed_ms);
+
+// Computes the same KSN-OTS signature as KSNOTS_sign, for a message prepared by 
+// KSNOTS_fix_message. Only the selected component keys are generated, by seeking the ChaCha block 
+// counter to each of them. Uses no context, as the subset is already computed.
+// Params:
+//  u8 *OTS_sk: secret OTS key. Assumes this is an array of length seedlen
+//  const ksnots_fixed_msg *fixed_ms: message to sign
+//  u8 *OTS_signature: Pointer to array which will be filled with signature. Assumes lenght of *sksum is (sklen * 8)
+void KSNOTS_sign_fixed(u8 *OTS_sk, const ksnots_fixed_msg *fixed_ms, u8 *OTS_signature);
+
+// Computes KSNOTS_sign_fixed for 8 secret OTS keys at once, generating their component keys with 
+// the 8-key ChaCha20 of chacha-x8.c
+// Params:
+//  u8 *OTS_sk[8]: secret OTS keys. Assumes each is an array of length seedlen
+//  const ksnots_fixed_msg *fixed_ms: message to sign
+//  u8 *OTS_signature[8]: Pointers to arrays which will be filled with the signature under each key. Assumes lenght of each is (sklen * 8)
+void KSNOTS_sign_x8(u8 *OTS_sk[8], const ksnots_fixed_msg *fixed_ms, u8 *OTS_signature[8]);
+
+// Computes the 64-bit fingerprint of a KSN-OTS signature. Never returns 0.
+// Params:
+//  const u8 *sksum: KSN-OTS signature. Assumes length of *sksum is (sklen * 8)
+// Return: fingerprint of sksum
+u64 sksum_fingerprint(const u8 *sksum);
 
 // Verifies KSN-OTS signature
 // Params:
+//  k2sn_ctx *ctx: keypair of the signer. Its 1-CFF state and gSWIFFT key are overwritten
 //  node *OTS_pk: public OTS key. Assumes this is an array of length seedlen
 //  u8 *ms:	message to sign
 //  u8 *OTS_signature: Pointer to array which will be filled with signature. Assumes lenght of *sksum is (sklen * 8)
 //  u32 instance_index: index of KSN-OTS instance used to verify signature - used to compute the gSWIFFT key
 // Return: 1 if signature is valid, negative number otherwise
-int KSNOTS_verify(node *OTS_pk, u8 *ms, u8 *OTS_signature, u32 instance_index);
+int KSNOTS_verify(k2sn_ctx *ctx, node *OTS_pk, u8 *ms, u8 *OTS_signature, u32 instance_index);
 
-void system_setup();
-void generate_secret_key_OTS(ECRYPT_ctx *seed_ctx, u8 *idu8, sk_node *sk);
+// Precomputes what the functions of a keypair derive from its seeds. Must be called once the seeds
+// of ctx are set, before ctx is used; key_generation calls it.
+// Params:
+//  k2sn_ctx *ctx: keypair whose seeds are set
+void ksnmss_setup(k2sn_ctx *ctx);
+
+void generate_secret_key_OTS(k2sn_ctx *ctx, ECRYPT_ctx *seed_ctx, u8 *idu8, sk_node *sk);
 void generate_public_key_OTS(sk_node *sk, node *pk, vec A[16][4]);
-void key_generation(u8 *system_seed, u8 *system_iv);
-node create_L_tree(node *pk, u32 id);
+// Generates the keypair of ctx from its seeds and sets up the signer for instance 0. The tree is 
+// split into 2^KEYGEN_LOG_SUBTREES subtrees, which num_threads workers compute in parallel; their 
+// roots are then merged on the calling thread.
+// Params:
+//  k2sn_ctx *ctx: keypair whose seeds are set
+//  int num_threads: number of worker threads, including the calling thread
+//  node *leaves: if not NULL, filled with the usr leaves of the tree, indexed by instance id
+void key_generation(k2sn_ctx *ctx, int num_threads, node *leaves);
+void *keygen_worker_run(void *arg);
+node create_L_tree(k2sn_ctx *ctx, node *pk, u32 id);
 void pn(node *r);
 
-void ksnmss_sign(u32 id, u8 *ms, ksnmss_sig *sig);
-int ksnmss_verify(u32 id, u8 *ms, ksnmss_sig *sig);
+void ksnmss_sign(k2sn_ctx *ctx, u32 id, u8 *ms, ksnmss_sig *sig);
+int ksnmss_verify(k2sn_ctx *ctx, u32 id, u8 *ms, ksnmss_sig *sig);
+
+// Allocates the node table of a tree. Its leaves are left for the caller to fill, and the nodes 
+// above them for ksnmss_tree_build.
+// Params:
+//  ksnmss_tree *tree: tree to allocate
+void ksnmss_tree_init(ksnmss_tree *tree);
+
+// Frees the node table of a tree
+// Params:
+//  ksnmss_tree *tree: tree allocated by ksnmss_tree_init
+void ksnmss_tree_free(ksnmss_tree *tree);
+
+// Computes every node of a tree above its leaves, as key_generation does, so that level[h][0] is 
+// the public key MSSPK
+// Params:
+//  k2sn_ctx *ctx: keypair of the tree. Its gSWIFFT key is overwritten
+//  ksnmss_tree *tree: tree whose leaves are filled
+void ksnmss_tree_build(k2sn_ctx *ctx, ksnmss_tree *tree);
+
+// Computes the authentication path of the id'th K2SN-MSS instance from the leaves of its tree. Only
+// the subtrees whose roots are on the path are hashed, which takes about usr node hashes in all.
+// Params:
+//  k2sn_ctx *ctx: keypair of the tree. Its gSWIFFT key is overwritten
+//  const node *leaves: leaves of the tree. Assumes array is of length usr
+//  u32 id: index of the K2SN-MSS instance
+//  node *auth: filled with the authentication path. Assumes array is of length h
+// Return: 1 on success, negative number if id is not less than usr or memory runs out
+int ksnmss_auth_path(k2sn_ctx *ctx, const node *leaves, u32 id, node *auth);
+
+// Computes the secret OTS key of the id'th K2SN-MSS instance, as generate_secret_key_OTS does 
+// before expanding it into component keys
+// Params:
+//  k2sn_ctx *ctx: keypair of the instance
+//  u32 id: index of the instance
+//  u8 *OTS_sk: filled with the secret OTS key. Assumes this is an array of length seedlen
+void generate_seed_OTS(k2sn_ctx *ctx, u32 id, u8 *OTS_sk);
+
+// Signs with the id'th K2SN-MSS instance, in any order and without updating the signer state, by 
+// reading its authentication path from the nodes of the tree. Only the component keys selected by
+// the message are generated, and the public OTS key is not computed: sig->pk is left untouched, so 
+// the signature only verifies once it is filled in. Otherwise sig is the signature ksnmss_sign 
+// returns for id.
+// Params:
+//  k2sn_ctx *ctx: keypair of the signer
+//  const ksnmss_tree *tree: nodes of the tree of ctx
+//  u32 id: index of the K2SN-MSS instance. Must be less than usr
+//  u8 *ms: message to sign
+//  const ksnots_fixed_msg *fixed_ms: ms, as prepared by KSNOTS_fix_message
+//  ksnmss_sig *sig: filled with the signature
+// Return: 1 on success, negative number if id is not less than usr
+int ksnmss_sign_from_tree(k2sn_ctx *ctx, const ksnmss_tree *tree, u32 id, u8 *ms, 
+                          const ksnots_fixed_msg *fixed_ms, ksnmss_sig *sig);
 void convert_ring(u8 *rg8, rg_elm *a);
-void set_random_pad(u32 indx, u32 height, u8 randpad[sklen]);
+// Computes the random pad of the node at (indx, height): the 128-byte ChaCha20 encryption, under 
+// the random pad seed and iv, of a buffer holding only indx in bytes 0..3 and height in byte 64. 
+// Built from the keystream precomputed by ksnmss_setup by patching those 5 bytes.
+// Params:
+//  k2sn_ctx *ctx: keypair of the node
+//  u32 indx, u32 height: position of the node
+//  u8 randpad[sklen]: filled with the random pad
+void set_random_pad(k2sn_ctx *ctx, u32 indx, u32 height, u8 randpad[sklen]);
 #endif
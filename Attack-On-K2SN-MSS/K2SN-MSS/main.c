@@ -2,6 +2,7 @@
 #include <time.h>
 #include "merkle-tree.h"
 #include "ChaCha20/chacha.c"
+#include "ChaCha20/chacha-x8.c"
 #include "swifft16/swifft-avx2-16.c"
 #include "ksnmss.c"
 #include <x86intrin.h>
@@ -9,18 +10,19 @@
 
 int main(){
 	int i,j;
+	k2sn_ctx ctx = {0};
 	
 	//Seed the random number generator
 	srand(time(0));
 
 	//Generate seeds and ivs for all three seeds
 	printf("Initializing system seeds... ");	
-	for(i=0;i<seedlen;i++) system_seed[i]=rand()%255;
-	for(i=0;i<ivlen;i++) system_iv[i]=rand()%255;
-	for(i=0;i<seedlen;i++) randompad_seed[i]=rand()%255;
-	for(i=0;i<ivlen;i++) randompad_iv[i]=rand()%255;
-	for(i=0;i<seedlen;i++) hk_seed[i]=rand()%255;
-	for(i=0;i<ivlen;i++) hk_iv[i]=rand()%255;
+	for(i=0;i<seedlen;i++) ctx.system_seed[i]=rand()%255;
+	for(i=0;i<ivlen;i++) ctx.system_iv[i]=rand()%255;
+	for(i=0;i<seedlen;i++) ctx.randompad_seed[i]=rand()%255;
+	for(i=0;i<ivlen;i++) ctx.randompad_iv[i]=rand()%255;
+	for(i=0;i<seedlen;i++) ctx.hk_seed[i]=rand()%255;
+	for(i=0;i<ivlen;i++) ctx.hk_iv[i]=rand()%255;
 
 
 	//Precompute entire table of binomial coefficients, used in CFF computation.
@@ -29,7 +31,7 @@ int main(){
 	
 	//Generate public and private key pair
 	printf("Key Generation Phase... ");
-	key_generation(system_seed, system_iv);
+	key_generation(&ctx, 1, NULL);
 	printf("Finished.\n");
 
 	//Generate random message and sign it once with every OTS instance
@@ -39,14 +41,14 @@ int main(){
 	for(j=0;j<msglen;j++) ms[j]=rand()%256;
 	ksnmss_sig sig;
 	for(id=0;id<usr;id++)
-		ksnmss_sign(id, ms, &sig);
+		ksnmss_sign(&ctx, id, ms, &sig);
 	printf("Finished.\n");
 
 	//Verify all 2^h signatures
 	printf("Verifying %d messages... ", usr);
 	int verified = 1;
 	for(i=0;i<usr;i++)
-		verified&=ksnmss_verify(id-1, ms, &sig);
+		verified&=ksnmss_verify(&ctx, id-1, ms, &sig);
 	printf("Finished.\n");
 	printf("Verify signatures of all messages: %d\n",verified);
 	
@@ -51,7 +51,5 @@ typedef struct treehash{
 	
 }treehash;
 
-treehash instance[h-2];
-
 
 #endif
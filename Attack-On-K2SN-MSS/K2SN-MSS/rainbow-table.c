@@ -0,0 +1,290 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "rainbow-table.h"
+
+//Writes a key into a secret OTS key, in the little-endian layout chop leaves it in
+static void rainbow_key_to_bytes(u32 key, u8 *ots_key){
+	memset(ots_key, 0, seedlen);
+	ots_key[0] = (u8)(key & 0xFF);
+	ots_key[1] = (u8)((key >> 8) & 0xFF);
+	ots_key[2] = (u8)((key >> 16) & 0xFF);
+	ots_key[3] = (u8)((key >> 24) & 0xFF);
+}
+
+//Fingerprint of the KSN-OTS signature of the fixed message under a key
+static u64 rainbow_hash(const ksnots_fixed_msg *fixed_M, u32 key){
+	u8 ots_key[seedlen];
+	u8 sksum[sklen * 8];
+
+	rainbow_key_to_bytes(key, ots_key);
+	KSNOTS_sign_fixed(ots_key, fixed_M, sksum);
+	return sksum_fingerprint(sksum);
+}
+
+//Moves 8 keys, one per lane of KSNOTS_sign_x8, through column column of their chains
+static void rainbow_step_x8(const ksnots_fixed_msg *fixed_M, u32 keys[8], u32 column,
+                            int chopped_key_size){
+	u8 ots_keys[8][seedlen];
+	u8 sksums[8][sklen * 8];
+	u8 *ots_key_lanes[8];
+	u8 *sksum_lanes[8];
+	int lane;
+
+	for(lane = 0; lane < 8; lane++){
+		rainbow_key_to_bytes(keys[lane], ots_keys[lane]);
+		ots_key_lanes[lane] = ots_keys[lane];
+		sksum_lanes[lane] = sksums[lane];
+	}
+	KSNOTS_sign_x8(ots_key_lanes, fixed_M, sksum_lanes);
+	for(lane = 0; lane < 8; lane++){
+		keys[lane] = rainbow_reduce(sksum_fingerprint(sksums[lane]), column, chopped_key_size);
+	}
+}
+
+//Orders chains by end key, and equal end keys by start key so that files are reproducible
+static int rainbow_chain_cmp(const void *a, const void *b){
+	const rainbow_chain *x = a, *y = b;
+
+	if(x->end != y->end) return x->end < y->end ? -1 : 1;
+	return (x->start > y->start) - (x->start < y->start);
+}
+
+// Reduction function of column column: maps the fingerprint of a KSN-OTS signature back to a key of
+// chopped_key_size bits. Every column reduces differently, so that chains which collide in
+// different columns do not merge.
+// Params:
+//  u64 fingerprint: fingerprint of a KSN-OTS signature, as computed by sksum_fingerprint
+//  u32 column: column of the chain
+//  int chopped_key_size: size of the keys in bits
+// Return: the key the fingerprint reduces to
+u32 rainbow_reduce(u64 fingerprint, u32 column, int chopped_key_size){
+	u64 x = fingerprint ^ ((u64)column * 0x9E3779B97F4A7C15ULL);
+
+	x ^= x >> 30;
+	x *= 0xBF58476D1CE4E5B9ULL;
+	x ^= x >> 27;
+	x *= 0x94D049BB133111EBULL;
+	x ^= x >> 31;
+	return (u32)(x & (((u64)1 << chopped_key_size) - 1));
+}
+
+// Builds a rainbow table of num_chains chains of chain_length columns for message M and writes it
+// to a file. Chain i starts at key i, so num_chains must not exceed 2^chopped_key_size. The chains
+// are held in memory while they are sorted. Covering most keys takes about as many chains times
+// columns as there are keys, with chain_length traded against the size of the table.
+// Params:
+//  FILE *f: file to write, opened in binary mode
+//  k2sn_ctx *ctx: context whose 1-CFF state is used to fix M
+//  u8 *M: message the table is built for, of length msglen
+//  int chopped_key_size: size of the keys in bits, at most RAINBOW_TABLE_MAX_KEY_SIZE
+//  u32 chain_length: number of columns of every chain
+//  u64 num_chains: number of chains to build
+//  void (*progress)(u64, u64): if not NULL, called with the number of chains built so far and
+//    num_chains after every batch of chains
+// Return: 1 on success, negative number otherwise
+int rainbow_table_write(FILE *f, k2sn_ctx *ctx, u8 *M, int chopped_key_size, u32 chain_length,
+                        u64 num_chains, void (*progress)(u64 built, u64 num_chains)){
+	u8 buf[RAINBOW_TABLE_HEADER_SIZE] = {0};
+	rainbow_table_header header;
+	ksnots_fixed_msg fixed_M;
+	rainbow_chain *chains;
+	u32 keys[8];
+	u64 i, kept;
+	u32 column;
+	int lane;
+
+	if(chopped_key_size < 1 || chopped_key_size > RAINBOW_TABLE_MAX_KEY_SIZE || chain_length == 0 ||
+	     num_chains == 0 || num_chains > ((u64)1 << chopped_key_size)) return -1;
+
+	chains = malloc(num_chains * sizeof(rainbow_chain));
+	if(chains == NULL) return -1;
+	KSNOTS_fix_message(ctx, M, &fixed_M);
+
+	//Chains are walked 8 at a time. Lanes past the last chain repeat a chain and are dropped
+	for(i = 0; i < num_chains; i += 8){
+		for(lane = 0; lane < 8; lane++){
+			keys[lane] = (u32)(i + lane < num_chains ? i + lane : i);
+		}
+		for(column = 0; column < chain_length; column++){
+			rainbow_step_x8(&fixed_M, keys, column, chopped_key_size);
+		}
+		for(lane = 0; lane < 8 && i + lane < num_chains; lane++){
+			chains[i + lane].end = keys[lane];
+			chains[i + lane].start = (u32)(i + lane);
+		}
+		if(progress != NULL) progress(i + lane, num_chains);
+	}
+
+	//Chains with the same end key merged somewhere along the way, so only the first is kept
+	qsort(chains, num_chains, sizeof(rainbow_chain), rainbow_chain_cmp);
+	kept = 0;
+	for(i = 0; i < num_chains; i++){
+		if(kept == 0 || chains[kept - 1].end != chains[i].end) chains[kept++] = chains[i];
+	}
+
+	memcpy(header.magic, RAINBOW_TABLE_MAGIC, sizeof(header.magic));
+	header.secret_key_length = sklen;
+	header.subset_size = tb2;
+	header.chopped_key_size = chopped_key_size;
+	header.chain_length = chain_length;
+	header.num_chains = kept;
+	memcpy(header.message, M, msglen);
+	memcpy(buf, &header, sizeof(header));
+
+	if(fwrite(buf, RAINBOW_TABLE_HEADER_SIZE, 1, f) != 1 ||
+	     fwrite(chains, sizeof(rainbow_chain), kept, f) != kept){
+		free(chains);
+		return -1;
+	}
+	free(chains);
+	return 1;
+}
+
+// Maps a rainbow table file into memory and checks that it was written for this build
+// Params:
+//  rainbow_table *rt: filled with the mapping
+//  const char *path: path of the rainbow table file
+// Return: 1 on success, negative number otherwise. An error message is printed on failure
+int rainbow_table_open(rainbow_table *rt, const char *path){
+	struct stat st;
+	const rainbow_table_header *header;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if(fd < 0){
+		perror(path);
+		return -1;
+	}
+	if(fstat(fd, &st) < 0){
+		perror(path);
+		close(fd);
+		return -1;
+	}
+	if(st.st_size < RAINBOW_TABLE_HEADER_SIZE){
+		fprintf(stderr, "%s: not a rainbow table\n", path);
+		close(fd);
+		return -1;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED){
+		perror(path);
+		return -1;
+	}
+
+	header = map;
+	if(memcmp(header->magic, RAINBOW_TABLE_MAGIC, sizeof(header->magic)) != 0){
+		fprintf(stderr, "%s: not a rainbow table\n", path);
+		munmap(map, st.st_size);
+		return -1;
+	}
+	if(header->secret_key_length != sklen || header->subset_size != tb2 ||
+	     header->chopped_key_size < 1 || header->chopped_key_size > RAINBOW_TABLE_MAX_KEY_SIZE ||
+	     header->chain_length == 0){
+		fprintf(stderr, "%s: rainbow table was written for different parameters\n", path);
+		munmap(map, st.st_size);
+		return -1;
+	}
+	if((u64)st.st_size < RAINBOW_TABLE_HEADER_SIZE + header->num_chains * sizeof(rainbow_chain)){
+		fprintf(stderr, "%s: rainbow table is truncated\n", path);
+		munmap(map, st.st_size);
+		return -1;
+	}
+
+	//Every lookup binary searches the end keys
+	madvise(map, st.st_size, MADV_RANDOM);
+
+	rt->header = header;
+	rt->chains = (const rainbow_chain *)((const u8 *)map + RAINBOW_TABLE_HEADER_SIZE);
+	rt->map_size = st.st_size;
+	return 1;
+}
+
+// Unmaps a rainbow table file
+// Params:
+//  rainbow_table *rt: file opened by rainbow_table_open
+void rainbow_table_close(rainbow_table *rt){
+	munmap((void *)rt->header, rt->map_size);
+	rt->header = NULL;
+	rt->chains = NULL;
+}
+
+//Finds the chain ending at key end, and sets start to its start key. Returns 1 if there is one
+static int rainbow_table_find(const rainbow_table *rt, u32 end, u32 *start){
+	u64 lo = 0, hi = rt->header->num_chains, mid;
+
+	while(lo < hi){
+		mid = lo + (hi - lo) / 2;
+		if(rt->chains[mid].end < end) lo = mid + 1;
+		else hi = mid;
+	}
+	if(lo == rt->header->num_chains || rt->chains[lo].end != end) return 0;
+	*start = rt->chains[lo].start;
+	return 1;
+}
+
+// Searches the table for the keys whose KSN-OTS signatures of the table's message have the given
+// fingerprints. The fingerprints are walked to the end of the chains 8 at a time, one per lane of
+// KSNOTS_sign_x8. A key is only found if one of the chains of the table passes through it.
+// Params:
+//  const rainbow_table *rt: open rainbow table
+//  const ksnots_fixed_msg *fixed_M: the message of the table, as prepared by KSNOTS_fix_message
+//  const u64 *fingerprints: fingerprints to search for, as computed by sksum_fingerprint
+//  long num_fingerprints: length of fingerprints
+//  long *keys: filled with the key found for each fingerprint, or -1 if none was found. Assumes
+//    array is of length num_fingerprints
+// Return: number of keys found
+long rainbow_table_lookup(const rainbow_table *rt, const ksnots_fixed_msg *fixed_M,
+                          const u64 *fingerprints, long num_fingerprints, long *keys){
+	int chopped_key_size = rt->header->chopped_key_size;
+	u32 chain_length = rt->header->chain_length;
+	long *pending = malloc(num_fingerprints * sizeof(long));
+	long num_pending, num_found = 0, b, f;
+	u32 lanes[8], column, c, start, key;
+	int lane;
+
+	for(f = 0; f < num_fingerprints; f++) keys[f] = -1;
+
+	//Try the columns from the last one, whose chains are the cheapest to walk to their end, and
+	//  stop searching for a fingerprint once its key is found
+	for(c = chain_length; c-- > 0;){
+		num_pending = 0;
+		for(f = 0; f < num_fingerprints; f++){
+			if(keys[f] < 0) pending[num_pending++] = f;
+		}
+
+		for(b = 0; b < num_pending; b += 8){
+			//Suppose the fingerprint is of the key in column c, and walk it to the end of the chain.
+			//  Lanes past the last pending fingerprint repeat it and are not checked
+			for(lane = 0; lane < 8; lane++){
+				f = pending[b + lane < num_pending ? b + lane : num_pending - 1];
+				lanes[lane] = rainbow_reduce(fingerprints[f], c, chopped_key_size);
+			}
+			for(column = c + 1; column < chain_length; column++){
+				rainbow_step_x8(fixed_M, lanes, column, chopped_key_size);
+			}
+
+			for(lane = 0; lane < 8 && b + lane < num_pending; lane++){
+				f = pending[b + lane];
+				if(!rainbow_table_find(rt, lanes[lane], &start)) continue;
+
+				//Walk the chain from its start to column c. Its key there only has the fingerprint
+				//  if the chain did not merge into the stored one after column c
+				key = start;
+				for(column = 0; column < c; column++){
+					key = rainbow_reduce(rainbow_hash(fixed_M, key), column, chopped_key_size);
+				}
+				if(rainbow_hash(fixed_M, key) == fingerprints[f]){
+					keys[f] = key;
+					num_found++;
+				}
+			}
+		}
+	}
+
+	free(pending);
+	return num_found;
+}
@@ -0,0 +1,95 @@
+#ifndef RAINBOW_TABLE_H_
+#define RAINBOW_TABLE_H_
+
+
+#include "ksnmss.h"
+
+#define RAINBOW_TABLE_MAGIC "K2SNRAIN"
+//Size of the header of a rainbow table file. The chains that follow it start at this offset
+#define RAINBOW_TABLE_HEADER_SIZE 64
+//Largest chopped key size a rainbow table covers, as the keys of its chains are stored in 32 bits
+#define RAINBOW_TABLE_MAX_KEY_SIZE 32
+
+// Header of a rainbow table file. chop leaves a secret OTS key with only its chopped_key_size low
+// bits, so a key is a number below 2^chopped_key_size, stored little-endian in the key. Column c of
+// a chain maps key x to rainbow_reduce(sksum_fingerprint(KSNOTS_sign(x, message)), c), and every
+// chain walks chain_length columns from its start key to its end key. Only the start and end keys
+// of the chains are stored, sorted by end key, with chains that merged into an earlier one's end
+// key removed. The file is in the byte order of the machine that wrote it, and the parameters of
+// the build are stored so that a table is only used by builds it was written for.
+typedef struct rainbow_table_header{
+	char magic[8];
+	u32 secret_key_length;
+	u32 subset_size;
+	u32 chopped_key_size;
+	u32 chain_length;
+	u64 num_chains;
+	u8 message[msglen];
+}rainbow_table_header;
+
+// A chain of a rainbow table, by its end key and start key
+typedef struct rainbow_chain{
+	u32 end;
+	u32 start;
+}rainbow_chain;
+
+// A rainbow table file mapped read-only into memory
+typedef struct rainbow_table{
+	const rainbow_table_header *header;
+	const rainbow_chain *chains;
+	size_t map_size;
+}rainbow_table;
+
+// Reduction function of column column: maps the fingerprint of a KSN-OTS signature back to a key of
+// chopped_key_size bits. Every column reduces differently, so that chains which collide in
+// different columns do not merge.
+// Params:
+//  u64 fingerprint: fingerprint of a KSN-OTS signature, as computed by sksum_fingerprint
+//  u32 column: column of the chain
+//  int chopped_key_size: size of the keys in bits
+// Return: the key the fingerprint reduces to
+u32 rainbow_reduce(u64 fingerprint, u32 column, int chopped_key_size);
+
+// Builds a rainbow table of num_chains chains of chain_length columns for message M and writes it
+// to a file. Chain i starts at key i, so num_chains must not exceed 2^chopped_key_size. The chains
+// are held in memory while they are sorted. Covering most keys takes about as many chains times
+// columns as there are keys, with chain_length traded against the size of the table.
+// Params:
+//  FILE *f: file to write, opened in binary mode
+//  k2sn_ctx *ctx: context whose 1-CFF state is used to fix M
+//  u8 *M: message the table is built for, of length msglen
+//  int chopped_key_size: size of the keys in bits, at most RAINBOW_TABLE_MAX_KEY_SIZE
+//  u32 chain_length: number of columns of every chain
+//  u64 num_chains: number of chains to build
+//  void (*progress)(u64, u64): if not NULL, called with the number of chains built so far and
+//    num_chains after every batch of chains
+// Return: 1 on success, negative number otherwise
+int rainbow_table_write(FILE *f, k2sn_ctx *ctx, u8 *M, int chopped_key_size, u32 chain_length,
+                        u64 num_chains, void (*progress)(u64 built, u64 num_chains));
+
+// Maps a rainbow table file into memory and checks that it was written for this build
+// Params:
+//  rainbow_table *rt: filled with the mapping
+//  const char *path: path of the rainbow table file
+// Return: 1 on success, negative number otherwise. An error message is printed on failure
+int rainbow_table_open(rainbow_table *rt, const char *path);
+
+// Unmaps a rainbow table file
+// Params:
+//  rainbow_table *rt: file opened by rainbow_table_open
+void rainbow_table_close(rainbow_table *rt);
+
+// Searches the table for the keys whose KSN-OTS signatures of the table's message have the given
+// fingerprints. The fingerprints are walked to the end of the chains 8 at a time, one per lane of
+// KSNOTS_sign_x8. A key is only found if one of the chains of the table passes through it.
+// Params:
+//  const rainbow_table *rt: open rainbow table
+//  const ksnots_fixed_msg *fixed_M: the message of the table, as prepared by KSNOTS_fix_message
+//  const u64 *fingerprints: fingerprints to search for, as computed by sksum_fingerprint
+//  long num_fingerprints: length of fingerprints
+//  long *keys: filled with the key found for each fingerprint, or -1 if none was found. Assumes
+//    array is of length num_fingerprints
+// Return: number of keys found
+long rainbow_table_lookup(const rainbow_table *rt, const ksnots_fixed_msg *fixed_M,
+                          const u64 *fingerprints, long num_fingerprints, long *keys);
+#endif
@@ -56,6 +56,7 @@
 
 extern void bntt16(int xbyte[16][4], vec Y[16][4]);
 inline void bntt16(int xbyte[16][4], vec Y[16][4]){
+	vec Y_temp1[4], Y_temp2[5];
 	for(int row=0;row<16;row++){	
 		vecMult16Reduce3(M_K0_I0[0], T_K0_I0[xbyte[row][0]], Y_temp1[0]); 
 		vecMult16Reduce3(M_K0_I0[1], T_K0_I0[xbyte[row][1]], Y_temp1[1]);
@@ -86,6 +87,7 @@ extern void gntt16(vec key[16][4], vec A[16][4]);
 inline void gntt16(vec key[16][4], vec A[16][4]){
 	vec t1,t2,t3,t4;
 	vec temp[4];
+	vec Y_temp1[4], Y_temp2[5];
 	for(int row=0;row<16;row++){
 		for(int k0=0; k0<4; k0++){
 			temp[k0] = zero;
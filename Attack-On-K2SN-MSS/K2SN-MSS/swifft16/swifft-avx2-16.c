@@ -98,6 +98,8 @@ inline void SWIFFT(int xbyte[16][4],vec A[16][4], u8 *hop){
 	int t;
 	vec op_temp[8];
 	vec mk0i0, poi1k0;
+	//Scratch is local rather than the shared Y/Y_temp1/op, so that threads can hash concurrently
+	vec Y[16][4], Y_temp1[16], op[4];
 		
 	bntt16(xbyte,Y);
 	//print(Y[0][3]);
@@ -139,14 +141,11 @@ inline void SWIFFT(int xbyte[16][4],vec A[16][4], u8 *hop){
 
 }
 
+void gSWIFFT_vec(vec X[16][4], vec A[16][4], u32 *pk);
+
 int gSWIFFT(int x[16][64], vec A[16][4], u32 *pk){
-	int i1;
 	int k0;
-	vec Yt[8];
-	int t;
-	vec op_temp[8];
-	vec mk0i0, poi1k0;
-	vec X[16][4],Y[16][4];
+	vec X[16][4];
 
 	for(int row=0;row<16;row++){
 		for(k0=0; k0 < 4; k0++){
@@ -169,6 +168,15 @@ int gSWIFFT(int x[16][64], vec A[16][4], u32 *pk){
 		}
 	}
 
+	gSWIFFT_vec(X,A,pk);
+}
+
+// gSWIFFT on input that is already in its 16-bit vector layout: coefficient 16*k0+m of row is
+// lane m of X[row][k0]
+void gSWIFFT_vec(vec X[16][4], vec A[16][4], u32 *pk){
+	vec op_temp[8];
+	vec Y[16][4], Y_temp1[16], op[4];
+
 	gntt16(X,Y);
 	//for(int i=0;i<16;i++) {print(Y[i][0]);print(Y[i][1]);print(Y[i][2]);print(Y[i][3]);}
 	for(int i=0; i<4; i++){
@@ -229,63 +237,64 @@ int gSWIFFT(int x[16][64], vec A[16][4], u32 *pk){
 	}
 }
 */
-void set_Key(u32 indx, u32 height){
-	int y[16][64];
-	int i,k,j;
+// Hash key of a K2SN-MSS keypair. The gSWIFFT key of node (indx, height) widens the 1024-byte 
+// ChaCha20 encryption, under the hash key seed and iv, of a buffer that holds only indx in bytes 
+// 0..3 and height in byte 512. The keystream is the same for every node, so every key is base, the 
+// widened keystream, with those 5 coefficients XORed in.
+typedef struct swifft_key{
+	vec base[16][4];
+}swifft_key;
+
+void swifft_key_setup(swifft_key *hk, const u8 *key_seed, const u8 *key_iv);
+void set_Key(const swifft_key *hk, u32 indx, u32 height, vec A[16][4]);
+
+// Generates the keystream of the hash key seed and iv once, into hk
+void swifft_key_setup(swifft_key *hk, const u8 *key_seed, const u8 *key_iv){
 	int t1,t2;
-	int t;
-	int om_odd_pow[64];
-	vec om_base[8], om_temp[8][8], key[16][4],temp[4];
-	vec tk0i0k[8];
 	ECRYPT_ctx seed_ctx;
 
 	u8 ina[1024]={0};
+	u8 a[1024];
 
-	//for(i=0;i<32;i++){
-	//	for(j=0;j<32;j++){
-	//		printf("%hhu,",ina[i*32+j]);
-	//	}
-	//	printf("\n");
-	//}
-
-	ina[0] = indx & 255; indx = indx >>8;
-	ina[1] = indx & 255; indx = indx >>8;
-	ina[2] = indx & 255; indx = indx >>8;
-	ina[3] = indx & 255;
-
-	ina[512] = height;
-
-	ECRYPT_keysetup(&seed_ctx,hk_seed,256,64);
-	ECRYPT_ivsetup(&seed_ctx,hk_iv);
+	ECRYPT_keysetup(&seed_ctx,key_seed,256,64);
+	ECRYPT_ivsetup(&seed_ctx,key_iv);
 	ECRYPT_encrypt_bytes(&seed_ctx,ina,a,1024);
-	
-	vec Y_temp1[4],Y_temp2[8],Y_temp3[8];
-
 
 	for(int row=0;row<16;row++){
 		t1 = 64*row;
 		for(int k0=0; k0 < 4; k0++){
 			t2 = t1 + 16*k0;
-			0[(u16 *) &(A[row][k0])]  = a[t2+0];
-			1[(u16 *) &(A[row][k0])]  = a[t2+1];
-			2[(u16 *) &(A[row][k0])]  = a[t2+2];
-			3[(u16 *) &(A[row][k0])]  = a[t2+3];
-			4[(u16 *) &(A[row][k0])]  = a[t2+4];
-			5[(u16 *) &(A[row][k0])]  = a[t2+5];
-			6[(u16 *) &(A[row][k0])]  = a[t2+6];
-			7[(u16 *) &(A[row][k0])]  = a[t2+7];
-			8[(u16 *) &(A[row][k0])]  = a[t2+8];
-			9[(u16 *) &(A[row][k0])]  = a[t2+9];
-			10[(u16 *) &(A[row][k0])] = a[t2+10];
-			11[(u16 *) &(A[row][k0])] = a[t2+11];
-			12[(u16 *) &(A[row][k0])] = a[t2+12];
-			13[(u16 *) &(A[row][k0])] = a[t2+13];
-			14[(u16 *) &(A[row][k0])] = a[t2+14];
-			15[(u16 *) &(A[row][k0])] = a[t2+15];
+			0[(u16 *) &(hk->base[row][k0])]  = a[t2+0];
+			1[(u16 *) &(hk->base[row][k0])]  = a[t2+1];
+			2[(u16 *) &(hk->base[row][k0])]  = a[t2+2];
+			3[(u16 *) &(hk->base[row][k0])]  = a[t2+3];
+			4[(u16 *) &(hk->base[row][k0])]  = a[t2+4];
+			5[(u16 *) &(hk->base[row][k0])]  = a[t2+5];
+			6[(u16 *) &(hk->base[row][k0])]  = a[t2+6];
+			7[(u16 *) &(hk->base[row][k0])]  = a[t2+7];
+			8[(u16 *) &(hk->base[row][k0])]  = a[t2+8];
+			9[(u16 *) &(hk->base[row][k0])]  = a[t2+9];
+			10[(u16 *) &(hk->base[row][k0])] = a[t2+10];
+			11[(u16 *) &(hk->base[row][k0])] = a[t2+11];
+			12[(u16 *) &(hk->base[row][k0])] = a[t2+12];
+			13[(u16 *) &(hk->base[row][k0])] = a[t2+13];
+			14[(u16 *) &(hk->base[row][k0])] = a[t2+14];
+			15[(u16 *) &(hk->base[row][k0])] = a[t2+15];
 		}
 	}
-	
-	
+}
+
+// Derives the gSWIFFT key of the node at (indx, height) into A, by patching the base key of hk.
+// Byte i of the encrypted buffer is coefficient i%16 of A[i/64][(i%64)/16].
+void set_Key(const swifft_key *hk, u32 indx, u32 height, vec A[16][4]){
+	memcpy(A, hk->base, sizeof(hk->base));
+
+	0[(u16 *) &(A[0][0])] ^= indx & 255; indx = indx >>8;
+	1[(u16 *) &(A[0][0])] ^= indx & 255; indx = indx >>8;
+	2[(u16 *) &(A[0][0])] ^= indx & 255; indx = indx >>8;
+	3[(u16 *) &(A[0][0])] ^= indx & 255;
+
+	0[(u16 *) &(A[8][0])] ^= height & 255;
 }
 void unpack_rgY(vec Y[4],u32 *pk){
 	int i,j;
@@ -0,0 +1,83 @@
+/*
+ * Builds a pool of K2SN-MSS keypairs for the ISG Attack on K2SN-MSS
+*/
+
+#include "K2SN-MSS/measurement.h"
+#include <time.h>
+#include <pthread.h>
+#include "K2SN-MSS/merkle-tree.h"
+#include "K2SN-MSS/ChaCha20/chacha.c"
+#include "K2SN-MSS/ChaCha20/chacha-x8.c"
+#include "K2SN-MSS/swifft16/swifft-avx2-16.c"
+#include "K2SN-MSS/ksnmss.c"
+#include "K2SN-MSS/keypair-file.c"
+#include <x86intrin.h>
+
+// Default number of key generation worker threads
+#ifndef ISG_NUM_THREADS
+    #define ISG_NUM_THREADS 1
+#endif
+
+// Generates keypairs with random seeds and writes them to a keypair file, which the attack loads
+//   with its -k option
+// Params (from command line):
+//   string: Path of the keypair file to write
+//   int: Number of keypairs
+//   int: Size of chopped keys in bits
+//   int (optional): Store the leaves of every keypair or not. (0 for no leaves, 1 for leaves)
+int main(int argc, char *argv[]) {
+	if (argc < 4) {
+		fprintf(stderr, "usage: %s <keypair file> <number of keypairs> <chopped key size> "
+		          "[<store leaves>]\n", argv[0]);
+		return 1;
+	}
+	const char *path = argv[1];
+	u32 num_keypairs = atoi(argv[2]);
+	int chopped_key_size = atoi(argv[3]);
+	int has_leaves = argc >= 5 ? atoi(argv[4]) : 0;
+
+	//(Note - srand is not cryptographically suitable, but for the purpose of this test it is
+	//  sufficient)
+	srand(time(0));
+	set_binotable();
+
+	FILE *f = fopen(path, "wb");
+	if (f == NULL) {
+		perror(path);
+		return 1;
+	}
+	if (keypair_file_write_header(f, num_keypairs, has_leaves) < 0) {
+		perror(path);
+		return 1;
+	}
+
+	//The context holds the signer state of a whole tree, so it is kept off the stack, aligned for
+	//  its vector members
+	k2sn_ctx *ctx = aligned_alloc(_Alignof(k2sn_ctx), sizeof(k2sn_ctx));
+	node *leaves = has_leaves ? malloc(usr * sizeof(node)) : NULL;
+	for (u32 k = 0; k < num_keypairs; k++) {
+		memset(ctx, 0, sizeof(k2sn_ctx));
+		ctx->chopped_key_size = chopped_key_size;
+		for (int i = 0; i < seedlen; i++) ctx->system_seed[i] = rand() % 255;
+		for (int i = 0; i < ivlen; i++) ctx->system_iv[i] = rand() % 255;
+		for (int i = 0; i < seedlen; i++) ctx->randompad_seed[i] = rand() % 255;
+		for (int i = 0; i < ivlen; i++) ctx->randompad_iv[i] = rand() % 255;
+		for (int i = 0; i < seedlen; i++) ctx->hk_seed[i] = rand() % 255;
+		for (int i = 0; i < ivlen; i++) ctx->hk_iv[i] = rand() % 255;
+
+		key_generation(ctx, ISG_NUM_THREADS, leaves);
+		if (keypair_file_write_record(f, ctx, leaves) < 0) {
+			perror(path);
+			return 1;
+		}
+		printf("Generated keypair %u of %u\n", k + 1, num_keypairs);
+	}
+	free(leaves);
+	free(ctx);
+
+	if (fclose(f) != 0) {
+		perror(path);
+		return 1;
+	}
+	return 0;
+}
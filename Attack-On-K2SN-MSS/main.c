@@ -5,10 +5,16 @@
 
 #include "K2SN-MSS/measurement.h"
 #include <time.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "K2SN-MSS/merkle-tree.h"
 #include "K2SN-MSS/ChaCha20/chacha.c"
+#include "K2SN-MSS/ChaCha20/chacha-x8.c"
 #include "K2SN-MSS/swifft16/swifft-avx2-16.c"
 #include "K2SN-MSS/ksnmss.c"
+#include "K2SN-MSS/keypair-file.c"
+#include "K2SN-MSS/rainbow-table.c"
 #include <x86intrin.h>
 #include "main.h"
 
@@ -25,33 +31,358 @@ int increment_bytes(u8 *bytes, int num_bytes){
 	}
 }
 
-// Allocation function for adding ksnmss_sig to a gdsl bstree
+// Writes guess index guess into the byte array, using the same little-endian layout that 
+//   increment_bytes() counts in, so the guess-th secret key tried by the Secret-Guessing phase is 
+//   independent of which worker tries it
 // Params:
-//   void * sig: pointer to ksnmss_sig to add to bstree
+//   u8 *bytes: byte array to write
+//   int num_bytes: length of byte array
+//   long guess: guess index
+void guess_to_bytes(u8 *bytes, int num_bytes, long guess){
+	for (int i = 0; i < num_bytes; i++) {
+		bytes[i] = (u8)guess;
+		guess = (unsigned long)guess >> 8;
+	}
+}
+
+// Allocates an empty signature index for up to num_sigs signatures
+// Params:
+//   sig_index *index: index to initialize
+//   long num_sigs: maximum number of signatures that will be inserted
+void sig_index_init(sig_index *index, long num_sigs) {
+	u64 num_slots = 2;
+
+	while (num_slots < 2 * (u64) num_sigs) {
+		num_slots <<= 1;
+	}
+	index->slots = calloc(num_slots, sizeof(sig_index_slot));
+	index->mask = num_slots - 1;
+}
+
+// Frees the slots of a signature index
+// Params:
+//   sig_index *index: index to free
+void sig_index_free(sig_index *index) {
+	free(index->slots);
+	index->slots = NULL;
+}
+
+// Adds a signature fingerprint to the index. If the fingerprint is already present, the index is 
+//   left unchanged, so the first instance to produce a signature is the one that is kept.
+// Params:
+//   sig_index *index: index to add to
+//   u64 fingerprint: fingerprint of the signature, as computed by sksum_fingerprint()
+//   u32 id: index of the K2SN-MSS instance which produced the signature
 // Return:
-//   gdsl_element_t: pointer to ksnmss_sig in the tree
-gdsl_element_t KSNMSS_Signature_Alloc(void * sig){
-	void *ptr = malloc(sizeof(ksnmss_sig));
-	memcpy(ptr, sig, sizeof(ksnmss_sig));
-	return ptr;
+//   int: 1 if the fingerprint was added, 0 if it was already present
+int sig_index_insert(sig_index *index, u64 fingerprint, u32 id) {
+	u64 slot = fingerprint & index->mask;
+
+	while (index->slots[slot].fingerprint != 0) {
+		if (index->slots[slot].fingerprint == fingerprint) {
+			return 0;
+		}
+		slot = (slot + 1) & index->mask;
+	}
+	index->slots[slot].fingerprint = fingerprint;
+	index->slots[slot].id = id;
+	return 1;
 }
 
-// Free function for freeing ksnmss_sig from gdslbstree
-// Params: 
-//   gdsl_element_t E: pointer to ksnmss_sig to remove
-void KSNMSS_Signature_Free(gdsl_element_t E) {
-	free(E);
+// Looks up a signature fingerprint in the index
+// Params:
+//   const sig_index *index: index to search
+//   u64 fingerprint: fingerprint to search for
+//   u32 *id: set to the instance id stored with the fingerprint, if it is found
+// Return:
+//   int: 1 if the fingerprint was found, 0 otherwise
+int sig_index_find(const sig_index *index, u64 fingerprint, u32 *id) {
+	u64 slot = fingerprint & index->mask;
+
+	while (index->slots[slot].fingerprint != 0) {
+		if (index->slots[slot].fingerprint == fingerprint) {
+			*id = index->slots[slot].id;
+			return 1;
+		}
+		slot = (slot + 1) & index->mask;
+	}
+	return 0;
 }
 
-// Compare function to compare ksnmss_sig elements in bstree. Only compares ksnmss_sig.sksum member,
-//  and ignores the rest of the signature.
+// Recomputes the KSN-OTS public key of the id'th K2SN-MSS instance, as returned with the oracle's 
+//   signature for that instance. Leaves the gSWIFFT key A of ctx set for the instance.
 // Params:
-//   const gdsl_element_t E: pointer to ksnmss_sig
-//   void* VALUE: pointer to ksnmss_sig
+//   k2sn_ctx *ctx: keypair of the signing oracle
+//   u32 id: index of the K2SN-MSS instance
+//   node *pk: Pointer to array which will be filled with the public key. Assumes length is t
+void regenerate_ots_pk(k2sn_ctx *ctx, u32 id, node *pk) {
+	u8 idu8[seedlen];
+	sk_node sk[t];
+	ECRYPT_ctx seed_ctx;
+
+	memset(idu8, 0, seedlen);
+	idu8[0] = (u8)(id & 0xFF);
+	idu8[1] = (u8)((id >> 8) & 0xFF);
+	idu8[2] = (u8)((id >> 16) & 0xFF);
+	idu8[3] = (u8)((id >> 24) & 0xFF);
+	generate_secret_key_OTS(ctx, &seed_ctx, idu8, sk);
+	set_Key(&ctx->hash_key, id, 0, ctx->A);
+	generate_public_key_OTS(sk, pk, ctx->A);
+}
+
+// Returns 1 if some target has not forged with a guess index at or below guess, 0 otherwise
+static int guess_wanted(guess_phase *gp, long guess){
+	for (int i = 0; i < gp->num_targets; i++) {
+		if (atomic_load_explicit(&gp->targets[i].success_guess, memory_order_relaxed) > guess)
+			return 1;
+	}
+	return 0;
+}
+
+// Checks one guessed secret OTS key against one target, given its KSN-OTS signature of M. If an 
+//   oracle signature contains the same KSN-OTS signature, forges a K2SN-MSS signature of a new 
+//   message with the guess. Returns 1 if the forged signature verifies, 0 otherwise.
+static int try_guess(guess_worker *worker, attack_target *target, u8 *ots_sk_guess, 
+                     u64 fingerprint){
+	guess_phase *gp = worker->gp;
+	k2sn_ctx *ctx = &worker->ctx;
+	u32 found_id;
+	int i;
+
+	//Search the index for a K2SN-MSS signature which contains the same KSN-OTS signature. 
+	//  Fingerprints can collide, but then the forged signature below does not verify
+	if (!sig_index_find(&target->sig_lookup, fingerprint, &found_id)) {
+		return 0;
+	}
+
+	//Check the hit with the worker's context. Checking and rebuilding an authentication path only 
+	//  read the seeds, random pad keystream and gSWIFFT key of the oracle's keypair, so they are 
+	//  copied once per oracle rather than the whole signer state
+	if (worker->keypair != target->ctx) {
+		ctx->chopped_key_size = target->ctx->chopped_key_size;
+		memcpy(ctx->system_seed, target->ctx->system_seed, seedlen);
+		memcpy(ctx->randompad_keystream, target->ctx->randompad_keystream, sklen);
+		ctx->hash_key = target->ctx->hash_key;
+		worker->keypair = target->ctx;
+	}
+
+	//Recompute the public key of the instance that was hit
+	node found_pk[t];
+	regenerate_ots_pk(ctx, found_id, found_pk);
+
+	//Choose new message - we will forge a signature for this message
+	u8 M_F[msglen];
+	do {
+		for (i = 0; i < msglen; i++) M_F[i] = rand_r(&worker->rand_state) % 256;
+	} while (memcmp(M_F, gp->M, msglen) == 0);
+
+	//Forge KSN-OTS signature of M_F
+	u8 ots_sig_M_F[sklen * 8];
+	KSNOTS_sign(ctx, ots_sk_guess, M_F, ots_sig_M_F);
+
+	//If forged OTS siganture is not valid, the guess failed
+	if (KSNOTS_verify(ctx, found_pk, M_F, ots_sig_M_F, found_id) != 1) {
+		return 0;
+	}
+
+	//Construct K2SN-MSS forger of M_F
+	ksnmss_sig mss_sig_M_F;
+	mss_sig_M_F.id = found_id;
+	memcpy(mss_sig_M_F.message, M_F, msglen);
+	memcpy(mss_sig_M_F.sksum, ots_sig_M_F, sklen * 8);
+	memcpy(&mss_sig_M_F.pk, found_pk, t * pklen);
+	if (target->leaves != NULL) {
+		struct timespec rebuild_start, rebuild_end;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &rebuild_start);
+		if (ksnmss_auth_path(ctx, target->leaves, found_id, mss_sig_M_F.auth) < 0) {
+			fprintf(stderr, "Could not rebuild the authentication path of instance %u\n", found_id);
+			exit(EXIT_FAILURE);
+		}
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &rebuild_end);
+		atomic_fetch_add(&gp->uncounted_time, 
+		                 (long) ((rebuild_end.tv_sec - rebuild_start.tv_sec) * CLOCKS_PER_SEC + 
+		                         (rebuild_end.tv_nsec - rebuild_start.tv_nsec) / 
+		                           (1000000000L / CLOCKS_PER_SEC)));
+	} else {
+		memcpy(&mss_sig_M_F.auth, target->auth_paths[found_id], h * pklen);
+	}
+
+	//Attack is successful
+	return 1;
+}
+
+// Records checkpoint runtimes and finishes targets as the completed prefix of the guess space 
+//   grows, as guess_phase_advance() in Attack-On-XMSS/isg-attack-xmss.c does. Must be called with
+//   gp->lock held.
+static void guess_phase_advance(guess_phase *gp){
+	long frontier = gp->next_guess;
+	long success;
+	clock_t elapsed, temp_time;
+	attack_target *target;
+	int done = 1;
+
+	for (int w = 0; w < gp->num_workers; w++) {
+		if (gp->workers[w].chunk_start >= 0 && gp->workers[w].chunk_start < frontier)
+			frontier = gp->workers[w].chunk_start;
+	}
+
+	elapsed = clock() - gp->guess_start_time - atomic_load(&gp->uncounted_time);
+
+	for (int i = 0; i < gp->num_targets; i++) {
+		target = &gp->targets[i];
+		success = atomic_load(&target->success_guess);
+		temp_time = target->query_time + elapsed;
+
+		while (target->next_checkpoint_index < gp->num_runtime_checkpoints &&
+		       gp->num_sk_guesses[target->next_checkpoint_index] <= frontier &&
+		       gp->num_sk_guesses[target->next_checkpoint_index] <= success) {
+			target->attack_result->intermediate_runtimes[target->next_checkpoint_index] = temp_time;
+			target->next_checkpoint_index++;
+		}
+
+		if (success < frontier) {
+			for (int k = target->next_checkpoint_index; k < gp->num_runtime_checkpoints; k++) {
+				target->attack_result->intermediate_runtimes[k] = temp_time;
+			}
+			target->next_checkpoint_index = gp->num_runtime_checkpoints;
+			target->attack_result->success_guess = success;
+		}
+
+		if (target->next_checkpoint_index < gp->num_runtime_checkpoints)
+			done = 0;
+	}
+
+	gp->done = done;
+}
+
+// Secret-Guessing phase worker. Chunks are claimed and checkpoints recorded as in 
+//   guess_worker_run() in Attack-On-XMSS/isg-attack-xmss.c.
+// Params:
+//   void *arg: the guess_worker to run
 // Return:
-//   long int: 0 if sksum of E and VALUE are equal, >0 if E > VALUE, and <0 if E < VALUE
-long int KSNMSS_Signature_Cmp(const gdsl_element_t E, void* VALUE) {
-	return (long int) memcmp(((ksnmss_sig *) E)->sksum, ((ksnmss_sig *)VALUE)->sksum, sklen*8);
+//   void *: NULL
+void *guess_worker_run(void *arg){
+	guess_worker *worker = arg;
+	guess_phase *gp = worker->gp;
+	attack_target *target;
+	long guess, end, success;
+	u64 fingerprint;
+	int i, k, lane;
+
+	//Guesses are signed 8 at a time, one per lane, and then checked one by one
+	u8 next_sk_guess[seedlen];
+	u8 sk_guesses[8][seedlen];
+	u8 sig_guesses[8][sklen * 8];
+	u8 *sk_guess_lanes[8];
+	u8 *sig_guess_lanes[8];
+	for (i = 0; i < 8; i++) {
+		sk_guess_lanes[i] = sk_guesses[i];
+		sig_guess_lanes[i] = sig_guesses[i];
+	}
+
+	pthread_mutex_lock(&gp->lock);
+	while (!gp->done && gp->next_guess < gp->num_sk_guesses[gp->num_runtime_checkpoints-1] &&
+	       guess_wanted(gp, gp->next_guess)) {
+		guess = gp->next_guess;
+		end = guess + GUESS_CHUNK_SIZE;
+		for (k = 0; gp->num_sk_guesses[k] <= guess; k++);
+		if (end > gp->num_sk_guesses[k])
+			end = gp->num_sk_guesses[k];
+		gp->next_guess = end;
+		worker->chunk_start = guess;
+		pthread_mutex_unlock(&gp->lock);
+
+		guess_to_bytes(next_sk_guess, seedlen, guess);
+		for (; guess < end && guess_wanted(gp, guess); guess += 8) {
+			//Compute KSN-OTS signatures of M using the next 8 OTS sk guesses as the secret keys. 
+			//  Lanes past the end of the chunk are signed but not checked
+			for (i = 0; i < 8; i++) {
+				memcpy(sk_guesses[i], next_sk_guess, seedlen);
+				increment_bytes(next_sk_guess, seedlen);
+			}
+			KSNOTS_sign_x8(sk_guess_lanes, &gp->fixed_M, sig_guess_lanes);
+
+			for (lane = 0; lane < 8 && guess + lane < end; lane++) {
+				fingerprint = sksum_fingerprint(sig_guesses[lane]);
+				for (i = 0; i < gp->num_targets; i++) {
+					target = &gp->targets[i];
+					if (atomic_load_explicit(&target->success_guess, memory_order_relaxed) <= 
+					      guess + lane)
+						continue;
+					if (try_guess(worker, target, sk_guesses[lane], fingerprint)) {
+						success = atomic_load(&target->success_guess);
+						while (guess + lane < success &&
+						       !atomic_compare_exchange_weak(&target->success_guess, &success,
+						                                     guess + lane));
+					}
+				}
+			}
+		}
+
+		pthread_mutex_lock(&gp->lock);
+		worker->chunk_start = -1;
+		guess_phase_advance(gp);
+	}
+	pthread_mutex_unlock(&gp->lock);
+
+	return NULL;
+}
+
+// Secret-Guessing phase of a rainbow table built for M, run by a single worker. Instead of signing
+//   every guess in turn, the fingerprints of the signatures of every target are looked up in the 
+//   table in one pass, and each key found is tried against the target it came from. Key v is the 
+//   secret OTS key guess_to_bytes() writes for guess index v, so the results are recorded as if 
+//   the guesses had been tried in turn up to the smallest key that forges, with every checkpoint 
+//   taking the time of the lookup. The table only covers part of the key space, so a key that 
+//   trying every guess would find can be missed.
+// Params:
+//   guess_worker *worker: the worker whose context checks the hits
+//   const rainbow_table *rainbow: rainbow table built for the message of the guess phase
+static void guess_phase_rainbow(guess_worker *worker, const rainbow_table *rainbow){
+	guess_phase *gp = worker->gp;
+	attack_target *target;
+	long num_fingerprints = 0, f;
+	u8 sk_guess[seedlen];
+
+	//Gather the fingerprints of every target, so that they are all walked along the chains at once
+	for (int i = 0; i < gp->num_targets; i++) {
+		num_fingerprints += gp->targets[i].sig_lookup.mask + 1;
+	}
+	u64 *fingerprints = malloc(num_fingerprints * sizeof(u64));
+	int *fingerprint_targets = malloc(num_fingerprints * sizeof(int));
+	long *keys = malloc(num_fingerprints * sizeof(long));
+	num_fingerprints = 0;
+	for (int i = 0; i < gp->num_targets; i++) {
+		const sig_index *index = &gp->targets[i].sig_lookup;
+		for (u64 slot = 0; slot <= index->mask; slot++) {
+			if (index->slots[slot].fingerprint != 0) {
+				fingerprints[num_fingerprints] = index->slots[slot].fingerprint;
+				fingerprint_targets[num_fingerprints] = i;
+				num_fingerprints++;
+			}
+		}
+	}
+
+	rainbow_table_lookup(rainbow, &gp->fixed_M, fingerprints, num_fingerprints, keys);
+
+	for (f = 0; f < num_fingerprints; f++) {
+		target = &gp->targets[fingerprint_targets[f]];
+		if (keys[f] < 0 || keys[f] >= atomic_load(&target->success_guess))
+			continue;
+		guess_to_bytes(sk_guess, seedlen, keys[f]);
+		if (try_guess(worker, target, sk_guess, fingerprints[f])) {
+			atomic_store(&target->success_guess, keys[f]);
+		}
+	}
+	free(fingerprints);
+	free(fingerprint_targets);
+	free(keys);
+
+	//Every guess has been accounted for by the lookup
+	pthread_mutex_lock(&gp->lock);
+	gp->next_guess = LONG_MAX;
+	guess_phase_advance(gp);
+	pthread_mutex_unlock(&gp->lock);
 }
 
 // Performs one invocation of the ISG Attack. Simulates invoking the ISG Attack multiple times
@@ -61,176 +392,248 @@ long int KSNMSS_Signature_Cmp(const gdsl_element_t E, void* VALUE) {
 //   and the amount of memory used to store the set of oracle signature queries (which is the same 
 //   for each simulated parameter set).
 // Params:
+//   k2sn_ctx *ctx: context of the signing oracle. Unless a pool is given, its seeds are chosen and
+//     its keypair generated by the attack; chopped_key_size must be set
+//   const keypair_file *pool: keypair file to load the keypair of the signing oracle from, or NULL
+//     to generate it
+//   u32 pool_index: index of the keypair to load from pool
 //   ISG_Attack_Result* attack_result: struct containing to store the results of this attack
 //   long num_oracle_queries: isg attack parameter q, the number of times the attacker queries the 
-//     oracle for a signature
+//     oracle for a signature. Assumes q is at most usr, as every query uses a different instance
 //   long num_sk_guesses: multiple values of isg attack parameter g. Runtime for each value of g
 //     is recorded. Assumes array is of length num_runtime_checkpoints. Assumes values of g are in 
 //     ascending order.
 //   int num_runtime_checkpoints: number of intermediate runtime checkpoints and length of 
 //     num_sk_guesses.
-void isg_attack(ISG_Attack_Result* attack_result, long num_oracle_queries, long num_sk_guesses[],
-                  int num_runtime_checkpoints){
-	// *** Setup ***
+//   int num_threads: number of key generation and Secret-Guessing phase worker threads. The query 
+//     phase always runs on the calling thread.
+void isg_attack(k2sn_ctx *ctx, const keypair_file *pool, u32 pool_index, 
+                  ISG_Attack_Result* attack_result, long num_oracle_queries, 
+                  long num_sk_guesses[], int num_runtime_checkpoints, int num_threads){
+	isg_attack_shared(ctx, 1, pool, pool_index, NULL, NULL, attack_result, num_oracle_queries, 
+	                    num_sk_guesses, num_runtime_checkpoints, num_threads);
+}
 
-	//---Set up signing oracle---
-	//Generate seeds and ivs for all three seeds
+// Performs the ISG Attack on num_targets signing oracles at once. Each oracle gets its own query 
+//   phase and signature index, and a single Secret-Guessing phase signs every guess once and looks
+//   it up in all of them. The results of the i^th oracle are stored in attack_results[i], with the 
+//   same meaning as for isg_attack(); their checkpoint runtimes add the oracle's own query phase to
+//   the shared guessing time. isg_attack() is the case of one oracle.
+// Params:
+//   k2sn_ctx ctxs[]: contexts of the signing oracles, set up as for isg_attack(). Assumes array is
+//     of length num_targets
+//   int num_targets: number of signing oracles
+//   const keypair_file *pool: keypair file to load the keypairs of the signing oracles from, or 
+//     NULL to generate them
+//   u32 first_pool_index: the i^th oracle loads keypair first_pool_index + i, modulo the number of
+//     keypairs in pool
+//   const u8 *M: message every oracle signs, of length msglen, or NULL to choose a random one
+//   const rainbow_table *rainbow: rainbow table built for M to look the oracle signatures up in, or
+//     NULL to try every guess in turn
+//   ISG_Attack_Result attack_results[]: results of the attack on each oracle. Assumes array is of 
+//     length num_targets
+//   long num_oracle_queries, long num_sk_guesses[], int num_runtime_checkpoints, int num_threads: 
+//     as for isg_attack()
+void isg_attack_shared(k2sn_ctx ctxs[], int num_targets, const keypair_file *pool, 
+                         u32 first_pool_index, const u8 *M, const rainbow_table *rainbow,
+                         ISG_Attack_Result attack_results[],
+                         long num_oracle_queries, long num_sk_guesses[], 
+                         int num_runtime_checkpoints, int num_threads){
+	// *** Setup ***
 	int i;
 	//Seed the random number generator
 	srand(time(NULL));
-	for (i = 0; i < seedlen; i++) system_seed[i] = rand() % 255;
-	for (i = 0; i < ivlen; i++) system_iv[i] = rand() % 255;
-	for (i = 0; i < seedlen; i++) randompad_seed[i] = rand() % 255;
-	for (i = 0; i < ivlen; i++) randompad_iv[i] = rand() % 255;
-	for (i = 0; i < seedlen; i++) hk_seed[i] = rand() % 255;
-	for (i = 0; i < ivlen; i++) hk_iv[i] = rand() % 255;
-
-	//Generate public and private key pair
-	key_generation(system_seed, system_iv);
-
-	//Generate random message which will be signed by signing oracle
-	u8 M[msglen];
-	for (i = 0; i < msglen; i++) M[i] = rand() % 256;
-
-	//Set up empty binary search tree which uses the KSNOTS signature comparison function to test 
-	//  for node-equality
-	struct gdsl_bstree *sig_tree = gdsl_bstree_alloc("", &KSNMSS_Signature_Alloc, 
-													   &KSNMSS_Signature_Free, 
-													   &KSNMSS_Signature_Cmp);
-
-	//Initialize success of attack to failure
-	attack_result->success_guess = -1;
-
-	//Start timer
-	clock_t temp_time;
-	clock_t uncounted_time = 0;
-	clock_t attack_start_time = clock();
-
-	// *** Query Phase ***
-	if (debug) {
-		printf("   ---STARTING ATTACK---\n");
-		printf("   ---QUERY PHASE---\n");
+
+	//Generate random message which will be signed by every signing oracle, unless one is given. 
+	//  Both the oracles and every guess sign it, so its 1-CFF subset is computed once
+	u8 oracle_M[msglen];
+	if (M != NULL) {
+		memcpy(oracle_M, M, msglen);
+	} else {
+		for (i = 0; i < msglen; i++) oracle_M[i] = rand() % 256;
 	}
-	ksnmss_sig mss_sig;
+	ksnots_fixed_msg fixed_M;
+	KSNOTS_fix_message(&ctxs[0], oracle_M, &fixed_M);
+
+	attack_target *targets = malloc(num_targets * sizeof(attack_target));
+
+	//The oracles sign from the nodes of their whole tree whenever their leaves are known, which 
+	//  spares them the BDS traversal and the public OTS key of every signature
+	ksnmss_tree tree;
+	ksnmss_tree_init(&tree);
+
+	for (int target_index = 0; target_index < num_targets; target_index++) {
+		k2sn_ctx *ctx = &ctxs[target_index];
+		attack_target *target = &targets[target_index];
+		ISG_Attack_Result *attack_result = &attack_results[target_index];
+
+		//---Set up signing oracle---
+		int sign_from_tree = 1;
+		if (pool != NULL) {
+			//Load a pre-built public and private key pair
+			u32 pool_index = (first_pool_index + target_index) % pool->header->num_keypairs;
+			keypair_file_load(pool, pool_index, ctx);
+			const node *leaves = keypair_file_leaves(pool, pool_index);
+			if (leaves != NULL) {
+				memcpy(tree.level[0], leaves, usr * sizeof(node));
+			} else {
+				sign_from_tree = 0;
+			}
+		} else {
+			//Generate seeds and ivs for all three seeds
+			for (i = 0; i < seedlen; i++) ctx->system_seed[i] = rand() % 255;
+			for (i = 0; i < ivlen; i++) ctx->system_iv[i] = rand() % 255;
+			for (i = 0; i < seedlen; i++) ctx->randompad_seed[i] = rand() % 255;
+			for (i = 0; i < ivlen; i++) ctx->randompad_iv[i] = rand() % 255;
+			for (i = 0; i < seedlen; i++) ctx->hk_seed[i] = rand() % 255;
+			for (i = 0; i < ivlen; i++) ctx->hk_iv[i] = rand() % 255;
+
+			//Generate public and private key pair
+			key_generation(ctx, num_threads, tree.level[0]);
+		}
+		if (sign_from_tree) {
+			ksnmss_tree_build(ctx, &tree);
+		}
+
+		//Set up empty index from KSN-OTS signature fingerprints to instance ids. The public keys 
+		//  are not kept, as they can be recomputed from the id, and neither are the authentication 
+		//  paths whenever they can be rebuilt from the leaves
+		target->ctx = ctx;
+		sig_index_init(&target->sig_lookup, num_oracle_queries);
+		if (sign_from_tree) {
+			target->leaves = malloc(usr * sizeof(node));
+			target->auth_paths = NULL;
+		} else {
+			target->leaves = NULL;
+			target->auth_paths = malloc(num_oracle_queries * sizeof(node[h]));
+		}
+		if (target->leaves == NULL && target->auth_paths == NULL) {
+			perror("isg_attack_shared");
+			exit(EXIT_FAILURE);
+		}
+		if (target->leaves != NULL) {
+			memcpy(target->leaves, tree.level[0], usr * sizeof(node));
+		}
+		target->attack_result = attack_result;
+		target->next_checkpoint_index = 0;
+		atomic_init(&target->success_guess, LONG_MAX);
+
+		//Initialize success of attack to failure
+		attack_result->success_guess = -1;
+
+		//Start timer
+		clock_t temp_time;
+		clock_t uncounted_time = 0;
+		clock_t attack_start_time = clock();
 
-	//Query signing oracle for signature for message M multiple times. (Specifically, q times)
-	for (u32 query_index = 0; query_index < num_oracle_queries; query_index++) {
-		memset(&mss_sig, 0, sizeof(ksnmss_sig));
+		// *** Query Phase ***
+		if (debug) {
+			printf("   ---STARTING ATTACK---\n");
+			printf("   ---QUERY PHASE---\n");
+		}
+		ksnmss_sig mss_sig;
+
+		//Query signing oracle for signature for message M multiple times. (Specifically, q times)
+		for (u32 query_index = 0; query_index < num_oracle_queries; query_index++) {
+			memset(&mss_sig, 0, sizeof(ksnmss_sig));
+
+			//Query signing oracle for K2SN-MSS message. Time spent querying oracle is not counted 
+			//towards runtime
+			temp_time = clock();
+			if (sign_from_tree) {
+				ksnmss_sign_from_tree(ctx, &tree, query_index, oracle_M, &fixed_M, &mss_sig);
+			} else {
+				ksnmss_sign(ctx, query_index, oracle_M, &mss_sig);
+			}
+			uncounted_time += clock() - temp_time;
 
-		//Query signing oracle for K2SN-MSS message. Time spent querying oracle is not counted 
-		//towards runtime
-		temp_time = clock();
-		ksnmss_sign(query_index, M, &mss_sig);
-		uncounted_time += clock() - temp_time;
+			//Add the k2snmss signature's id to the index, keyed by the fingerprint of the k2snmss 
+			//  signature's ksnots signature
+			sig_index_insert(&target->sig_lookup, sksum_fingerprint(mss_sig.sksum), mss_sig.id);
+			if (target->auth_paths != NULL) {
+				memcpy(target->auth_paths[query_index], mss_sig.auth, h * pklen);
+			}
+		}
 
-		//Add the k2snmss signature to the tree, indexed by the value of the k2snmss signature's 
-		//  ksnots signature
-		int bstree_result;
-		gdsl_bstree_insert(sig_tree, &mss_sig, &bstree_result);
+		target->query_time = (clock() - attack_start_time) - uncounted_time;
 	}
+	ksnmss_tree_free(&tree);
 
 	// *** Secret-Guessing Phase ***
 	if (debug) {
 		printf("   ---SECRET-GUESSING PHASE---\n");
 	}
 
-	//Initialize s to 0
-	u8 ots_sk_guess[seedlen];
-	memset(ots_sk_guess, 0, seedlen);
-
-	//Main loop of secret-guessing phase
-	u8 ots_sig_guess[sklen * 8];
-	int iteration_counter = 0;
-	int has_succeeded = 0;
-	int next_checkpoint_index = 0;
-	// Iterate up to g_max times, where g_max is the largest g parameter we are testing, unless the 
-	// attack succeeds before that point in which case we stop iterating immediately 
-	while (iteration_counter < num_sk_guesses[num_runtime_checkpoints-1] && !has_succeeded) {
-
-		//Compute KSN-OTS signature of M using OTS sk guess as the secret key
-		KSNOTS_sign(ots_sk_guess, M, ots_sig_guess);
-
-		//Search the binary tree for a K2SN-MSS signature which contains the same KSN-OTS signature
-		ksnmss_sig temp_mss_sig;
-		memcpy(temp_mss_sig.sksum, ots_sig_guess, sklen * 8);
-		gdsl_element_t found_element = gdsl_bstree_search(sig_tree, NULL, &temp_mss_sig);
-
-		if (found_element != NULL) {
-			//Choose new message - we will forge a signature for this message
-			u8 M_F[msglen];
-			do {
-				for (i = 0; i < msglen; i++) M[i] = rand() % 256;
-			} while (memcmp(M_F, M, msglen) == 0);
-		
-			//Forge KSN-OTS signature of M_F
-			u8 ots_sig_M_F[sklen * 8];
-			KSNOTS_sign(ots_sk_guess, M_F, ots_sig_M_F);
-
-			//If forged OTS siganture is valid, forge a K2SN-MSS signature
-			if (KSNOTS_verify(((ksnmss_sig *) found_element)->pk, M_F, ots_sig_M_F, 
-					((ksnmss_sig *) found_element)->id)) { 
-				//Construct K2SN-MSS forger of M_F
-				ksnmss_sig mss_sig_M_F;
-				mss_sig_M_F.id = ((ksnmss_sig *) found_element)->id;
-				memcpy(mss_sig_M_F.message, M_F, msglen);
-				memcpy(mss_sig_M_F.sksum, ots_sig_M_F, sklen * 8);
-				memcpy(&mss_sig_M_F.pk, ((ksnmss_sig *) found_element)->pk, t * pklen);
-				memcpy(&mss_sig_M_F.auth, ((ksnmss_sig *) found_element)->auth, h * pklen);
-
-				//Attack is successful
-				has_succeeded = 1;
-
-				//Record iteration of secret guessing phase loop that attack succeeded on
-				attack_result->success_guess = iteration_counter;
-			}
+	guess_phase gp;
+	guess_worker *workers = aligned_alloc(_Alignof(guess_worker), num_threads * sizeof(guess_worker));
+	pthread_t threads[num_threads];
+
+	gp.targets = targets;
+	gp.num_targets = num_targets;
+	gp.M = oracle_M;
+	gp.fixed_M = fixed_M;
+	gp.num_sk_guesses = num_sk_guesses;
+	gp.num_runtime_checkpoints = num_runtime_checkpoints;
+	gp.next_guess = 0;
+	gp.done = 0;
+	gp.workers = workers;
+	gp.num_workers = num_threads;
+	pthread_mutex_init(&gp.lock, NULL);
+	atomic_init(&gp.uncounted_time, 0);
+	gp.guess_start_time = clock();
+
+	// Worker 0 runs on the calling thread, so a single-threaded attack never spawns a thread
+	for (int w = 0; w < num_threads; w++) {
+		workers[w].gp = &gp;
+		workers[w].keypair = NULL;
+		workers[w].rand_state = rand();
+		workers[w].chunk_start = -1;
+	}
+	if (rainbow != NULL) {
+		guess_phase_rainbow(&workers[0], rainbow);
+	} else {
+		for (int w = 1; w < num_threads; w++) {
+			pthread_create(&threads[w], NULL, guess_worker_run, &workers[w]);
 		}
-
-		//Increment secret key guess to next value to guess
-		increment_bytes(ots_sk_guess, seedlen);
-
-		iteration_counter++;
-
-		//If this iteration is a checkpoint or the attack succeeded then we record the current 
-		//runtime
-		if (iteration_counter == num_sk_guesses[next_checkpoint_index] || has_succeeded) {
-			//Current runtime
-			temp_time = (clock() - attack_start_time) - uncounted_time;
-
-			// If attack succeeded, the runtime of all the remaining checkpoints is the current
-			// runtime
-			if (has_succeeded) {
-				for (int i = next_checkpoint_index; i < num_runtime_checkpoints; i++) {
-					attack_result->intermediate_runtimes[i] = temp_time;
-				}
-			//Otherwise, we only record the intermediate runtime at this iteration and move on
-			} else {
-				attack_result->intermediate_runtimes[next_checkpoint_index] = temp_time;
-				next_checkpoint_index++;
-			}
+		guess_worker_run(&workers[0]);
+		for (int w = 1; w < num_threads; w++) {
+			pthread_join(threads[w], NULL);
 		}
 	}
+	pthread_mutex_destroy(&gp.lock);
+	free(workers);
 
 	// *** Cleanup ***
-	// Memory usage is the size of 
-	attack_result->memory_usage = num_oracle_queries * sizeof(ksnmss_sig);
+	for (int target_index = 0; target_index < num_targets; target_index++) {
+		attack_target *target = &targets[target_index];
+		ISG_Attack_Result *attack_result = target->attack_result;
 
-	// Record number of checkpoints
-	attack_result->num_runtime_checkpoints = num_runtime_checkpoints;
+		// Memory usage is the size of the index and the authentication paths, which an attacker 
+		//   keeps from the oracle signatures even when they are rebuilt here
+		attack_result->memory_usage = (target->sig_lookup.mask + 1) * sizeof(sig_index_slot) + 
+		                                num_oracle_queries * sizeof(node[h]);
 
-	//Destroy binary search tree that stores oracle queries
-	gdsl_bstree_free(sig_tree);
+		// Record number of checkpoints
+		attack_result->num_runtime_checkpoints = num_runtime_checkpoints;
 
-	if (debug) {
-		printf("\t---ATTACK COMPLETE---\n");
-		printf("\tPrinting attack results:\n");
-		printf("\t\tNumber of checkpoints:\t%d\n", attack_result->num_runtime_checkpoints);
-		printf("\t\tIntermediate runtimes:\t%ld\n", attack_result->intermediate_runtimes[0]);
-		for (int i = 1; i < attack_result->num_runtime_checkpoints; i++) {
-			printf("\t\t\t\t\t%ld\n", attack_result->intermediate_runtimes[i]);
+		//Destroy index and leaves or authentication paths that store oracle queries
+		sig_index_free(&target->sig_lookup);
+		free(target->leaves);
+		free(target->auth_paths);
+
+		if (debug) {
+			printf("\t---ATTACK COMPLETE---\n");
+			printf("\tPrinting attack results:\n");
+			printf("\t\tNumber of checkpoints:\t%d\n", attack_result->num_runtime_checkpoints);
+			printf("\t\tIntermediate runtimes:\t%ld\n", attack_result->intermediate_runtimes[0]);
+			for (int i = 1; i < attack_result->num_runtime_checkpoints; i++) {
+				printf("\t\t\t\t\t%ld\n", attack_result->intermediate_runtimes[i]);
+			}
+			printf("\t\tSuccess guess (-1 indicates failure):\t%ld\n", attack_result->success_guess);
+			printf("\t\tMemory usage:\t%ld\n", attack_result->memory_usage);
 		}
-		printf("\t\tSuccess guess (-1 indicates failure):\t%ld\n", attack_result->success_guess);
-		printf("\t\tMemory usage:\t%ld\n", attack_result->memory_usage);
 	}
+	free(targets);
 	return;
 }
 
@@ -255,9 +658,18 @@ void isg_attack(ISG_Attack_Result* attack_result, long num_oracle_queries, long
 //   int num_runtime_checkpoints: number of intermediate runtime checkpoints and length of 
 //     num_sk_guesses.
 //   int num_attack_iterations: number of invocations of isg_attack()
+//   const keypair_file *pool: keypair file whose keypairs the invocations use in turn, or NULL to
+//     generate a keypair for every invocation
+//   const u8 *shared_M: message of length msglen signed in every invocation, or NULL for each 
+//     invocation to choose its own. If given, the invocations are performed by a single call of 
+//     isg_attack_shared(), which shares one Secret-Guessing phase between them
+//   const rainbow_table *rainbow: rainbow table to look the oracle signatures up in instead of 
+//     trying every guess in turn, or NULL. Requires shared_M to be the message of the table
+//   int num_threads: number of key generation and Secret-Guessing phase worker threads
 void isg_attack_test(ISG_Attack_Test_Result* test_result, long reduced_sk_size, 
                        long num_oracle_queries, long num_sk_guesses[], int num_runtime_checkpoints,
-                       int num_attack_iterations){
+                       int num_attack_iterations, const keypair_file *pool, const u8 *shared_M,
+                       const rainbow_table *rainbow, int num_threads){
 	//Set up K2SN-MSS implementation before it can be used
 	//Seed the random number generator
 	//(Note - srand is not cryptographically suitable, but for the purpose of this test it is 
@@ -266,11 +678,18 @@ void isg_attack_test(ISG_Attack_Test_Result* test_result, long reduced_sk_size,
 	//Precompute entire table of binomial coefficients, used in CFF computation.
 	set_binotable();
 	
-	//Set value of global variable for secret ots key size
-	chopped_key_size = reduced_sk_size;
+	//Contexts of the signing oracles, with the secret ots key size set. A context holds the signer
+	//  state of a whole tree, so it is kept off the stack, aligned for its vector members. Separate 
+	//  attacks reuse one context, while a shared Secret-Guessing phase needs one per oracle
+	int num_ctxs = shared_M != NULL ? num_attack_iterations : 1;
+	k2sn_ctx *ctxs = aligned_alloc(_Alignof(k2sn_ctx), num_ctxs * sizeof(k2sn_ctx));
+	memset(ctxs, 0, num_ctxs * sizeof(k2sn_ctx));
+	for (int i = 0; i < num_ctxs; i++) {
+		ctxs[i].chopped_key_size = reduced_sk_size;
+	}
 
-	//Ensure compiler does not optimize away pointer
-	ISG_Attack_Result single_attack_results;
+	//Results of every attack
+	ISG_Attack_Result *attack_results = malloc(num_attack_iterations * sizeof(ISG_Attack_Result));
 	//Running runtimes at each checkpoint, number of successes before each checkpoint, and memory 
 	//usage
 	long long intermediate_runtime_sums[num_runtime_checkpoints];
@@ -283,27 +702,41 @@ void isg_attack_test(ISG_Attack_Test_Result* test_result, long reduced_sk_size,
 	}
 	long long memory_usage_sum = 0;
 
-	//Invoke ISG Attack num_attack_iterations times and keep running total of results
-	for (int i = 0; i < num_attack_iterations; i++) {
-		if (debug) {
-			printf("\n---START ATTACK No. %d---\n", i);
-		}
+	if (shared_M != NULL) {
+		//Attack num_attack_iterations signing oracles which all sign shared_M with one shared 
+		//  Secret-Guessing phase
+		isg_attack_shared(ctxs, num_attack_iterations, pool, 0, shared_M, rainbow, attack_results,
+		                    num_oracle_queries, num_sk_guesses, num_runtime_checkpoints, 
+		                    num_threads);
+	} else {
+		//Invoke ISG Attack num_attack_iterations times
+		for (int i = 0; i < num_attack_iterations; i++) {
+			if (debug) {
+				printf("\n---START ATTACK No. %d---\n", i);
+			}
 
-		isg_attack(&single_attack_results, num_oracle_queries, num_sk_guesses, 
-				     num_runtime_checkpoints);
-		if (debug) {
-			printf("---END ATTACK No. %d---\n", i);
+			isg_attack(ctxs, pool, pool != NULL ? i % pool->header->num_keypairs : 0, 
+					     &attack_results[i], num_oracle_queries, num_sk_guesses, 
+					     num_runtime_checkpoints, num_threads);
+			if (debug) {
+				printf("---END ATTACK No. %d---\n", i);
+			}
 		}
-		//Add to running totals of results
+	}
+	free(ctxs);
+
+	//Keep running total of results
+	for (int a = 0; a < num_attack_iterations; a++) {
 		for (int i = 0; i < num_runtime_checkpoints; i++) {
-			intermediate_runtime_sums[i] += single_attack_results.intermediate_runtimes[i];
-			if (single_attack_results.success_guess < num_sk_guesses[i] && 
-			      single_attack_results.success_guess >= 0) {
+			intermediate_runtime_sums[i] += attack_results[a].intermediate_runtimes[i];
+			if (attack_results[a].success_guess < num_sk_guesses[i] && 
+			      attack_results[a].success_guess >= 0) {
 				intermediate_success_sums[i]++;
 			}
 		}
-		memory_usage_sum += single_attack_results.memory_usage;
-	} 
+		memory_usage_sum += attack_results[a].memory_usage;
+	}
+	free(attack_results);
 
 	//Calculate average runtimes, success probabilities, and memory usage
 	test_result->num_runtime_checkpoints = num_runtime_checkpoints;
@@ -321,6 +754,17 @@ void isg_attack_test(ISG_Attack_Test_Result* test_result, long reduced_sk_size,
 
 // Invokes ISG Attack test using command line parameters, or default parameters if command line 
 //   parameters are not given.
+// Options (from command line, before the parameters):
+//   -k <path>: Draw the keypair of each ISG Attack iteration from a keypair file built by keypool,
+//     instead of generating it. Iteration i uses keypair i modulo the number of keypairs in the 
+//     file.
+//   -m <hex>: Have the signing oracles of all ISG Attack iterations sign the message given by 
+//     2 * msglen hex digits, and run the iterations with one shared Secret-Guessing phase instead of
+//     one each. Every iteration then keeps its oracle in memory for the whole phase, which takes 
+//     the usr leaves of its tree, or q authentication paths if the keypair file has no leaves.
+//   -r <path>: Look the oracle signatures up in a rainbow table built by rainbow, instead of trying
+//     every guess in turn. The signing oracles of all ISG Attack iterations sign the message of the
+//     table, with one shared Secret-Guessing phase as for -m.
 // Params (from command line):
 //   int: Debug mode on or off. (0 for debug off, 1 for degub on)
 //   int: Number of ISG Attack iterations in test
@@ -328,7 +772,44 @@ void isg_attack_test(ISG_Attack_Test_Result* test_result, long reduced_sk_size,
 //   int: log(q), where q is the number of signing oracle queries in an ISG Attack iteration
 //   int (1 or more): 1 or more values of log(g). Must be in ascending order
 int main(int argc, char *argv[]) {
-	int num_attack_iterations, log_q, log_g_s[MAX_NUM_CHECKPOINTS], num_checkpoints;
+	int num_attack_iterations, chopped_key_size, log_q, log_g_s[MAX_NUM_CHECKPOINTS], num_checkpoints;
+	keypair_file pool_file;
+	const keypair_file *pool = NULL;
+	u8 shared_M_buf[msglen];
+	const u8 *shared_M = NULL;
+	rainbow_table rainbow_file;
+	const rainbow_table *rainbow = NULL;
+
+	while (argc >= 3 && argv[1][0] == '-') {
+		if (strcmp(argv[1], "-k") == 0) {
+			if (keypair_file_open(&pool_file, argv[2]) < 0) {
+				return 1;
+			}
+			pool = &pool_file;
+		} else if (strcmp(argv[1], "-m") == 0) {
+			if (strlen(argv[2]) != 2 * msglen) {
+				fprintf(stderr, "Shared message must be %d hex digits\n", 2 * msglen);
+				return 1;
+			}
+			for (int i = 0; i < msglen; i++) {
+				if (sscanf(argv[2] + 2 * i, "%2hhx", &shared_M_buf[i]) != 1) {
+					fprintf(stderr, "Shared message must be %d hex digits\n", 2 * msglen);
+					return 1;
+				}
+			}
+			shared_M = shared_M_buf;
+		} else if (strcmp(argv[1], "-r") == 0) {
+			if (rainbow_table_open(&rainbow_file, argv[2]) < 0) {
+				return 1;
+			}
+			rainbow = &rainbow_file;
+		} else {
+			break;
+		}
+		argv[2] = argv[0];
+		argv += 2;
+		argc -= 2;
+	}
 
 	//Set test parameters with command line arguments, otherwise use default parameters
 	if (argc >= 5) {
@@ -351,6 +832,44 @@ int main(int argc, char *argv[]) {
 		log_g_s[2] = 4;
 	}
 	
+	//Every query is signed by a different K2SN-MSS instance, and a keypair only has 2^h of them
+	if (log_q < 0 || log_q > h) {
+		fprintf(stderr, "Number of oracle queries must be between 2^0 and 2^%d\n", h);
+		return 1;
+	}
+
+	if (pool != NULL) {
+		//The chopped key size is part of a keypair, so every pooled keypair must have been built 
+		//  with the one being tested
+		if (pool->header->num_keypairs == 0) {
+			fprintf(stderr, "Keypair file holds no keypairs\n");
+			return 1;
+		}
+		for (u32 k = 0; k < pool->header->num_keypairs; k++) {
+			const keypair_record *record = (const keypair_record *) (pool->records + 
+			                                 k * pool->header->record_size);
+			if (record->chopped_key_size != chopped_key_size) {
+				fprintf(stderr, "Keypair %u has chopped key size %d\n", k, 
+				          record->chopped_key_size);
+				return 1;
+			}
+		}
+	}
+
+	if (rainbow != NULL) {
+		//A rainbow table only recovers the keys of its own message and chopped key size
+		if (rainbow->header->chopped_key_size != chopped_key_size) {
+			fprintf(stderr, "Rainbow table has chopped key size %u\n", 
+			          rainbow->header->chopped_key_size);
+			return 1;
+		}
+		if (shared_M != NULL && memcmp(shared_M, rainbow->header->message, msglen) != 0) {
+			fprintf(stderr, "Shared message differs from the message of the rainbow table\n");
+			return 1;
+		}
+		shared_M = rainbow->header->message;
+	}
+
 	long num_oracle_queries = 0x01 << log_q;
 	long num_sk_guesses[MAX_NUM_CHECKPOINTS];
 	for (int i = 0; i < num_checkpoints; i++) {
@@ -368,6 +887,21 @@ int main(int argc, char *argv[]) {
 	}
 	printf("\n");
 	printf("\tNumber of attack iterations:\t%d\n", num_attack_iterations);
+	printf("\tNumber of worker threads:\t%d\n", ISG_NUM_THREADS);
+	if (pool != NULL) {
+		printf("\tNumber of pooled keypairs:\t%u\n", pool->header->num_keypairs);
+	}
+	if (rainbow != NULL) {
+		printf("\tRainbow table chains:\t\t%llu of length %u\n", 
+		         (unsigned long long) rainbow->header->num_chains, rainbow->header->chain_length);
+	}
+	if (shared_M != NULL) {
+		printf("\tShared message:\t\t\t");
+		for (int i = 0; i < msglen; i++) {
+			printf("%02x", shared_M[i]);
+		}
+		printf("\n");
+	}
 
 	printf("\n---STARTING TEST---\n");
 	//Record the real time of the test
@@ -375,7 +909,8 @@ int main(int argc, char *argv[]) {
 
 	//Run test
 	isg_attack_test(&test_result, chopped_key_size, num_oracle_queries, num_sk_guesses, 
-					  num_checkpoints, num_attack_iterations);
+					  num_checkpoints, num_attack_iterations, pool, shared_M, rainbow, 
+					  ISG_NUM_THREADS);
 
 	int test_end_time = clock();
 
@@ -397,5 +932,11 @@ int main(int argc, char *argv[]) {
 	printf("\tTest real time (seconds):\t%lf\n", ((double) (test_end_time - test_start_time)) / 
 	         (double) CLOCKS_PER_SEC);
 
+	if (pool != NULL) {
+		keypair_file_close(&pool_file);
+	}
+	if (rainbow != NULL) {
+		rainbow_table_close(&rainbow_file);
+	}
 	return 0;
 }
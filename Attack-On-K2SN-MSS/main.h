@@ -3,11 +3,18 @@
  * Author: Roland Booth
 */
 
-#include <gdsl.h>
-
 // Maximum number of checkpoints to record intermediate runtime of attack
 #define MAX_NUM_CHECKPOINTS 64
 
+// Number of consecutive guesses a Secret-Guessing phase worker claims at a time. A multiple of 8, 
+//   so that chunks line up with the batches of KSNOTS_sign_x8()
+#define GUESS_CHUNK_SIZE 1024
+
+// Default number of key generation and Secret-Guessing phase worker threads
+#ifndef ISG_NUM_THREADS
+    #define ISG_NUM_THREADS 1
+#endif
+
 // Flag indicating debug mode on or off
 int debug = 0;
 
@@ -46,28 +53,135 @@ typedef struct {
 //   int num_bytes: length of byte array
 int increment_bytes(u8 *bytes, int num_bytes);
 
-// Allocation function for adding ksnmss_sig to a gdsl bstree
+// Writes guess index guess into the byte array, using the same little-endian layout that 
+//   increment_bytes() counts in, so the guess-th secret key tried by the Secret-Guessing phase is 
+//   independent of which worker tries it
+// Params:
+//   u8 *bytes: byte array to write
+//   int num_bytes: length of byte array
+//   long guess: guess index
+void guess_to_bytes(u8 *bytes, int num_bytes, long guess);
+
+// Slot of the signature index: the fingerprint of a KSN-OTS signature and the id of the K2SN-MSS
+//   instance that produced it. A fingerprint of 0 marks an empty slot.
+typedef struct {
+    u64 fingerprint;
+    u32 id;
+} sig_index_slot;
+
+// Open-addressed table mapping the fingerprints of the oracle's KSN-OTS signatures to instance 
+//   ids, with linear probing. It holds at most half as many signatures as it has slots, so a probe
+//   usually touches a single slot. Filled during the query phase and read-only afterwards.
+typedef struct {
+    sig_index_slot *slots;
+    u64 mask;
+} sig_index;
+
+// Allocates an empty signature index for up to num_sigs signatures
+// Params:
+//   sig_index *index: index to initialize
+//   long num_sigs: maximum number of signatures that will be inserted
+void sig_index_init(sig_index *index, long num_sigs);
+
+// Frees the slots of a signature index
+// Params:
+//   sig_index *index: index to free
+void sig_index_free(sig_index *index);
+
+// Adds a signature fingerprint to the index. If the fingerprint is already present, the index is 
+//   left unchanged, so the first instance to produce a signature is the one that is kept.
 // Params:
-//   void * sig: pointer to ksnmss_sig to add to bstree
+//   sig_index *index: index to add to
+//   u64 fingerprint: fingerprint of the signature, as computed by sksum_fingerprint()
+//   u32 id: index of the K2SN-MSS instance which produced the signature
 // Return:
-//   gdsl_element_t: pointer to ksnmss_sig in the tree
-gdsl_element_t KSNMSS_Signature_Alloc(void * sig);
+//   int: 1 if the fingerprint was added, 0 if it was already present
+int sig_index_insert(sig_index *index, u64 fingerprint, u32 id);
 
-// Allocation function for adding ksnmss_sig to a gdsl bstree
+// Looks up a signature fingerprint in the index
 // Params:
-//   void * sig: pointer to ksnmss_sig to add to bstree
+//   const sig_index *index: index to search
+//   u64 fingerprint: fingerprint to search for
+//   u32 *id: set to the instance id stored with the fingerprint, if it is found
 // Return:
-//   gdsl_element_t: pointer to ksnmss_sig in the tree
-void KSNMSS_Signature_Free(gdsl_element_t E);
+//   int: 1 if the fingerprint was found, 0 otherwise
+int sig_index_find(const sig_index *index, u64 fingerprint, u32 *id);
 
-// Compare function to compare ksnmss_sig elements in bstree. Only compares ksnmss_sig.sksum member,
-//   and ignores the rest of the signature.
+// Recomputes the KSN-OTS public key of the id'th K2SN-MSS instance, as returned with the oracle's 
+//   signature for that instance. Leaves the gSWIFFT key A of ctx set for the instance.
 // Params:
-//   const gdsl_element_t E: pointer to ksnmss_sig
-//   void* VALUE: pointer to ksnmss_sig
+//   k2sn_ctx *ctx: keypair of the signing oracle
+//   u32 id: index of the K2SN-MSS instance
+//   node *pk: Pointer to array which will be filled with the public key. Assumes length is t
+void regenerate_ots_pk(k2sn_ctx *ctx, u32 id, node *pk);
+
+// A signing oracle attacked by the Secret-Guessing phase: its keypair and the index of its KSN-OTS 
+//   signatures. The authentication path of a forged instance is rebuilt from leaves, the leaves of
+//   the oracle's tree, as only one is ever needed. If the leaves are not known, auth_paths holds the
+//   authentication paths of all queried instances instead, and leaves is NULL. query_time is the 
+//   counted runtime of its query phase, which every checkpoint runtime of the oracle includes. 
+//   success_guess is the smallest guess index known to forge for the oracle.
+typedef struct {
+    k2sn_ctx *ctx;
+    sig_index sig_lookup;
+    node *leaves;
+    node (*auth_paths)[h];
+    ISG_Attack_Result *attack_result;
+    clock_t query_time;
+
+    // Protected by the lock of the guess phase, except success_guess
+    int next_checkpoint_index;
+    atomic_long success_guess;
+} attack_target;
+
+struct guess_phase;
+
+// A Secret-Guessing phase worker. Hits are checked with the worker's own context, as checking 
+//   writes the context's 1-CFF state and gSWIFFT key. keypair is the oracle context whose seeds and
+//   gSWIFFT key ctx holds, or NULL if none. The forged messages are drawn from rand_state with 
+//   rand_r(), seeded on the calling thread, so the workers leave the rand() stream of the calling 
+//   thread alone. chunk_start is the first guess index of the chunk the worker is currently trying,
+//   or -1 if it is between chunks.
+typedef struct {
+    struct guess_phase *gp;
+    k2sn_ctx ctx;
+    const k2sn_ctx *keypair;
+    unsigned int rand_state;
+    long chunk_start;
+} guess_worker;
+
+// Shared state of the Secret-Guessing phase, handed out to the workers in chunks as in 
+//   Attack-On-XMSS/isg-attack-xmss.h. Every oracle signs the same message M, so the KSN-OTS 
+//   signature of a guess does not depend on the oracle: it is computed once and looked up in the
+//   index of every target. A guess is only tried for the targets whose success_guess lies above 
+//   it; workers stop once no target is left.
+typedef struct guess_phase {
+    attack_target *targets;
+    int num_targets;
+    const u8 *M;
+    ksnots_fixed_msg fixed_M;
+    const long *num_sk_guesses;
+    int num_runtime_checkpoints;
+    clock_t guess_start_time;
+    // CPU time spent rebuilding authentication paths, in clock ticks. An attacker keeps them from 
+    //   the oracle signatures, so it is not counted in the guessing time
+    atomic_long uncounted_time;
+
+    // Everything below is protected by lock
+    pthread_mutex_t lock;
+    guess_worker *workers;
+    int num_workers;
+    long next_guess;
+    int done;
+} guess_phase;
+
+// Secret-Guessing phase worker. Repeatedly claims the next chunk of consecutive guesses, tries them
+//   in order, and stops early as soon as every target has forged with a smaller guess index.
+// Params:
+//   void *arg: the guess_worker to run
 // Return:
-//   long int: 0 if sksum of E and VALUE are equal, >0 if E > VALUE, and <0 if E < VALUE
-long int KSNMSS_Signature_Cmp(const gdsl_element_t E, void* VALUE);
+//   void *: NULL
+void *guess_worker_run(void *arg);
 
 // Performs one invocation of the ISG Attack. Simulates invoking the ISG Attack multiple times
 //   using multiple (smaller) values of the ISG Attack parameter g by recording intermediate results
@@ -76,16 +190,50 @@ long int KSNMSS_Signature_Cmp(const gdsl_element_t E, void* VALUE);
 //   and the amount of memory used to store the set of oracle signature queries (which is the same 
 //   for each simulated parameter set).
 // Params:
+//   k2sn_ctx *ctx: context of the signing oracle. Unless a pool is given, its seeds are chosen and
+//     its keypair generated by the attack; chopped_key_size must be set
+//   const keypair_file *pool: keypair file to load the keypair of the signing oracle from, or NULL
+//     to generate it
+//   u32 pool_index: index of the keypair to load from pool
 //   ISG_Attack_Result* attack_result: struct containing to store the results of this attack
 //   long num_oracle_queries: isg attack parameter q, the number of times the attacker queries the 
-//     oracle for a signature
+//     oracle for a signature. Assumes q is at most usr, as every query uses a different instance
 //   long num_sk_guesses: multiple values of isg attack parameter g. Runtime for each value of g
 //     is recorded. Assumes array is of length num_runtime_checkpoints. Assumes values of g are in 
 //     ascending order.
 //   int num_runtime_checkpoints: number of intermediate runtime checkpoints and length of 
 //     num_sk_guesses.
-void isg_attack(ISG_Attack_Result* attack_result, long num_oracle_queries, long num_sk_guesses[],
-                  int num_runtime_checkpoints);
+//   int num_threads: number of key generation and Secret-Guessing phase worker threads. The query 
+//     phase always runs on the calling thread.
+void isg_attack(k2sn_ctx *ctx, const keypair_file *pool, u32 pool_index, 
+                  ISG_Attack_Result* attack_result, long num_oracle_queries, 
+                  long num_sk_guesses[], int num_runtime_checkpoints, int num_threads);
+
+// Performs the ISG Attack on num_targets signing oracles at once. Each oracle gets its own query 
+//   phase and signature index, and a single Secret-Guessing phase signs every guess once and looks
+//   it up in all of them. The results of the i^th oracle are stored in attack_results[i], with the 
+//   same meaning as for isg_attack(); their checkpoint runtimes add the oracle's own query phase to
+//   the shared guessing time. isg_attack() is the case of one oracle.
+// Params:
+//   k2sn_ctx ctxs[]: contexts of the signing oracles, set up as for isg_attack(). Assumes array is
+//     of length num_targets
+//   int num_targets: number of signing oracles
+//   const keypair_file *pool: keypair file to load the keypairs of the signing oracles from, or 
+//     NULL to generate them
+//   u32 first_pool_index: the i^th oracle loads keypair first_pool_index + i, modulo the number of
+//     keypairs in pool
+//   const u8 *M: message every oracle signs, of length msglen, or NULL to choose a random one
+//   const rainbow_table *rainbow: rainbow table built for M to look the oracle signatures up in, or
+//     NULL to try every guess in turn
+//   ISG_Attack_Result attack_results[]: results of the attack on each oracle. Assumes array is of 
+//     length num_targets
+//   long num_oracle_queries, long num_sk_guesses[], int num_runtime_checkpoints, int num_threads: 
+//     as for isg_attack()
+void isg_attack_shared(k2sn_ctx ctxs[], int num_targets, const keypair_file *pool, 
+                         u32 first_pool_index, const u8 *M, const rainbow_table *rainbow,
+                         ISG_Attack_Result attack_results[],
+                         long num_oracle_queries, long num_sk_guesses[], 
+                         int num_runtime_checkpoints, int num_threads);
 
 // Invokes the ISG Attack multiple times using one parameter set. Each ISG Attack invocation 
 //   simulates invoking the ISG Attack multiple times using multiple (smaller) values of the ISG 
@@ -108,6 +256,15 @@ void isg_attack(ISG_Attack_Result* attack_result, long num_oracle_queries, long
 //   int num_runtime_checkpoints: number of intermediate runtime checkpoints and length of 
 //     num_sk_guesses.
 //   int num_attack_iterations: number of invocations of isg_attack()
+//   const keypair_file *pool: keypair file whose keypairs the invocations use in turn, or NULL to
+//     generate a keypair for every invocation
+//   const u8 *shared_M: message of length msglen signed in every invocation, or NULL for each 
+//     invocation to choose its own. If given, the invocations are performed by a single call of 
+//     isg_attack_shared(), which shares one Secret-Guessing phase between them
+//   const rainbow_table *rainbow: rainbow table to look the oracle signatures up in instead of 
+//     trying every guess in turn, or NULL. Requires shared_M to be the message of the table
+//   int num_threads: number of key generation and Secret-Guessing phase worker threads
 void isg_attack_test(ISG_Attack_Test_Result* test_result, long reduced_sk_size, 
                        long num_oracle_queries, long num_sk_guesses[], int num_runtime_checkpoints,
-                       int num_attack_iterations);
+                       int num_attack_iterations, const keypair_file *pool, const u8 *shared_M,
+                       const rainbow_table *rainbow, int num_threads);
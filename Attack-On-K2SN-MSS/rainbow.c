@@ -0,0 +1,103 @@
+/*
+ * Builds a rainbow table of chopped secret OTS keys for the ISG Attack on K2SN-MSS
+*/
+
+#include "K2SN-MSS/measurement.h"
+#include <time.h>
+#include <pthread.h>
+#include "K2SN-MSS/merkle-tree.h"
+#include "K2SN-MSS/ChaCha20/chacha.c"
+#include "K2SN-MSS/ChaCha20/chacha-x8.c"
+#include "K2SN-MSS/swifft16/swifft-avx2-16.c"
+#include "K2SN-MSS/ksnmss.c"
+#include "K2SN-MSS/rainbow-table.c"
+#include <x86intrin.h>
+
+// Prints the progress of the table every 2^16 chains
+static void print_progress(u64 built, u64 num_chains){
+	if ((built & 0xFFFF) < 8 || built == num_chains) {
+		printf("Built chain %llu of %llu\n", (unsigned long long) built,
+		         (unsigned long long) num_chains);
+	}
+}
+
+// Builds a rainbow table of the secret OTS keys of one chopped key size for one message, which the
+//   attack loads with its -r option. The table is only built once per message and key size, and
+//   every attack whose oracles sign that message can use it.
+// Params (from command line):
+//   string: Path of the rainbow table file to write
+//   int: Size of chopped keys in bits
+//   int: log2 of the number of chains. At most the size of chopped keys
+//   int: Length of every chain
+//   string (optional): Message of the table, as 2 * msglen hex digits. Random if not given
+int main(int argc, char *argv[]) {
+	if (argc < 5) {
+		fprintf(stderr, "usage: %s <rainbow table file> <chopped key size> <log2 of number of chains> "
+		          "<chain length> [<message>]\n", argv[0]);
+		return 1;
+	}
+	const char *path = argv[1];
+	int chopped_key_size = atoi(argv[2]);
+	int log_num_chains = atoi(argv[3]);
+	u32 chain_length = atoi(argv[4]);
+
+	if (chopped_key_size < 1 || chopped_key_size > RAINBOW_TABLE_MAX_KEY_SIZE) {
+		fprintf(stderr, "Chopped key size must be between 1 and %d\n", RAINBOW_TABLE_MAX_KEY_SIZE);
+		return 1;
+	}
+	if (log_num_chains < 0 || log_num_chains > chopped_key_size || chain_length == 0) {
+		fprintf(stderr, "Expected at most 2^%d chains of positive length\n", chopped_key_size);
+		return 1;
+	}
+
+	//(Note - srand is not cryptographically suitable, but for the purpose of this test it is
+	//  sufficient)
+	srand(time(0));
+	set_binotable();
+
+	u8 M[msglen];
+	if (argc >= 6) {
+		if (strlen(argv[5]) != 2 * msglen) {
+			fprintf(stderr, "Message must be %d hex digits\n", 2 * msglen);
+			return 1;
+		}
+		for (int i = 0; i < msglen; i++) {
+			if (sscanf(argv[5] + 2 * i, "%2hhx", &M[i]) != 1) {
+				fprintf(stderr, "Message must be %d hex digits\n", 2 * msglen);
+				return 1;
+			}
+		}
+	} else {
+		for (int i = 0; i < msglen; i++) M[i] = rand() % 256;
+	}
+
+	FILE *f = fopen(path, "wb");
+	if (f == NULL) {
+		perror(path);
+		return 1;
+	}
+
+	//Only the 1-CFF state of the context is used. It is kept off the stack, aligned for its vector
+	//  members
+	k2sn_ctx *ctx = aligned_alloc(_Alignof(k2sn_ctx), sizeof(k2sn_ctx));
+	memset(ctx, 0, sizeof(k2sn_ctx));
+	if (rainbow_table_write(f, ctx, M, chopped_key_size, chain_length, (u64) 1 << log_num_chains,
+	                        print_progress) < 0) {
+		fprintf(stderr, "%s: could not write rainbow table\n", path);
+		fclose(f);
+		return 1;
+	}
+	free(ctx);
+
+	if (fclose(f) != 0) {
+		perror(path);
+		return 1;
+	}
+
+	printf("Message: ");
+	for (int i = 0; i < msglen; i++) {
+		printf("%02x", M[i]);
+	}
+	printf("\n");
+	return 0;
+}
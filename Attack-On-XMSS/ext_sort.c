@@ -0,0 +1,258 @@
+// External sort-merge of fixed-size records, for query sets larger than memory
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ext_sort.h"
+
+static uint64_t ext_record_key(const void *record){
+	uint64_t key;
+
+	memcpy(&key, record, sizeof(key));
+	return key;
+}
+
+static int ext_record_cmp(const void *a, const void *b){
+	uint64_t x = ext_record_key(a), y = ext_record_key(b);
+
+	return (x > y) - (x < y);
+}
+
+// Sorts the buffered records and appends them to the file as a run
+static int ext_sorter_spill(ext_sorter *s){
+	uint64_t *run_ends;
+	size_t max_runs;
+
+	if (s->num_runs == s->max_runs) {
+		max_runs = s->max_runs ? 2*s->max_runs : 16;
+		run_ends = realloc(s->run_ends, max_runs * sizeof(uint64_t));
+		if (run_ends == NULL)
+			return -1;
+		s->run_ends = run_ends;
+		s->max_runs = max_runs;
+	}
+	qsort(s->buf, s->num_buffered, s->record_size, ext_record_cmp);
+	if (fwrite(s->buf, s->record_size, s->num_buffered, s->file) != s->num_buffered)
+		return -1;
+	s->num_records += s->num_buffered;
+	s->run_ends[s->num_runs++] = s->num_records;
+	s->num_buffered = 0;
+	return 0;
+}
+
+int ext_sorter_init(ext_sorter *s, size_t record_size, size_t budget){
+	s->record_size = record_size;
+	s->buf_records = budget / record_size ? budget / record_size : 1;
+	s->num_buffered = 0;
+	s->run_ends = NULL;
+	s->num_runs = 0;
+	s->max_runs = 0;
+	s->num_records = 0;
+	s->file = tmpfile();
+	s->buf = malloc(s->buf_records * record_size);
+	if (s->file == NULL || s->buf == NULL) {
+		ext_sorter_free(s);
+		return -1;
+	}
+	return 0;
+}
+
+int ext_sorter_add(ext_sorter *s, const void *record){
+	if (s->num_buffered == s->buf_records && ext_sorter_spill(s) < 0)
+		return -1;
+	memcpy(s->buf + s->num_buffered * s->record_size, record, s->record_size);
+	s->num_buffered++;
+	return 0;
+}
+
+// Reads the next block of a run into its buffer
+static int ext_merge_run_fill(const ext_sorter *s, ext_merge_run *run){
+	size_t n = run->end - run->next < run->buf_records ? run->end - run->next : run->buf_records;
+	size_t bytes = n * s->record_size, done = 0;
+	ssize_t r;
+
+	while (done < bytes) {
+		r = pread(fileno(s->file), run->buf + done, bytes - done,
+		          (off_t)(run->next * s->record_size + done));
+		if (r <= 0)
+			return -1;
+		done += r;
+	}
+	run->next += n;
+	run->pos = 0;
+	run->len = n;
+	return 0;
+}
+
+static uint64_t ext_merge_run_key(const ext_merge *m, size_t r){
+	const ext_merge_run *run = &m->runs[r];
+
+	return ext_record_key(run->buf + run->pos * m->sorter->record_size);
+}
+
+// Restores the heap order from position i downwards
+static void ext_merge_sift_down(ext_merge *m, size_t i){
+	size_t child, r = m->heap[i];
+	uint64_t key = ext_merge_run_key(m, r);
+
+	while ((child = 2*i + 1) < m->heap_size) {
+		if (child + 1 < m->heap_size &&
+		    ext_merge_run_key(m, m->heap[child + 1]) < ext_merge_run_key(m, m->heap[child]))
+			child++;
+		if (key <= ext_merge_run_key(m, m->heap[child]))
+			break;
+		m->heap[i] = m->heap[child];
+		i = child;
+	}
+	m->heap[i] = r;
+}
+
+// Starts a merge of count runs of a sorter, from its first^th run on
+static int ext_merge_open_runs(ext_merge *m, const ext_sorter *s, size_t first, size_t count,
+                               size_t budget){
+	size_t block_records, i;
+
+	block_records = budget / (count ? count : 1) / s->record_size;
+	if (block_records == 0)
+		block_records = 1;
+
+	m->sorter = s;
+	m->num_runs = count;
+	m->heap_size = 0;
+	m->runs = calloc(count ? count : 1, sizeof(ext_merge_run));
+	m->heap = malloc((count ? count : 1) * sizeof(size_t));
+	if (m->runs == NULL || m->heap == NULL) {
+		ext_merge_close(m);
+		return -1;
+	}
+	for (i = 0; i < count; i++) {
+		ext_merge_run *run = &m->runs[i];
+
+		run->next = first + i > 0 ? s->run_ends[first + i - 1] : 0;
+		run->end = s->run_ends[first + i];
+		run->buf_records = block_records;
+		run->buf = malloc(block_records * s->record_size);
+		if (run->buf == NULL || ext_merge_run_fill(s, run) < 0) {
+			ext_merge_close(m);
+			return -1;
+		}
+		if (run->len > 0)
+			m->heap[m->heap_size++] = i;
+	}
+	for (i = m->heap_size; i-- > 0;)
+		ext_merge_sift_down(m, i);
+	return 0;
+}
+
+int ext_merge_open(ext_merge *m, const ext_sorter *s, size_t budget){
+	return ext_merge_open_runs(m, s, 0, s->num_runs, budget);
+}
+
+const void *ext_merge_peek(const ext_merge *m){
+	const ext_merge_run *run;
+
+	if (m->heap_size == 0)
+		return NULL;
+	run = &m->runs[m->heap[0]];
+	return run->buf + run->pos * m->sorter->record_size;
+}
+
+int ext_merge_next(ext_merge *m){
+	ext_merge_run *run = &m->runs[m->heap[0]];
+
+	if (++run->pos == run->len) {
+		if (run->next < run->end) {
+			if (ext_merge_run_fill(m->sorter, run) < 0)
+				return -1;
+		} else {
+			// The run is exhausted
+			m->heap[0] = m->heap[--m->heap_size];
+			if (m->heap_size == 0)
+				return 0;
+		}
+	}
+	ext_merge_sift_down(m, 0);
+	return 0;
+}
+
+void ext_merge_close(ext_merge *m){
+	if (m->runs != NULL) {
+		for (size_t i = 0; i < m->num_runs; i++)
+			free(m->runs[i].buf);
+	}
+	free(m->runs);
+	free(m->heap);
+	m->runs = NULL;
+	m->heap = NULL;
+	m->heap_size = 0;
+}
+
+int ext_sorter_finish(ext_sorter *s, size_t budget){
+	size_t max_fan_in = budget / EXT_SORT_MIN_BLOCK, num_merged, first, count;
+	uint64_t *merged_ends;
+	const void *record;
+	ext_merge m;
+	FILE *out;
+	int ret;
+
+	if (s->num_buffered > 0 && ext_sorter_spill(s) < 0)
+		return -1;
+	free(s->buf);
+	s->buf = NULL;
+	if (fflush(s->file) != 0)
+		return -1;
+
+	// Every pass merges groups of max_fan_in runs into one, into a new file
+	if (max_fan_in < 2)
+		max_fan_in = 2;
+	while (s->num_runs > max_fan_in) {
+		out = tmpfile();
+		merged_ends = malloc(((s->num_runs + max_fan_in - 1) / max_fan_in) * sizeof(uint64_t));
+		if (out == NULL || merged_ends == NULL) {
+			if (out != NULL)
+				fclose(out);
+			free(merged_ends);
+			return -1;
+		}
+		num_merged = 0;
+		ret = 0;
+		for (first = 0; first < s->num_runs && ret == 0; first += count) {
+			count = s->num_runs - first < max_fan_in ? s->num_runs - first : max_fan_in;
+			if (ext_merge_open_runs(&m, s, first, count, budget) < 0) {
+				ret = -1;
+				break;
+			}
+			while ((record = ext_merge_peek(&m)) != NULL && ret == 0) {
+				if (fwrite(record, s->record_size, 1, out) != 1 || ext_merge_next(&m) < 0)
+					ret = -1;
+			}
+			ext_merge_close(&m);
+			merged_ends[num_merged++] = s->run_ends[first + count - 1];
+		}
+		if (ret == 0 && fflush(out) != 0)
+			ret = -1;
+		if (ret < 0) {
+			fclose(out);
+			free(merged_ends);
+			return -1;
+		}
+		fclose(s->file);
+		free(s->run_ends);
+		s->file = out;
+		s->run_ends = merged_ends;
+		s->num_runs = num_merged;
+		s->max_runs = num_merged;
+	}
+	return 0;
+}
+
+void ext_sorter_free(ext_sorter *s){
+	if (s->file != NULL)
+		fclose(s->file);
+	free(s->buf);
+	free(s->run_ends);
+	s->file = NULL;
+	s->buf = NULL;
+	s->run_ends = NULL;
+}
@@ -0,0 +1,79 @@
+#ifndef EXT_SORT_H_
+#define EXT_SORT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Smallest block in which a merge reads a run. A merge of more runs than its memory budget has
+// blocks for is done in several passes
+#define EXT_SORT_MIN_BLOCK (64 * 1024)
+
+// External sort of fixed-size records that start with a 64-bit key. Records are gathered in a run
+// buffer of the memory budget; whenever it fills, it is sorted by key and appended to an unlinked
+// temporary file as a run. Runs are written and read front to back only, so all file I/O is
+// sequential. Records with equal keys come out in no particular order.
+typedef struct {
+	FILE *file;
+	size_t record_size;
+	unsigned char *buf;
+	size_t buf_records;
+	size_t num_buffered;
+	// Number of records in the file up to the end of every run
+	uint64_t *run_ends;
+	size_t num_runs;
+	size_t max_runs;
+	uint64_t num_records;
+} ext_sorter;
+
+// A run being read by a merge, through a buffer of whole records
+typedef struct {
+	unsigned char *buf;
+	size_t buf_records;
+	size_t pos;
+	size_t len;
+	// Next record of the run to read into the buffer, and the end of the run
+	uint64_t next;
+	uint64_t end;
+} ext_merge_run;
+
+// The runs of a finished sorter, read back in key order by a k-way merge. heap holds the runs that
+// still have records, as a binary min-heap by the key of their current record.
+typedef struct {
+	const ext_sorter *sorter;
+	ext_merge_run *runs;
+	size_t num_runs;
+	size_t *heap;
+	size_t heap_size;
+} ext_merge;
+
+// Starts an empty sort of records of record_size bytes with a run buffer of budget bytes.
+// Returns 0 on success, -1 if the temporary file or the buffer cannot be created.
+int ext_sorter_init(ext_sorter *s, size_t record_size, size_t budget);
+
+// Adds a record, writing out a run first if the buffer is full. Returns 0 on success, -1 if writing
+// or allocating the list of runs fails.
+int ext_sorter_add(ext_sorter *s, const void *record);
+
+// Writes out the last run and frees the run buffer. If the runs are more than a merge of budget
+// bytes can read at once, they are merged into longer runs until they are not. No records can be
+// added afterwards. Returns 0 on success, -1 if reading, writing or allocating fails.
+int ext_sorter_finish(ext_sorter *s, size_t budget);
+
+void ext_sorter_free(ext_sorter *s);
+
+// Starts reading the records of a finished sorter in key order, sharing budget bytes between the
+// buffers of its runs. A sorter can be read by any number of merges. Returns 0 on success, -1 if
+// reading fails.
+int ext_merge_open(ext_merge *m, const ext_sorter *s, size_t budget);
+
+// The smallest record not read yet, or NULL once every record has been read. It stays valid until
+// the next call of ext_merge_next().
+const void *ext_merge_peek(const ext_merge *m);
+
+// Moves past the record ext_merge_peek() returns. Returns 0 on success, -1 if reading fails.
+int ext_merge_next(ext_merge *m);
+
+void ext_merge_close(ext_merge *m);
+
+#endif
@@ -0,0 +1,205 @@
+/* Four-way parallel SHAKE following FIPS-202, with the same padding and rates
+ * as fips202.c.
+ *
+ * The permutation is written against a GCC vector type holding lane j of all
+ * 4 states; it is instantiated for AVX2 and for AVX-512VL (native rotates),
+ * and the AVX-512VL instance is used when the CPU supports it. */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "fips202x4.h"
+
+#define NROUNDS 24
+#define ROL(a, offset) (((a) << (offset)) ^ ((a) >> (64-(offset))))
+
+typedef uint64_t u64x4 __attribute__((vector_size(32)));
+
+static const uint64_t KeccakF_RoundConstants[NROUNDS] =
+{
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
+    0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
+    0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
+    0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
+    0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
+    0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
+    0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+/* Rotation offsets and lane order of the combined rho and pi steps. */
+static const unsigned int keccak_rho[24] = {
+     1,  3,  6, 10, 15, 21, 28, 36, 45, 55,  2, 14,
+    27, 41, 56,  8, 25, 43, 62, 18, 39, 61, 20, 44
+};
+
+static const unsigned int keccak_pi[24] = {
+    10,  7, 11, 17, 18,  3,  5, 16,  8, 21, 24,  4,
+    15, 23, 19, 13, 12,  2, 20, 14, 22,  9,  6,  1
+};
+
+static uint64_t load64(const unsigned char *x)
+{
+    unsigned long long r = 0, i;
+
+    for (i = 0; i < 8; ++i) {
+        r |= (unsigned long long)x[i] << 8 * i;
+    }
+    return r;
+}
+
+static void store64(uint8_t *x, uint64_t u)
+{
+    unsigned int i;
+
+    for (i = 0; i < 8; ++i) {
+        x[i] = u;
+        u >>= 8;
+    }
+}
+
+/* The loops below are unrolled completely, so that every index and rotation
+   offset is a constant and the state can live in registers. */
+static inline __attribute__((always_inline))
+void keccakx4_permute(u64x4 *state)
+{
+    u64x4 s[25], c[5], d, t, u;
+    unsigned int round, x, y, i;
+
+    memcpy(s, state, sizeof(s));
+    for (round = 0; round < NROUNDS; round++) {
+        /* Theta */
+#pragma GCC unroll 5
+        for (x = 0; x < 5; x++) {
+            c[x] = s[x] ^ s[x + 5] ^ s[x + 10] ^ s[x + 15] ^ s[x + 20];
+        }
+#pragma GCC unroll 5
+        for (x = 0; x < 5; x++) {
+            d = c[(x + 4) % 5] ^ ROL(c[(x + 1) % 5], 1);
+#pragma GCC unroll 5
+            for (y = 0; y < 25; y += 5) {
+                s[y + x] ^= d;
+            }
+        }
+
+        /* Rho and pi */
+        t = s[1];
+#pragma GCC unroll 24
+        for (i = 0; i < 24; i++) {
+            u = s[keccak_pi[i]];
+            s[keccak_pi[i]] = ROL(t, keccak_rho[i]);
+            t = u;
+        }
+
+        /* Chi */
+#pragma GCC unroll 5
+        for (y = 0; y < 25; y += 5) {
+#pragma GCC unroll 5
+            for (x = 0; x < 5; x++) {
+                c[x] = s[y + x];
+            }
+#pragma GCC unroll 5
+            for (x = 0; x < 5; x++) {
+                s[y + x] = c[x] ^ (~c[(x + 1) % 5] & c[(x + 2) % 5]);
+            }
+        }
+
+        /* Iota */
+        s[0] ^= KeccakF_RoundConstants[round];
+    }
+    memcpy(state, s, sizeof(s));
+}
+
+__attribute__((target("avx2")))
+static void keccakx4_permute_avx2(u64x4 *s)
+{
+    keccakx4_permute(s);
+}
+
+__attribute__((target("avx512f,avx512vl")))
+static void keccakx4_permute_avx512(u64x4 *s)
+{
+    keccakx4_permute(s);
+}
+
+static void KeccakF1600_StatePermute4x(u64x4 *s)
+{
+    if (__builtin_cpu_supports("avx512vl")) {
+        keccakx4_permute_avx512(s);
+    }
+    else {
+        keccakx4_permute_avx2(s);
+    }
+}
+
+static void keccakx4_absorb(u64x4 *s, unsigned int r,
+                            const unsigned char *m[4], unsigned long long mlen,
+                            unsigned char p)
+{
+    unsigned long long i, offset = 0;
+    unsigned char t[4][200];
+    unsigned int j;
+
+    while (mlen >= r) {
+        for (i = 0; i < r / 8; ++i) {
+            for (j = 0; j < 4; j++) {
+                s[i][j] ^= load64(m[j] + offset + 8 * i);
+            }
+        }
+        KeccakF1600_StatePermute4x(s);
+        mlen -= r;
+        offset += r;
+    }
+
+    for (j = 0; j < 4; j++) {
+        memset(t[j], 0, r);
+        memcpy(t[j], m[j] + offset, mlen);
+        t[j][mlen] = p;
+        t[j][r - 1] |= 128;
+    }
+    for (i = 0; i < r / 8; ++i) {
+        for (j = 0; j < 4; j++) {
+            s[i][j] ^= load64(t[j] + 8 * i);
+        }
+    }
+}
+
+static void keccakx4_squeeze(unsigned char *out[4], unsigned long long outlen,
+                             u64x4 *s, unsigned int r)
+{
+    unsigned long long offset = 0, i;
+    unsigned char d[8];
+    unsigned int j;
+
+    while (outlen > 0) {
+        KeccakF1600_StatePermute4x(s);
+        for (i = 0; i < r / 8 && outlen > 0; i++) {
+            for (j = 0; j < 4; j++) {
+                store64(d, s[i][j]);
+                memcpy(out[j] + offset, d, outlen < 8 ? outlen : 8);
+            }
+            offset += 8;
+            outlen -= outlen < 8 ? outlen : 8;
+        }
+    }
+}
+
+void shake128x4(unsigned char *out[4], unsigned long long outlen,
+                const unsigned char *in[4], unsigned long long inlen)
+{
+    u64x4 s[25];
+
+    memset(s, 0, sizeof(s));
+    keccakx4_absorb(s, SHAKE128_RATE, in, inlen, 0x1F);
+    keccakx4_squeeze(out, outlen, s, SHAKE128_RATE);
+}
+
+void shake256x4(unsigned char *out[4], unsigned long long outlen,
+                const unsigned char *in[4], unsigned long long inlen)
+{
+    u64x4 s[25];
+
+    memset(s, 0, sizeof(s));
+    keccakx4_absorb(s, SHAKE256_RATE, in, inlen, 0x1F);
+    keccakx4_squeeze(out, outlen, s, SHAKE256_RATE);
+}
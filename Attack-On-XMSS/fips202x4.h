@@ -0,0 +1,22 @@
+#ifndef XMSS_FIPS202X4_H
+#define XMSS_FIPS202X4_H
+
+#include "fips202.h"
+
+/* Four-way parallel SHAKE. Every function evaluates 4 independent messages of
+ * the same length at once, one Keccak state per 64-bit vector lane.
+ */
+
+/* Evaluates SHAKE-128 on the `inlen' bytes in each of `in[0..3]'.
+ * Writes the first `outlen' bytes of each output to `out[0..3]'.
+ */
+void shake128x4(unsigned char *out[4], unsigned long long outlen,
+                const unsigned char *in[4], unsigned long long inlen);
+
+/* Evaluates SHAKE-256 on the `inlen' bytes in each of `in[0..3]'.
+ * Writes the first `outlen' bytes of each output to `out[0..3]'.
+ */
+void shake256x4(unsigned char *out[4], unsigned long long outlen,
+                const unsigned char *in[4], unsigned long long inlen);
+
+#endif
@@ -0,0 +1,196 @@
+// Precomputed dictionary of every guessable WOTS seed, for the join mode of the Secret-Guessing phase
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "guess_dict.h"
+#include "isg-attack-xmss.h"
+
+// An entry of a shard while it is being built
+typedef struct {
+	uint64_t fingerprint;
+	uint32_t guess;
+} guess_dict_entry;
+
+// Orders entries by fingerprint, and equal fingerprints by guess so that files are reproducible
+static int guess_dict_entry_cmp(const void *a, const void *b){
+	const guess_dict_entry *x = a, *y = b;
+
+	if (x->fingerprint != y->fingerprint)
+		return x->fingerprint < y->fingerprint ? -1 : 1;
+	return (x->guess > y->guess) - (x->guess < y->guess);
+}
+
+// Bytes taken up by a shard of the given number of entries
+static size_t guess_dict_shard_size(uint64_t entries){
+	return entries * sizeof(uint64_t) + ((entries * sizeof(uint32_t) + 7) & ~(size_t)7);
+}
+
+int guess_dict_write(FILE *f, const xmss_params *params, unsigned int chop_bytes,
+                     unsigned int log_guesses_per_shard,
+                     void (*progress)(uint64_t shard, uint64_t num_shards)){
+	unsigned char buf[GUESS_DICT_HEADER_SIZE] = {0};
+	guess_dict_header header;
+	unsigned char seed[params->n];
+	unsigned char comps[params->wots_sig_bytes];
+	guess_dict_entry *entries;
+	uint64_t *fingerprints;
+	uint32_t *guesses;
+	uint64_t entries_per_shard, s, g, k, pad = 0;
+	unsigned int j;
+	int ret = -1;
+
+	// Guess indices are stored in 32 bits
+	if (chop_bytes < 1 || chop_bytes > 4 || log_guesses_per_shard > 8*chop_bytes)
+		return -1;
+
+	memcpy(header.magic, GUESS_DICT_MAGIC, sizeof(header.magic));
+	header.func = params->func;
+	header.n = params->n;
+	header.wots_len = params->wots_len;
+	header.chop_bytes = chop_bytes;
+	header.num_guesses = 1ULL << (8*chop_bytes);
+	header.guesses_per_shard = 1ULL << log_guesses_per_shard;
+	header.num_shards = header.num_guesses / header.guesses_per_shard;
+	memcpy(buf, &header, sizeof(header));
+	if (fwrite(buf, GUESS_DICT_HEADER_SIZE, 1, f) != 1)
+		return -1;
+
+	entries_per_shard = header.guesses_per_shard * params->wots_len;
+	entries = malloc(entries_per_shard * sizeof(guess_dict_entry));
+	fingerprints = malloc(entries_per_shard * sizeof(uint64_t));
+	guesses = malloc(entries_per_shard * sizeof(uint32_t));
+	if (entries == NULL || fingerprints == NULL || guesses == NULL)
+		goto out;
+
+	for (s = 0; s < header.num_shards; s++) {
+		k = 0;
+		for (g = s * header.guesses_per_shard; g < (s + 1) * header.guesses_per_shard; g++) {
+			guess_to_bytes(seed, params->n, g);
+			expand_seed(params, comps, seed);
+			for (j = 0; j < params->wots_len; j++) {
+				entries[k].fingerprint = sck_fingerprint(j, comps + j*params->n);
+				entries[k].guess = g;
+				k++;
+			}
+		}
+		qsort(entries, entries_per_shard, sizeof(guess_dict_entry), guess_dict_entry_cmp);
+
+		for (k = 0; k < entries_per_shard; k++) {
+			fingerprints[k] = entries[k].fingerprint;
+			guesses[k] = entries[k].guess;
+		}
+		if (fwrite(fingerprints, sizeof(uint64_t), entries_per_shard, f) != entries_per_shard ||
+		    fwrite(guesses, sizeof(uint32_t), entries_per_shard, f) != entries_per_shard)
+			goto out;
+		if (entries_per_shard % 2 && fwrite(&pad, sizeof(uint32_t), 1, f) != 1)
+			goto out;
+
+		if (progress != NULL)
+			progress(s, header.num_shards);
+	}
+	ret = 0;
+
+out:
+	free(entries);
+	free(fingerprints);
+	free(guesses);
+	return ret;
+}
+
+int guess_dict_open(guess_dict *dict, const char *path, const xmss_params *params){
+	const guess_dict_header *header;
+	struct stat st;
+	void *map;
+	uint64_t shard_entries;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+	if (fstat(fd, &st) < 0) {
+		perror(path);
+		close(fd);
+		return -1;
+	}
+	if (st.st_size < GUESS_DICT_HEADER_SIZE) {
+		fprintf(stderr, "%s: not a guess dictionary\n", path);
+		close(fd);
+		return -1;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		perror(path);
+		return -1;
+	}
+
+	header = map;
+	if (memcmp(header->magic, GUESS_DICT_MAGIC, sizeof(header->magic)) != 0) {
+		fprintf(stderr, "%s: not a guess dictionary\n", path);
+		munmap(map, st.st_size);
+		return -1;
+	}
+	if (header->func != params->func || header->n != params->n ||
+	    header->wots_len != params->wots_len) {
+		fprintf(stderr, "%s: guess dictionary was written for different parameters\n", path);
+		munmap(map, st.st_size);
+		return -1;
+	}
+	if (header->chop_bytes != XMSS_CHOP_BYTES) {
+		fprintf(stderr, "%s: guess dictionary chops seeds to %u bytes, this build to %d\n", path,
+		        header->chop_bytes, XMSS_CHOP_BYTES);
+		munmap(map, st.st_size);
+		return -1;
+	}
+	shard_entries = header->guesses_per_shard * header->wots_len;
+	if (header->num_guesses != 1ULL << (8*header->chop_bytes) ||
+	    header->guesses_per_shard * header->num_shards != header->num_guesses ||
+	    (uint64_t)st.st_size < GUESS_DICT_HEADER_SIZE +
+	                           header->num_shards * guess_dict_shard_size(shard_entries)) {
+		fprintf(stderr, "%s: guess dictionary is truncated\n", path);
+		munmap(map, st.st_size);
+		return -1;
+	}
+
+	// The join visits the shards in order, but the entries of each shard in no particular order
+	madvise(map, st.st_size, MADV_RANDOM);
+
+	dict->header = header;
+	dict->shard_entries = shard_entries;
+	dict->shard_size = guess_dict_shard_size(shard_entries);
+	dict->map_size = st.st_size;
+	return 0;
+}
+
+void guess_dict_close(guess_dict *dict){
+	munmap((void *)dict->header, dict->map_size);
+	dict->header = NULL;
+}
+
+const uint64_t *guess_dict_fingerprints(const guess_dict *dict, uint64_t shard){
+	return (const uint64_t *)((const unsigned char *)dict->header + GUESS_DICT_HEADER_SIZE +
+	                          shard * dict->shard_size);
+}
+
+const uint32_t *guess_dict_guesses(const guess_dict *dict, uint64_t shard){
+	return (const uint32_t *)(guess_dict_fingerprints(dict, shard) + dict->shard_entries);
+}
+
+uint64_t guess_dict_lower_bound(const guess_dict *dict, uint64_t shard, uint64_t fp){
+	const uint64_t *fingerprints = guess_dict_fingerprints(dict, shard);
+	uint64_t lo = 0, hi = dict->shard_entries, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (fingerprints[mid] < fp)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
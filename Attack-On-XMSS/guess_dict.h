@@ -0,0 +1,66 @@
+#ifndef GUESS_DICT_H_
+#define GUESS_DICT_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "params.h"
+
+#define GUESS_DICT_MAGIC "XMSSGDCT"
+// Size of the header of a guess dictionary file. The shards that follow it start at this offset
+#define GUESS_DICT_HEADER_SIZE 64
+
+// Header of a guess dictionary file. get_seed() chops every WOTS seed to its first chop_bytes
+// bytes, so there are only num_guesses = 2^(8*chop_bytes) seeds, and guess index g stands for the
+// seed guess_to_bytes() writes for g. The dictionary holds, for every guess and every position j,
+// the fingerprint sck_fingerprint() gives the j^th secret component key expand_seed() derives from
+// the guess. The guesses are split into num_shards shards of guesses_per_shard consecutive
+// guesses, each holding its wots_len * guesses_per_shard entries sorted by fingerprint: first all
+// fingerprints (uint64_t), then the guess index of every entry (uint32_t), padded to 8 bytes.
+// The file is in the byte order of the machine that wrote it.
+typedef struct {
+	char magic[8];
+	uint32_t func;
+	uint32_t n;
+	uint32_t wots_len;
+	uint32_t chop_bytes;
+	uint64_t num_guesses;
+	uint64_t guesses_per_shard;
+	uint64_t num_shards;
+} guess_dict_header;
+
+// A guess dictionary file mapped read-only into memory
+typedef struct {
+	const guess_dict_header *header;
+	// Number of entries, and bytes, of every shard
+	uint64_t shard_entries;
+	size_t shard_size;
+	size_t map_size;
+} guess_dict;
+
+// Writes the dictionary of every guess of the seeds chopped to chop_bytes bytes. Only one shard of
+// 2^log_guesses_per_shard guesses is held in memory at a time, so wide chop widths are built in a
+// single streaming pass. progress, if not NULL, is called after every shard.
+// Returns 0 on success, -1 if writing fails.
+int guess_dict_write(FILE *f, const xmss_params *params, unsigned int chop_bytes,
+                     unsigned int log_guesses_per_shard,
+                     void (*progress)(uint64_t shard, uint64_t num_shards));
+
+// Maps a guess dictionary file into memory and checks that it was written for params and for the
+// chop width of this build. Returns 0 on success, -1 otherwise; an error message is printed on
+// failure.
+int guess_dict_open(guess_dict *dict, const char *path, const xmss_params *params);
+
+void guess_dict_close(guess_dict *dict);
+
+// The sorted fingerprints and the matching guess indices of a shard
+const uint64_t *guess_dict_fingerprints(const guess_dict *dict, uint64_t shard);
+
+const uint32_t *guess_dict_guesses(const guess_dict *dict, uint64_t shard);
+
+// Index of the first entry of a shard whose fingerprint is not below fp, or shard_entries if there
+// is none
+uint64_t guess_dict_lower_bound(const guess_dict *dict, uint64_t shard, uint64_t fp);
+
+#endif
@@ -1,4 +1,10 @@
+/* The low-level SHA-2 API is deprecated in OpenSSL 3, but it is the only one
+   that exposes the hash state between blocks, and it skips the per-call
+   algorithm fetch of the one-shot functions. */
+#define OPENSSL_SUPPRESS_DEPRECATED
+
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <openssl/sha.h>
 
@@ -7,6 +13,8 @@
 #include "params.h"
 #include "hash.h"
 #include "fips202.h"
+#include "fips202x4.h"
+#include "sha2x8.h"
 
 #include "wots.h"
 
@@ -27,8 +35,15 @@ static int core_hash(const xmss_params *params,
                      unsigned char *out,
                      const unsigned char *in, unsigned long long inlen)
 {
+    SHA256_CTX sha256;
+    SHA512_CTX sha512;
+
+    /* The one-shot SHA256() / SHA512() fetch the algorithm on every call in
+       OpenSSL 3, which costs several times more than hashing a few blocks. */
     if (params->n == 32 && params->func == XMSS_SHA2) {
-        SHA256(in, inlen, out);
+        SHA256_Init(&sha256);
+        SHA256_Update(&sha256, in, inlen);
+        SHA256_Final(out, &sha256);
 	//chop(params, out);
     }
     else if (params->n == 32 && params->func == XMSS_SHAKE) {
@@ -36,7 +51,9 @@ static int core_hash(const xmss_params *params,
 	//chop(params, out);
     }
     else if (params->n == 64 && params->func == XMSS_SHA2) {
-        SHA512(in, inlen, out);
+        SHA512_Init(&sha512);
+        SHA512_Update(&sha512, in, inlen);
+        SHA512_Final(out, &sha512);
 	//chop(params, out);
     }
     else if (params->n == 64 && params->func == XMSS_SHAKE) {
@@ -65,6 +82,114 @@ int prf(const xmss_params *params,
     return core_hash(params, out, buf, 2*params->n + 32);
 }
 
+void prf_keyed_init(const xmss_params *params,
+                    prf_ctx *ctx, const unsigned char *key)
+{
+    unsigned char buf[2*params->n];
+
+    ctx->key = key;
+    if (params->func != XMSS_SHA2) {
+        return;
+    }
+    ull_to_bytes(buf, params->n, XMSS_HASH_PADDING_PRF);
+    memcpy(buf + params->n, key, params->n);
+
+    /* 2*n is exactly one SHA-256 block for n = 32, one SHA-512 block for n = 64. */
+    if (params->n == 32) {
+        SHA256_Init(&ctx->state.sha256);
+        SHA256_Update(&ctx->state.sha256, buf, 2*params->n);
+    }
+    else if (params->n == 64) {
+        SHA512_Init(&ctx->state.sha512);
+        SHA512_Update(&ctx->state.sha512, buf, 2*params->n);
+    }
+}
+
+int prf_keyed(const xmss_params *params,
+              unsigned char *out, const unsigned char in[32],
+              const prf_ctx *ctx)
+{
+    SHA256_CTX sha256;
+    SHA512_CTX sha512;
+
+    if (params->n == 32 && params->func == XMSS_SHA2) {
+        sha256 = ctx->state.sha256;
+        SHA256_Update(&sha256, in, 32);
+        SHA256_Final(out, &sha256);
+    }
+    else if (params->n == 64 && params->func == XMSS_SHA2) {
+        sha512 = ctx->state.sha512;
+        SHA512_Update(&sha512, in, 32);
+        SHA512_Final(out, &sha512);
+    }
+    else {
+        return prf(params, out, in, ctx->key);
+    }
+    return 0;
+}
+
+/*
+ * Computes 8 hashes of inlen bytes each. SHAKE runs as two 4-way batches.
+ */
+static int core_hash_x8(const xmss_params *params,
+                        unsigned char *out[8],
+                        const unsigned char *in[8], unsigned long long inlen)
+{
+    if (params->n == 32 && params->func == XMSS_SHA2) {
+        sha256x8(out, in, inlen);
+    }
+    else if (params->n == 32 && params->func == XMSS_SHAKE) {
+        shake128x4(out, 32, in, inlen);
+        shake128x4(out + 4, 32, in + 4, inlen);
+    }
+    else if (params->n == 64 && params->func == XMSS_SHA2) {
+        sha512x8(out, in, inlen);
+    }
+    else if (params->n == 64 && params->func == XMSS_SHAKE) {
+        shake256x4(out, 64, in, inlen);
+        shake256x4(out + 4, 64, in + 4, inlen);
+    }
+    else {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Computes PRF(key, in[j]) for 8 32-byte inputs, for the key ctx was
+ * initialized with.
+ */
+static int prf_keyed_x8(const xmss_params *params,
+                        unsigned char *out[8], const unsigned char *in[8],
+                        const prf_ctx *ctx)
+{
+    unsigned char buf[8][2*params->n + 32];
+    const unsigned char *msg[8];
+    uint64_t state512[8];
+    unsigned int j;
+
+    if (params->n == 32 && params->func == XMSS_SHA2) {
+        sha256x8_from_state(out, ctx->state.sha256.h, SHA256_BLOCK_BYTES,
+                            in, 32);
+    }
+    else if (params->n == 64 && params->func == XMSS_SHA2) {
+        for (j = 0; j < 8; j++) {
+            state512[j] = ctx->state.sha512.h[j];
+        }
+        sha512x8_from_state(out, state512, SHA512_BLOCK_BYTES, in, 32);
+    }
+    else {
+        for (j = 0; j < 8; j++) {
+            ull_to_bytes(buf[j], params->n, XMSS_HASH_PADDING_PRF);
+            memcpy(buf[j] + params->n, ctx->key, params->n);
+            memcpy(buf[j] + 2*params->n, in[j], 32);
+            msg[j] = buf[j];
+        }
+        return core_hash_x8(params, out, msg, 2*params->n + 32);
+    }
+    return 0;
+}
+
 /*
  * Computes the message hash using R, the public root, the index of the leaf
  * node, and the message. Notably, it requires m_with_prefix to have 4*n bytes
@@ -86,34 +211,105 @@ int hash_message(const xmss_params *params, unsigned char *out,
     return core_hash(params, out, m_with_prefix, mlen + 4*params->n);
 }
 
-/**
- * We assume the left half is in in[0]...in[n-1]
+void hash_ctx_init(const xmss_params *params,
+                   hash_ctx *ctx, const unsigned char *pub_seed)
+{
+    ctx->pub_seed = pub_seed;
+    prf_keyed_init(params, &ctx->prf, pub_seed);
+    ctx->table = NULL;
+}
+
+/* An entry is the address with key_and_mask set to the number of masks, the
+   key and up to two masks, so thash_f and thash_h entries never alias. */
+static unsigned int bitmask_entry_bytes(const xmss_params *params)
+{
+    return 32 + 3 * params->n;
+}
+
+void bitmask_table_init(const xmss_params *params, bitmask_table *table,
+                        unsigned int log_entries, uint32_t min_layer)
+{
+    unsigned long long num_entries = 1ULL << log_entries;
+
+    /* All-ones addresses never occur, so they mark empty entries. */
+    table->entries = malloc(num_entries * bitmask_entry_bytes(params));
+    memset(table->entries, 0xFF, num_entries * bitmask_entry_bytes(params));
+    table->mask = num_entries - 1;
+    table->min_layer = min_layer;
+}
+
+void bitmask_table_free(bitmask_table *table)
+{
+    free(table->entries);
+    table->entries = NULL;
+}
+
+/*
+ * Derives the n-byte key and num_masks n-byte bitmasks for addr, from the
+ * bitmask table if possible. Leaves key_and_mask of addr set to num_masks,
+ * as computing them directly would.
  */
-int thash_h(const xmss_params *params,
-            unsigned char *out, const unsigned char *in,
-            const unsigned char *pub_seed, uint32_t addr[8])
+static void get_key_and_mask(const xmss_params *params,
+                             unsigned char *key, unsigned char *bitmask,
+                             unsigned int num_masks,
+                             const hash_ctx *ctx, uint32_t addr[8])
 {
-    unsigned char buf[4 * params->n];
-    unsigned char bitmask[2 * params->n];
+    bitmask_table *table = ctx->table;
     unsigned char addr_as_bytes[32];
+    unsigned char *entry = NULL;
+    uint64_t slot = 0;
     unsigned int i;
 
-    /* Set the function padding. */
-    ull_to_bytes(buf, params->n, XMSS_HASH_PADDING_H);
+    if (table != NULL && addr[0] >= table->min_layer) {
+        set_key_and_mask(addr, num_masks);
+        for (i = 0; i < 7; i++) {
+            slot = (slot ^ addr[i]) * 0x100000001B3ULL;
+        }
+        slot = (slot ^ (slot >> 29)) & table->mask;
+        entry = table->entries + slot * bitmask_entry_bytes(params);
+
+        if (!memcmp(entry, addr, 32)) {
+            memcpy(key, entry + 32, params->n);
+            memcpy(bitmask, entry + 32 + params->n, num_masks * params->n);
+            return;
+        }
+    }
 
     /* Generate the n-byte key. */
     set_key_and_mask(addr, 0);
     addr_to_bytes(addr_as_bytes, addr);
-    prf(params, buf + params->n, addr_as_bytes, pub_seed);
+    prf_keyed(params, key, addr_as_bytes, &ctx->prf);
 
-    /* Generate the 2n-byte mask. */
-    set_key_and_mask(addr, 1);
-    addr_to_bytes(addr_as_bytes, addr);
-    prf(params, bitmask, addr_as_bytes, pub_seed);
+    /* Generate the n-byte masks. */
+    for (i = 0; i < num_masks; i++) {
+        set_key_and_mask(addr, i + 1);
+        addr_to_bytes(addr_as_bytes, addr);
+        prf_keyed(params, bitmask + i*params->n, addr_as_bytes, &ctx->prf);
+    }
 
-    set_key_and_mask(addr, 2);
-    addr_to_bytes(addr_as_bytes, addr);
-    prf(params, bitmask + params->n, addr_as_bytes, pub_seed);
+    if (entry != NULL) {
+        memcpy(entry, addr, 32);
+        memcpy(entry + 32, key, params->n);
+        memcpy(entry + 32 + params->n, bitmask, num_masks * params->n);
+    }
+}
+
+/**
+ * We assume the left half is in in[0]...in[n-1]
+ */
+int thash_h_ctx(const xmss_params *params,
+                unsigned char *out, const unsigned char *in,
+                const hash_ctx *ctx, uint32_t addr[8])
+{
+    unsigned char buf[4 * params->n];
+    unsigned char bitmask[2 * params->n];
+    unsigned int i;
+
+    /* Set the function padding. */
+    ull_to_bytes(buf, params->n, XMSS_HASH_PADDING_H);
+
+    /* Generate the n-byte key and the 2n-byte mask. */
+    get_key_and_mask(params, buf + params->n, bitmask, 2, ctx, addr);
 
     for (i = 0; i < 2 * params->n; i++) {
         buf[2*params->n + i] = in[i] ^ bitmask[i];
@@ -121,30 +317,146 @@ int thash_h(const xmss_params *params,
     return core_hash(params, out, buf, 4 * params->n);
 }
 
-int thash_f(const xmss_params *params,
-            unsigned char *out, const unsigned char *in,
-            const unsigned char *pub_seed, uint32_t addr[8])
+int thash_f_ctx(const xmss_params *params,
+                unsigned char *out, const unsigned char *in,
+                const hash_ctx *ctx, uint32_t addr[8])
 {
     unsigned char buf[3 * params->n];
     unsigned char bitmask[params->n];
-    unsigned char addr_as_bytes[32];
     unsigned int i;
 
     /* Set the function padding. */
     ull_to_bytes(buf, params->n, XMSS_HASH_PADDING_F);
 
-    /* Generate the n-byte key. */
-    set_key_and_mask(addr, 0);
-    addr_to_bytes(addr_as_bytes, addr);
-    prf(params, buf + params->n, addr_as_bytes, pub_seed);
-
-    /* Generate the n-byte mask. */
-    set_key_and_mask(addr, 1);
-    addr_to_bytes(addr_as_bytes, addr);
-    prf(params, bitmask, addr_as_bytes, pub_seed);
+    /* Generate the n-byte key and the n-byte mask. */
+    get_key_and_mask(params, buf + params->n, bitmask, 1, ctx, addr);
 
     for (i = 0; i < params->n; i++) {
         buf[2*params->n + i] = in[i] ^ bitmask[i];
     }
     return core_hash(params, out, buf, 3 * params->n);
 }
+
+/*
+ * get_key_and_mask for 8 addresses. Lanes that would use the bitmask table
+ * go through it one by one; otherwise the PRF calls are batched.
+ */
+static void get_key_and_mask_x8(const xmss_params *params,
+                                unsigned char *key[8], unsigned char *bitmask[8],
+                                unsigned int num_masks,
+                                const hash_ctx *ctx, uint32_t addr[8][8])
+{
+    unsigned char addr_as_bytes[8][32];
+    const unsigned char *in[8];
+    unsigned char *out[8];
+    unsigned int i, j;
+
+    if (ctx->table != NULL) {
+        for (j = 0; j < 8 && addr[j][0] < ctx->table->min_layer; j++);
+        if (j < 8) {
+            for (j = 0; j < 8; j++) {
+                get_key_and_mask(params, key[j], bitmask[j], num_masks,
+                                 ctx, addr[j]);
+            }
+            return;
+        }
+    }
+
+    /* Generate the n-byte keys. */
+    for (j = 0; j < 8; j++) {
+        in[j] = addr_as_bytes[j];
+        set_key_and_mask(addr[j], 0);
+        addr_to_bytes(addr_as_bytes[j], addr[j]);
+    }
+    prf_keyed_x8(params, key, in, &ctx->prf);
+
+    /* Generate the n-byte masks. */
+    for (i = 0; i < num_masks; i++) {
+        for (j = 0; j < 8; j++) {
+            set_key_and_mask(addr[j], i + 1);
+            addr_to_bytes(addr_as_bytes[j], addr[j]);
+            out[j] = bitmask[j] + i*params->n;
+        }
+        prf_keyed_x8(params, out, in, &ctx->prf);
+    }
+}
+
+int thash_h_x8(const xmss_params *params,
+               unsigned char *out[8], const unsigned char *in[8],
+               const hash_ctx *ctx, uint32_t addr[8][8])
+{
+    unsigned char buf[8][4 * params->n];
+    unsigned char bitmask[8][2 * params->n];
+    unsigned char *key[8];
+    unsigned char *mask[8];
+    const unsigned char *msg[8];
+    unsigned int i, j;
+
+    for (j = 0; j < 8; j++) {
+        /* Set the function padding. */
+        ull_to_bytes(buf[j], params->n, XMSS_HASH_PADDING_H);
+        key[j] = buf[j] + params->n;
+        mask[j] = bitmask[j];
+        msg[j] = buf[j];
+    }
+
+    /* Generate the n-byte keys and the 2n-byte masks. */
+    get_key_and_mask_x8(params, key, mask, 2, ctx, addr);
+
+    for (j = 0; j < 8; j++) {
+        for (i = 0; i < 2 * params->n; i++) {
+            buf[j][2*params->n + i] = in[j][i] ^ bitmask[j][i];
+        }
+    }
+    return core_hash_x8(params, out, msg, 4 * params->n);
+}
+
+int thash_f_x8(const xmss_params *params,
+               unsigned char *out[8], const unsigned char *in[8],
+               const hash_ctx *ctx, uint32_t addr[8][8])
+{
+    unsigned char buf[8][3 * params->n];
+    unsigned char bitmask[8][params->n];
+    unsigned char *key[8];
+    unsigned char *mask[8];
+    const unsigned char *msg[8];
+    unsigned int i, j;
+
+    for (j = 0; j < 8; j++) {
+        /* Set the function padding. */
+        ull_to_bytes(buf[j], params->n, XMSS_HASH_PADDING_F);
+        key[j] = buf[j] + params->n;
+        mask[j] = bitmask[j];
+        msg[j] = buf[j];
+    }
+
+    /* Generate the n-byte keys and the n-byte masks. */
+    get_key_and_mask_x8(params, key, mask, 1, ctx, addr);
+
+    for (j = 0; j < 8; j++) {
+        for (i = 0; i < params->n; i++) {
+            buf[j][2*params->n + i] = in[j][i] ^ bitmask[j][i];
+        }
+    }
+    return core_hash_x8(params, out, msg, 3 * params->n);
+}
+
+int thash_h(const xmss_params *params,
+            unsigned char *out, const unsigned char *in,
+            const unsigned char *pub_seed, uint32_t addr[8])
+{
+    hash_ctx ctx;
+
+    hash_ctx_init(params, &ctx, pub_seed);
+    return thash_h_ctx(params, out, in, &ctx, addr);
+}
+
+int thash_f(const xmss_params *params,
+            unsigned char *out, const unsigned char *in,
+            const unsigned char *pub_seed, uint32_t addr[8])
+{
+    hash_ctx ctx;
+
+    hash_ctx_init(params, &ctx, pub_seed);
+    return thash_f_ctx(params, out, in, &ctx, addr);
+}
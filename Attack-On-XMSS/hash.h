@@ -2,14 +2,75 @@
 #define XMSS_HASH_H
 
 #include <stdint.h>
+#include <openssl/sha.h>
 #include "params.h"
 
+/* PRF keyed once. For SHA-2 the first input block of PRF(key, in) is always
+ * toByte(3, n) || key, so the hash state after compressing it is kept and
+ * every evaluation under the same key only compresses the block holding `in`.
+ * SHAKE has no complete first block to save, so only the key is kept.
+ * The key is not copied; it must outlive the context. */
+typedef struct {
+    const unsigned char *key;
+    union {
+        SHA256_CTX sha256;
+        SHA512_CTX sha512;
+    } state;
+} prf_ctx;
+
 void addr_to_bytes(unsigned char *bytes, const uint32_t addr[8]);
 
 int prf(const xmss_params *params,
         unsigned char *out, const unsigned char in[32],
         const unsigned char *key);
 
+/*
+ * Compresses the first block of PRF(key, .) into ctx.
+ */
+void prf_keyed_init(const xmss_params *params,
+                    prf_ctx *ctx, const unsigned char *key);
+
+/*
+ * Computes PRF(key, in) for the key ctx was initialized with.
+ */
+int prf_keyed(const xmss_params *params,
+              unsigned char *out, const unsigned char in[32],
+              const prf_ctx *ctx);
+
+/* Direct-mapped cache of the n-byte keys and (up to 2n-byte) bitmasks that
+ * thash_f / thash_h derive from pub_seed, indexed by hash address. A miss
+ * computes the entry and overwrites whatever occupied its slot. Addresses
+ * with a layer below min_layer bypass the cache. Lookups write to the cache,
+ * so a context with a table must not be shared between threads. */
+typedef struct {
+    unsigned char *entries;
+    unsigned long long mask;
+    uint32_t min_layer;
+} bitmask_table;
+
+/* Everything thash_f / thash_h need besides their input and address. The
+ * PRF is keyed with pub_seed once, so deriving a key or bitmask costs a single
+ * compression. table is optional (NULL to disable). */
+typedef struct {
+    const unsigned char *pub_seed;
+    prf_ctx prf;
+    bitmask_table *table;
+} hash_ctx;
+
+/*
+ * Initializes a hash context for pub_seed, without a bitmask table.
+ */
+void hash_ctx_init(const xmss_params *params,
+                   hash_ctx *ctx, const unsigned char *pub_seed);
+
+/*
+ * Allocates an empty bitmask table of 2^log_entries entries.
+ */
+void bitmask_table_init(const xmss_params *params, bitmask_table *table,
+                        unsigned int log_entries, uint32_t min_layer);
+
+void bitmask_table_free(bitmask_table *table);
+
 int h_msg(const xmss_params *params,
           unsigned char *out,
           const unsigned char *in, unsigned long long inlen,
@@ -23,6 +84,27 @@ int thash_f(const xmss_params *params,
             unsigned char *out, const unsigned char *in,
             const unsigned char *pub_seed, uint32_t addr[8]);
 
+int thash_h_ctx(const xmss_params *params,
+                unsigned char *out, const unsigned char *in,
+                const hash_ctx *ctx, uint32_t addr[8]);
+
+int thash_f_ctx(const xmss_params *params,
+                unsigned char *out, const unsigned char *in,
+                const hash_ctx *ctx, uint32_t addr[8]);
+
+/*
+ * thash_h / thash_f on 8 independent inputs at once, lane j hashing in[j]
+ * under addr[j] into out[j]. Every input is read before any output is
+ * written, so the buffers of different lanes may overlap.
+ */
+int thash_h_x8(const xmss_params *params,
+               unsigned char *out[8], const unsigned char *in[8],
+               const hash_ctx *ctx, uint32_t addr[8][8]);
+
+int thash_f_x8(const xmss_params *params,
+               unsigned char *out[8], const unsigned char *in[8],
+               const hash_ctx *ctx, uint32_t addr[8][8]);
+
 int hash_message(const xmss_params *params, unsigned char *out,
                  const unsigned char *R, const unsigned char *root,
                  unsigned long long idx,
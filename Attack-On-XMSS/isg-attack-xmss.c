@@ -16,101 +16,597 @@ int increment_bytes(u8 *bytes, int num_bytes){
 	}
 }
 
-bst* create_node(){
-	bst *node = (bst *)malloc(sizeof(bst));
+// Starts an arena without memory; arena_reserve() provides it
+void arena_init(arena *mem){
+	mem->base = NULL;
+	mem->capacity = 0;
+	mem->used = 0;
+}
+
+// Makes sure the empty arena can serve capacity bytes, as counted by arena_size(). The attack
+// allocates everything from the arena without checking, so a failure to reserve it is fatal
+void arena_reserve(arena *mem, size_t capacity){
+	unsigned char *base;
+
+	if (capacity > mem->capacity) {
+		base = malloc(capacity);
+		if (base == NULL) {
+			perror("arena");
+			exit(EXIT_FAILURE);
+		}
+		free(mem->base);
+		mem->base = base;
+		mem->capacity = capacity;
+	}
+}
+
+// Number of arena bytes an allocation of the given size takes up, including alignment padding
+size_t arena_size(size_t bytes){
+	return (bytes + _Alignof(max_align_t) - 1) & ~(_Alignof(max_align_t) - 1);
+}
+
+// Returns bytes of uninitialized memory, or NULL if the arena is exhausted
+void *arena_alloc(arena *mem, size_t bytes){
+	void *p;
+
+	if (arena_size(bytes) > mem->capacity - mem->used)
+		return NULL;
+	p = mem->base + mem->used;
+	mem->used += arena_size(bytes);
+	return p;
+}
+
+// Releases every allocation at once
+void arena_reset(arena *mem){
+	mem->used = 0;
+}
+
+void arena_free(arena *mem){
+	free(mem->base);
+	arena_init(mem);
+}
+
+// Allocates a tuple with room for an n-byte second secret component key
+sck_tuple* create_node(const xmss_params *params, arena *mem){
+	sck_tuple *node = (sck_tuple *)arena_alloc(mem, sizeof(sck_tuple) + params->n);
 	
-	node->left = NULL;
-	node->right = NULL;
 	node->next = NULL;
 
 	return node;
 }
-/*bst *insert_node(bst *root, bst *wots_node, const xmss_params *params){
-	int gl=0;
-	bst *temp=root;
-	
-	if(temp==NULL){
-		return wots_node;
-	}else{
-		
-		gl = memcmp(temp->wots_sec_comp1, wots_node->wots_sec_comp1, params->n);
-		
-		if(gl > 0)
-			temp->left = insert_node(temp->left, wots_node, params);
-		else if (gl < 0)
-			temp->right = insert_node(temp->right, wots_node, params);
-		return temp;
-	}
-}*/
 
-bst *insert_node(bst *root, bst *wots_node, const xmss_params *params){
-	int gl=0;
-	bst *temp=root;
-	bst *templ;
-	
-	if(temp==NULL){
-		return wots_node;
-	}else{
-		
-		gl = memcmp(temp->wots_sec_comp1, wots_node->wots_sec_comp1, params->n);
+// Computes the 64-bit fingerprint of a (position, secret component key) pair. Secret component
+// keys are PRF outputs, so their first 8 bytes are already uniformly distributed. 0 is reserved to
+// mark empty slots. Two keys with equal fingerprints are treated as equal; a false match is caught by
+// the second component and leaf checks of the Secret-Guessing phase.
+uint64_t sck_fingerprint(unsigned int position, const unsigned char *wots_sec_comp){
+	uint64_t fp;
+
+	memcpy(&fp, wots_sec_comp, sizeof(fp));
+	fp ^= (uint64_t)(position + 1) * 0x9E3779B97F4A7C15ULL;
 
-		if(gl==0){
-			templ = temp;
-			while(templ->next != NULL){
+	return fp ? fp : 1;
+}
+
+// Number of slots of a table for at most max_tuples distinct keys, keeping the load factor at or
+// below 1/2
+unsigned long long sck_table_capacity(unsigned long long max_tuples){
+	unsigned long long capacity = 16;
+
+	while (capacity < 2*max_tuples)
+		capacity <<= 1;
+
+	return capacity;
+}
+
+// Allocates an empty table with room for at least max_tuples distinct keys from mem
+void sck_table_init(SCKTable *table, unsigned long long max_tuples, arena *mem){
+	unsigned long long capacity = sck_table_capacity(max_tuples);
+
+	table->slots = arena_alloc(mem, capacity * sizeof(sck_slot));
+	memset(table->slots, 0, capacity * sizeof(sck_slot));
+	table->mask = capacity - 1;
+	table->num_tuples = 0;
+}
+
+// Inserts a tuple keyed by its position and fingerprint. If a tuple with an equal key is already
+// stored, the new tuple is appended to the end of its next chain.
+void sck_table_insert(SCKTable *table, sck_tuple *tuple){
+	uint64_t fp = tuple->fingerprint;
+	unsigned long long i = fp & table->mask;
+	sck_tuple *templ;
+
+	while (table->slots[i].fingerprint != 0) {
+		templ = table->slots[i].tuple;
+		if (table->slots[i].fingerprint == fp && templ->position == tuple->position) {
+			while (templ->next != NULL)
 				templ = templ->next;
+			templ->next = tuple;
+			table->num_tuples++;
+			return;
+		}
+		i = (i + 1) & table->mask;
+	}
+	table->slots[i].fingerprint = fp;
+	table->slots[i].tuple = tuple;
+	table->num_tuples++;
+}
+
+// Returns the first tuple whose key is (position, wots_sec_comp), or NULL if there is none
+sck_tuple *sck_table_find(const SCKTable *table, unsigned int position,
+                          const unsigned char *wots_sec_comp){
+	uint64_t fp = sck_fingerprint(position, wots_sec_comp);
+	unsigned long long i = fp & table->mask;
+	const sck_slot *slot;
+
+	for (slot = &table->slots[i]; slot->fingerprint != 0; slot = &table->slots[i]) {
+		if (slot->fingerprint == fp && slot->tuple->position == (int)position) {
+			return slot->tuple;
+		}
+		i = (i + 1) & table->mask;
+	}
+	return NULL;
+}
+
+// Harvesting callback of the query phase. Keeps a tuple for every WOTS instance that is new with the
+// query and has at least two chains of length 0, i.e. reveals two secret component keys. The tuples
+// are only inserted into the table once the whole signature has verified.
+static void harvest_layer(void *arg, const xmss_params *params, uint32_t layer,
+                          const uint32_t ots_addr[8], const unsigned char *wots_sig,
+                          const unsigned char *wots_pk, const unsigned char *leaf,
+                          const int *lengths, const unsigned int *zero_chains,
+                          unsigned int num_zero_chains){
+	query_harvest *harvest = arg;
+	sck_tuple *wots_node;
+
+	(void)wots_pk;
+	(void)lengths;
+
+	if (layer >= harvest->num_new_layers || num_zero_chains < 2)
+		return;
+
+	//Create the tuple using the secret component keys
+	wots_node = create_node(params, harvest->mem);
+
+	//Store the fingerprint of the key secret component of the wots
+	wots_node->fingerprint = sck_fingerprint(zero_chains[0], wots_sig + zero_chains[0]*params->n);
+
+	//Store second secret component of the wots
+	memcpy(wots_node->wots_sec_comp2, wots_sig + zero_chains[1]*params->n, params->n);
+
+	//Store index of both secret components of the wots
+	wots_node->position = zero_chains[0];
+	wots_node->index = zero_chains[1];
+
+	//Store the keypair the wots belongs to
+	wots_node->target = harvest->target;
+
+	//Store ots_addr of the wots
+	memcpy(wots_node->ots_addr, ots_addr, 32);
+
+	//Store the truncated leaf of the wots
+	memcpy(wots_node->leaf, leaf, SCK_LEAF_BYTES);
+
+	harvest->pending[harvest->num_pending++] = wots_node;
+}
+
+// Writes guess index guess into the byte array, using the same little-endian layout that
+// increment_bytes() counts in, so the guess-th seed visited by the Secret-Guessing phase is
+// independent of which worker visits it
+void guess_to_bytes(u8 *bytes, int num_bytes, long guess){
+	for (int i = 0; i < num_bytes; i++) {
+		bytes[i] = (u8)guess;
+		guess = (unsigned long)guess >> 8;
+	}
+}
+
+// Returns 1 if some target has not forged with a guess index at or below guess, 0 otherwise
+static int guess_wanted(guess_phase *gp, long guess){
+	for (int t = 0; t < gp->num_targets; t++) {
+		if (atomic_load_explicit(&gp->targets[t].success_guess, memory_order_relaxed) > guess)
+			return 1;
+	}
+	return 0;
+}
+
+// Tries the guess-th guess of a WOTS seed against one tuple whose key it matches, if the tuple's
+// target still wants it. Lowers the target's success_guess to guess if it forges a WOTS signature.
+// sigf holds the secret component keys expand_seed() derives from ots_seed_g, and holds them again
+// on return.
+static void try_tuple(guess_phase *gp, long guess, const unsigned char *ots_seed_g,
+                      unsigned char *sigf, sck_tuple *found_element){
+	const xmss_params *params = gp->params;
+	unsigned char wots_pkf[params->wots_sig_bytes];
+	unsigned char leaf[params->n];
+	unsigned char mf[params->n];
+	uint32_t ltree_addr[8] = {0};
+	attack_target *target = &gp->targets[found_element->target];
+	long success;
+
+	if (atomic_load_explicit(&target->success_guess, memory_order_relaxed) <= guess)
+		return;
+
+	//Check the second component
+	if(memcmp(found_element->wots_sec_comp2, sigf+found_element->index*params->n, params->n)!=0)
+		return;
+
+	// Choose a random message
+	randombytes(mf, params->n);
+
+	wots_sign_ctx(params, sigf, mf, ots_seed_g, &target->hash, found_element->ots_addr);
+
+	//Compute the wots_pk and the leaf from the forged signature
+	wots_pk_from_sig_ctx(params, wots_pkf, sigf, mf, &target->hash, found_element->ots_addr);
+	copy_subtree_addr(ltree_addr, found_element->ots_addr);
+	set_type(ltree_addr, XMSS_ADDR_TYPE_LTREE);
+	set_ltree_addr(ltree_addr, found_element->ots_addr[4]);
+	l_tree_ctx(params, leaf, wots_pkf, &target->hash, ltree_addr);
+
+	//Check the leaf from forged signature against the leaf from the stored tuple
+	if (memcmp(found_element->leaf, leaf, SCK_LEAF_BYTES)==0) {
+		// Lower the target's success index to guess, unless a smaller one is already known
+		success = atomic_load(&target->success_guess);
+		while (guess < success &&
+		       !atomic_compare_exchange_weak(&target->success_guess, &success, guess));
+	}
+	expand_seed(params, sigf, ots_seed_g);
+}
+
+// Tries the guess-th guess of a WOTS seed against every tuple in the table, for the targets that
+// still want it. Lowers the success_guess of every target it forges a WOTS signature for to guess.
+// sigf must have room for params->wots_sig_bytes bytes.
+static void try_guess(guess_phase *gp, long guess, const unsigned char *ots_seed_g,
+                      unsigned char *sigf){
+	const xmss_params *params = gp->params;
+	sck_tuple *found_element;
+	unsigned int j;
+
+	expand_seed(params, sigf, ots_seed_g);
+
+	for (j = 0; j < params->wots_len; j++) {
+		for (found_element = sck_table_find(gp->table, j, sigf+j*params->n);
+		     found_element != NULL; found_element = found_element->next) {
+			try_tuple(gp, guess, ots_seed_g, sigf, found_element);
+		}
+	}
+}
+
+// Records the runtime of every checkpoint that the completed prefix of the guess space has passed,
+// for every target, and finishes a target once its smallest successful guess lies inside that
+// prefix or its last checkpoint is reached. The Secret-Guessing phase is done once every target is.
+// Must be called with gp->lock held.
+static void guess_phase_advance(guess_phase *gp){
+	long frontier = gp->next_guess;
+	long success;
+	clock_t elapsed, temp_time;
+	attack_target *target;
+	int done = 1;
+
+	for (int w = 0; w < gp->num_workers; w++) {
+		if (gp->workers[w].chunk_start >= 0 && gp->workers[w].chunk_start < frontier)
+			frontier = gp->workers[w].chunk_start;
+	}
+
+	//Guessing time so far. clock() is process CPU time, so with several workers this is the total
+	//work of all of them, which keeps it comparable with single-threaded runs
+	elapsed = clock() - gp->guess_start_time;
+
+	for (int t = 0; t < gp->num_targets; t++) {
+		target = &gp->targets[t];
+		success = atomic_load(&target->success_guess);
+		temp_time = target->query_time + elapsed;
+
+		while (target->next_checkpoint_index < gp->num_runtime_checkpoints &&
+		       gp->num_sk_guesses[target->next_checkpoint_index] <= frontier &&
+		       gp->num_sk_guesses[target->next_checkpoint_index] <= success) {
+			target->attack_result->intermediate_runtimes[target->next_checkpoint_index] = temp_time;
+			target->next_checkpoint_index++;
+		}
+
+		// If attack succeeded, the runtime of all the remaining checkpoints is the current runtime
+		if (success < frontier) {
+			for (int i = target->next_checkpoint_index; i < gp->num_runtime_checkpoints; i++) {
+				target->attack_result->intermediate_runtimes[i] = temp_time;
 			}
-			templ->next = wots_node;
-			//return temp;
-		}else 
-		if(gl > 0)
-			temp->left = insert_node(temp->left, wots_node, params);
-		else if (gl < 0)
-			temp->right = insert_node(temp->right, wots_node, params);
-		return temp;
+			target->next_checkpoint_index = gp->num_runtime_checkpoints;
+			target->attack_result->success_guess = success;
+		}
+
+		if (target->next_checkpoint_index < gp->num_runtime_checkpoints)
+			done = 0;
 	}
+
+	gp->done = done;
 }
 
-bst *find_node(bst *root, unsigned char *wots_sec_comp, const xmss_params *params){
-	int gl;
-	bst *temp = root;
-	if(temp==NULL)
-		return NULL;
-	else{
-		gl = memcmp(temp->wots_sec_comp1, wots_sec_comp, params->n);
-		if(gl == 0)
-			return temp;
-		else if(gl > 0)
-			return find_node(temp->left, wots_sec_comp, params);
-		else if (gl < 0)
-			return find_node(temp->right, wots_sec_comp, params);
-		
+// Secret-Guessing phase worker. Repeatedly claims the next chunk of consecutive guesses, tries them
+// in order, and stops early as soon as every target has forged with a smaller guess index.
+void *guess_worker_run(void *arg){
+	guess_worker *worker = arg;
+	guess_phase *gp = worker->gp;
+	const xmss_params *params = gp->params;
+	unsigned char ots_seed_g[params->n];
+	unsigned char sigf[params->wots_sig_bytes];
+	long guess, end;
+	int k;
+
+	pthread_mutex_lock(&gp->lock);
+	while (!gp->done && gp->next_guess < gp->num_sk_guesses[gp->num_runtime_checkpoints-1] &&
+	       guess_wanted(gp, gp->next_guess)) {
+		// Claim a chunk. Chunks never straddle a checkpoint, so the runtime of a checkpoint never
+		// includes guesses past it
+		guess = gp->next_guess;
+		end = guess + GUESS_CHUNK_SIZE;
+		for (k = 0; gp->num_sk_guesses[k] <= guess; k++);
+		if (end > gp->num_sk_guesses[k])
+			end = gp->num_sk_guesses[k];
+		gp->next_guess = end;
+		worker->chunk_start = guess;
+		pthread_mutex_unlock(&gp->lock);
+
+		guess_to_bytes(ots_seed_g, params->n, guess);
+		for (; guess < end; guess++) {
+			if (!guess_wanted(gp, guess))
+				break;
+			try_guess(gp, guess, ots_seed_g, sigf);
+			increment_bytes(ots_seed_g, params->n);
+		}
+
+		pthread_mutex_lock(&gp->lock);
+		worker->chunk_start = -1;
+		guess_phase_advance(gp);
 	}
+	pthread_mutex_unlock(&gp->lock);
+
+	return NULL;
 }
 
-void free_tree(bst *root){
-	bst *temp = root;
-	bst *templ1, *templ2;
-	if(temp!=NULL){
-		if(temp->next!=NULL){
-			templ1 = temp->next;
-			while(templ1!=NULL){
-				templ2 = templ1->next;
-				free(templ1);
-				templ1 = templ2;
-			}		
+// Orders join candidates by guess index
+static int guess_candidate_cmp(const void *a, const void *b){
+	const guess_candidate *x = a, *y = b;
+
+	return (x->guess > y->guess) - (x->guess < y->guess);
+}
+
+// Tries join candidates in increasing guess order, expanding each guess once, and records the
+// checkpoints the tried guesses pass. Every guess below end counts as tried once the candidates are.
+// Must be called with gp->lock held.
+static void guess_phase_try_candidates(guess_phase *gp, guess_candidate *candidates,
+                                       size_t num_candidates, long end){
+	const xmss_params *params = gp->params;
+	unsigned char ots_seed_g[params->n];
+	unsigned char sigf[params->wots_sig_bytes];
+	long expanded = -1;
+
+	qsort(candidates, num_candidates, sizeof(guess_candidate), guess_candidate_cmp);
+
+	for (size_t k = 0; k < num_candidates; k++) {
+		if (candidates[k].guess != expanded) {
+			//Every guess below this one is tried
+			gp->next_guess = candidates[k].guess;
+			guess_phase_advance(gp);
+			if (gp->done)
+				return;
+
+			guess_to_bytes(ots_seed_g, params->n, candidates[k].guess);
+			expand_seed(params, sigf, ots_seed_g);
+			expanded = candidates[k].guess;
 		}
-		free_tree(temp->left);
-		free_tree(temp->right);
-		free(temp->wots_sec_comp1);
-		free(temp->wots_sec_comp2);
-		free(temp->ots_pk);
-		free(temp);
+		try_tuple(gp, expanded, ots_seed_g, sigf, candidates[k].tuple);
 	}
+	gp->next_guess = end;
+	guess_phase_advance(gp);
 }
 
+// Reports a failed allocation of the dictionary join, which cannot carry on without its candidates
+static void dict_join_check(const void *allocated){
+	if (allocated == NULL) {
+		perror("guess dictionary join");
+		exit(EXIT_FAILURE);
+	}
+}
 
-void isg_attack_xmss(ISG_Attack_Result* attack_result, long que, long num_sk_guesses[],
-                  int num_runtime_checkpoints, int debug) {
+// Secret-Guessing phase as a join against a guess dictionary. Instead of expanding every guess and
+// probing the table with it, looks up the key of every harvested tuple in the dictionary, which
+// yields the guesses with a matching secret component key, and only expands and tries those, in
+// increasing order. Checkpoints are recorded as the tried guesses pass them, so the results are
+// those of guess_worker_run().
+static void guess_phase_join(guess_phase *gp, const guess_dict *dict){
+	const SCKTable *table = gp->table;
+	long max_guess = gp->num_sk_guesses[gp->num_runtime_checkpoints-1];
+	guess_candidate *candidates, *grown_candidates;
+	size_t num_candidates = 0, max_candidates = table->num_tuples + 16;
+	const uint64_t *fingerprints;
+	const uint32_t *guesses;
+	sck_tuple *tuple;
+	uint64_t fp, s, k;
+
+	candidates = malloc(max_candidates * sizeof(guess_candidate));
+	dict_join_check(candidates);
+
+	//Join the keys of the harvested tuples with the dictionary. Guesses past the last checkpoint
+	//are never tried
+	for (unsigned long long i = 0; i <= table->mask; i++) {
+		fp = table->slots[i].fingerprint;
+		if (fp == 0)
+			continue;
+		for (s = 0; s < dict->header->num_shards &&
+		            (long)(s * dict->header->guesses_per_shard) < max_guess; s++) {
+			fingerprints = guess_dict_fingerprints(dict, s);
+			guesses = guess_dict_guesses(dict, s);
+			for (k = guess_dict_lower_bound(dict, s, fp);
+			     k < dict->shard_entries && fingerprints[k] == fp; k++) {
+				if ((long)guesses[k] >= max_guess)
+					continue;
+				for (tuple = table->slots[i].tuple; tuple != NULL; tuple = tuple->next) {
+					if (num_candidates == max_candidates) {
+						grown_candidates = realloc(candidates,
+						                           2 * max_candidates * sizeof(guess_candidate));
+						dict_join_check(grown_candidates);
+						candidates = grown_candidates;
+						max_candidates *= 2;
+					}
+					candidates[num_candidates].guess = guesses[k];
+					candidates[num_candidates].tuple = tuple;
+					num_candidates++;
+				}
+			}
+		}
+	}
+
+	pthread_mutex_lock(&gp->lock);
+	guess_phase_try_candidates(gp, candidates, num_candidates, max_guess);
+	pthread_mutex_unlock(&gp->lock);
+
+	free(candidates);
+}
+
+// Reports a failed read, write or allocation of the out-of-core join, which cannot carry on
+// without its runs
+static void ext_join_check(int ret){
+	if (ret < 0) {
+		perror("external sort-merge join");
+		exit(EXIT_FAILURE);
+	}
+}
+
+// Joins the sorted tuples with the sorted guess records of one range of guesses, and appends a
+// candidate for every tuple and guess whose keys match. The matching tuples are copied out of the
+// runs, and the copies are appended to matched so that they can be freed.
+static void guess_phase_merge_join(const ext_sorter *tuples, const ext_sorter *guesses,
+                                   size_t budget, guess_candidate **candidates,
+                                   size_t *num_candidates, size_t *max_candidates,
+                                   sck_tuple ***matched, size_t *num_matched,
+                                   size_t *max_matched){
+	guess_candidate *grown_candidates;
+	sck_tuple **grown_matched;
+	ext_merge tm, gm;
+	const sck_tuple *t;
+	const guess_record *g;
+	size_t group, k;
+	uint64_t fp;
+
+	// The two merges share the budget
+	ext_join_check(ext_merge_open(&tm, tuples, budget / 2));
+	ext_join_check(ext_merge_open(&gm, guesses, budget / 2));
+	t = ext_merge_peek(&tm);
+	g = ext_merge_peek(&gm);
+	while (t != NULL && g != NULL) {
+		if (t->fingerprint < g->fingerprint) {
+			ext_join_check(ext_merge_next(&tm));
+			t = ext_merge_peek(&tm);
+		} else if (g->fingerprint < t->fingerprint) {
+			ext_join_check(ext_merge_next(&gm));
+			g = ext_merge_peek(&gm);
+		} else {
+			//Copy out every tuple of the key, as each guess of the key is matched with all of them
+			fp = t->fingerprint;
+			group = *num_matched;
+			for (; t != NULL && t->fingerprint == fp; t = ext_merge_peek(&tm)) {
+				if (*num_matched == *max_matched) {
+					grown_matched = realloc(*matched, 2 * *max_matched * sizeof(sck_tuple *));
+					ext_join_check(grown_matched == NULL ? -1 : 0);
+					*matched = grown_matched;
+					*max_matched *= 2;
+				}
+				(*matched)[*num_matched] = malloc(tuples->record_size);
+				ext_join_check((*matched)[*num_matched] == NULL ? -1 : 0);
+				memcpy((*matched)[*num_matched], t, tuples->record_size);
+				(*matched)[*num_matched]->next = NULL;
+				(*num_matched)++;
+				ext_join_check(ext_merge_next(&tm));
+			}
+			for (; g != NULL && g->fingerprint == fp; g = ext_merge_peek(&gm)) {
+				for (k = group; k < *num_matched; k++) {
+					if ((*matched)[k]->position != (int)g->position)
+						continue;
+					if (*num_candidates == *max_candidates) {
+						grown_candidates = realloc(*candidates,
+						                           2 * *max_candidates * sizeof(guess_candidate));
+						ext_join_check(grown_candidates == NULL ? -1 : 0);
+						*candidates = grown_candidates;
+						*max_candidates *= 2;
+					}
+					(*candidates)[*num_candidates].guess = g->guess;
+					(*candidates)[*num_candidates].tuple = (*matched)[k];
+					(*num_candidates)++;
+				}
+				ext_join_check(ext_merge_next(&gm));
+			}
+		}
+	}
+	ext_merge_close(&tm);
+	ext_merge_close(&gm);
+}
+
+// Secret-Guessing phase as an out-of-core sort-merge join against the tuples sorted into runs by
+// the query phase. The guesses are handled one checkpoint at a time: the secret component keys of
+// the guesses up to the checkpoint are expanded into guess records, sorted into runs in budget bytes
+// and merge-joined with the tuples, and the candidates found are tried in increasing order. So the
+// runtime of a checkpoint only covers the guesses below it, and the phase stops at the first
+// checkpoint past which no target is left, as guess_worker_run() does.
+static void guess_phase_external(guess_phase *gp, ext_sorter *tuples, size_t budget){
+	const xmss_params *params = gp->params;
+	unsigned char ots_seed_g[params->n];
+	unsigned char sigf[params->wots_sig_bytes];
+	guess_candidate *candidates;
+	sck_tuple **matched;
+	size_t num_candidates, max_candidates = 16, num_matched, max_matched = 16, i;
+	ext_sorter guesses;
+	guess_record record;
+	unsigned int j;
+	long guess, start = 0, end;
+
+	// The runs are read with half of the budget each time they are joined
+	ext_join_check(ext_sorter_finish(tuples, budget / 2));
+
+	candidates = malloc(max_candidates * sizeof(guess_candidate));
+	matched = malloc(max_matched * sizeof(sck_tuple *));
+	ext_join_check(candidates == NULL || matched == NULL ? -1 : 0);
+
+	for (int k = 0; k < gp->num_runtime_checkpoints; k++) {
+		end = gp->num_sk_guesses[k];
+		if (end <= start)
+			continue;
+
+		ext_join_check(ext_sorter_init(&guesses, sizeof(guess_record), budget));
+		guess_to_bytes(ots_seed_g, params->n, start);
+		for (guess = start; guess < end; guess++) {
+			expand_seed(params, sigf, ots_seed_g);
+			for (j = 0; j < params->wots_len; j++) {
+				record.fingerprint = sck_fingerprint(j, sigf + j*params->n);
+				record.guess = guess;
+				record.position = j;
+				ext_join_check(ext_sorter_add(&guesses, &record));
+			}
+			increment_bytes(ots_seed_g, params->n);
+		}
+		ext_join_check(ext_sorter_finish(&guesses, budget / 2));
+
+		num_candidates = 0;
+		num_matched = 0;
+		guess_phase_merge_join(tuples, &guesses, budget, &candidates, &num_candidates,
+		                       &max_candidates, &matched, &num_matched, &max_matched);
+		ext_sorter_free(&guesses);
+
+		pthread_mutex_lock(&gp->lock);
+		guess_phase_try_candidates(gp, candidates, num_candidates, end);
+		pthread_mutex_unlock(&gp->lock);
+
+		for (i = 0; i < num_matched; i++)
+			free(matched[i]);
+		if (gp->done)
+			break;
+		start = end;
+	}
+
+	free(candidates);
+	free(matched);
+}
+
+void isg_attack_xmss_shared(ISG_Attack_Result attack_results[], int num_targets, long que,
+                  long num_sk_guesses[], int num_runtime_checkpoints, int num_threads,
+                  const guess_dict *dict, size_t ext_budget, arena *mem, int debug) {
 	xmss_params params;
 	uint32_t oid;
     	    	
@@ -118,318 +614,258 @@ void isg_attack_xmss(ISG_Attack_Result* attack_result, long que, long num_sk_gue
     	XMSS_STR_TO_OID(&oid, XMSS_VARIANT);
     	XMSS_PARSE_OID(&params, oid);
 
-    	unsigned char pk[XMSS_OID_LEN + params.pk_bytes];
+    	unsigned char *pk;
     	unsigned char sk[XMSS_OID_LEN + params.sk_bytes];
-    	unsigned char *m = malloc(XMSS_MLEN);
-	unsigned char *mf = malloc(params.n);
-	unsigned char *mout = malloc(params.sig_bytes + XMSS_MLEN);
+    	unsigned char *m;
+	unsigned char *mout;
+	unsigned char *sm_buf;
+	unsigned char *sm;
     	unsigned long long smlen;
     	unsigned long long mlen;
-	unsigned long long no_wots_nodes = 0;
-
-	//struct gdsl_bstree 
-	bst *SCKTables[params.wots_len];
-	bst *wots_node=NULL;
-
-	for(int i=0;i<params.wots_len;i++)
-		SCKTables[i] = NULL;
 
-	//initialization of xmss^mt    	
-	XMSS_KEYPAIR(pk, sk, oid);
-	
-	if (debug) {
-		printf("\nInitialization Done\n");
+	SCKTable SCKTables;
+	ext_sorter ext_tuples;
+	size_t ext_tuple_size = (sizeof(sck_tuple) + params.n + 7) & ~(size_t)7;
+	unsigned long long num_ext_tuples;
+	attack_target *targets;
+	unsigned long long max_wots_nodes = 0;
+	unsigned long long max_arena_tuples;
+	unsigned long long queries_per_layer = 1;
+	size_t slots_size, tuples_start;
+
+	// Every query harvests at most one tuple per hyper tree layer it walks, and layer i is only
+	// walked by every 2^(i*tree_height)-th query
+	for(unsigned int i=0;i<params.d;i++){
+		max_wots_nodes += (que + queries_per_layer - 1) / queries_per_layer;
+		queries_per_layer <<= params.tree_height;
 	}
 
-	//const unsigned char *pub_root = pk;
-    	const unsigned char *pub_seed = pk + params.n + XMSS_OID_LEN;
-	
+	// Everything the attack allocates fits in the arena up front, so the query phase never calls
+	// the system allocator. The public keys stay allocated, as the targets' hash contexts point
+	// into them. Out of core, the tuples of a query only stay in the arena until they are added to
+	// the runs, and there is no table
+	if (ext_budget) {
+		slots_size = 0;
+		max_arena_tuples = params.d;
+	} else {
+		slots_size = arena_size(sck_table_capacity(num_targets * max_wots_nodes) * sizeof(sck_slot));
+		max_arena_tuples = num_targets * max_wots_nodes;
+	}
+	arena_reserve(mem, arena_size(XMSS_MLEN) + 2*arena_size(params.sig_bytes + XMSS_MLEN)
+		+ arena_size(num_targets * sizeof(attack_target))
+		+ num_targets * arena_size(XMSS_OID_LEN + params.pk_bytes) + slots_size
+		+ max_arena_tuples * arena_size(sizeof(sck_tuple) + params.n));
+	m = arena_alloc(mem, XMSS_MLEN);
+	mout = arena_alloc(mem, params.sig_bytes + XMSS_MLEN);
+	sm_buf = arena_alloc(mem, params.sig_bytes + XMSS_MLEN);
+	targets = arena_alloc(mem, num_targets * sizeof(attack_target));
+	if (ext_budget) {
+		ext_join_check(ext_sorter_init(&ext_tuples, ext_tuple_size, ext_budget));
+	} else {
+		sck_table_init(&SCKTables, num_targets * max_wots_nodes, mem);
+	}
 
-    	unsigned char wots_pk[params.wots_sig_bytes];
-	unsigned char wots_pkf[params.wots_sig_bytes];
-    	unsigned char root[params.n];
-	unsigned char leaf[params.n];
-	unsigned char sigf[params.wots_sig_bytes];
-	unsigned char *mhash = root;
-	unsigned long long idx = 0;
-	uint32_t idx_leaf;
-	//unsigned long long idx2 = 0;
     	unsigned int i,j;
 	unsigned int no_iterations=0;
 	unsigned int temp_no_iterations;
 	int temp_d;
-	uint32_t ots_addr[8];
-    	uint32_t ltree_addr[8];
-    	uint32_t node_addr[8];
 	unsigned long long int no_nodes=(1 << params.tree_height);
-	int lengths[params.wots_len];	
-	unsigned int no_sec_comp;
-	unsigned int sec_comp_idx[2];
-	int has_succeeded;
-	int next_checkpoint_index;
-    	
-	
-	//Initialize success of attack to failure
-	attack_result->success_guess = -1;
+	sck_tuple *pending[params.d];
+	query_harvest harvest;
+	size_t harvest_start;
 
-	clock_t temp_time;
-	clock_t uncounted_time = 0;
-	clock_t attack_start_time = clock();
+	harvest.mem = mem;
+	harvest.pending = pending;
 
-	//query phase
-	if (debug) {
-		printf("\nQuery Phase Starts\n");
-	}
-	for(no_iterations=0; no_iterations<que; no_iterations++){
+	for (int t = 0; t < num_targets; t++) {
+		pk = arena_alloc(mem, XMSS_OID_LEN + params.pk_bytes);
+		tuples_start = mem->used;
+		num_ext_tuples = 0;
 
-		temp_time = clock();
-		unsigned char *sm = malloc(params.sig_bytes + XMSS_MLEN);
-		//choose a random message m
-		randombytes(m, XMSS_MLEN);
-		
+		//initialization of xmss^mt    	
+		XMSS_KEYPAIR(pk, sk, oid);
 	
-		//sign message m and get signature sm
-		XMSS_SIGN(sk, sm, &smlen, m, XMSS_MLEN);
-
-		if (XMSS_SIGN_OPEN(mout, &mlen, sm, smlen, pk)) {
-			if (debug) {
-  				printf("  X verification failed!\n");
-			}
-        	}else {
-				if (debug) {
-            		printf("    verification succeeded.\n");
-				}
-        	}
-
-		uncounted_time += clock() - temp_time;
-		//printf("\nPub Seed from query----------------------------\n");
-		//for(i=0; i<params.n; i++)
-		//	printf("%hhu ",pub_seed[i]);
-		//printf("\n");
-		//printf("pk = %p\n",pk);
-		
-
 		if (debug) {
-			printf("Q%d done\n",no_iterations);
+			printf("\nInitialization Done\n");
 		}
 
-		for(i=0;i<8;i++){
-			ots_addr[i] = 0; ltree_addr[i] = 0; node_addr[i] = 0;
-		}
-    		set_type(ots_addr, XMSS_ADDR_TYPE_OTS);
-	    	set_type(ltree_addr, XMSS_ADDR_TYPE_LTREE);
-	    	set_type(node_addr, XMSS_ADDR_TYPE_HASHTREE);
-
-		mlen = smlen - params.sig_bytes;
-		// Convert the index bytes from the signature to an integer. 
-    		idx = (unsigned long)bytes_to_ull(sm, params.index_bytes);
-
-		// Put the message all the way at the end of the m buffer, so that we can
-     	 	// prepend the required other inputs for the hash function. 
-    		memcpy(mout + params.sig_bytes, sm + params.sig_bytes, mlen);
-
-		// Compute the message hash. 
-		mhash = root;
-    		hash_message(&params, mhash, sm + params.index_bytes, pk + XMSS_OID_LEN, idx,
-                	mout + params.sig_bytes - 4*params.n, mlen);
-    		sm += params.index_bytes + params.n;
-
-		temp_no_iterations = no_iterations;
-		temp_d=1;
-
-		for(j=1;j<params.d;j++){
-			if (temp_no_iterations%no_nodes==0){
-				temp_d++;
-				temp_no_iterations = temp_no_iterations / no_nodes;
-			}	
-		}
-		for (i = 0; i < temp_d; i++){
-			idx_leaf = (idx & ((1 << params.tree_height)-1));
-        		idx = idx >> params.tree_height;
-
-			set_layer_addr(ots_addr, i);
-        		set_layer_addr(ltree_addr, i);
-  			set_layer_addr(node_addr, i);
-
-        		set_tree_addr(ltree_addr, idx);
-        		set_tree_addr(ots_addr, idx);
-        		set_tree_addr(node_addr, idx);
-
-			// The WOTS public key is only correct if the signature was correct.
-			set_ots_addr(ots_addr, idx_leaf);
-			
-			wots_pk_from_sig(&params, wots_pk, sm, root, pub_seed, ots_addr);
-
-			chain_lengths(&params, lengths, root);
-			no_sec_comp = 0;
-			j=0;
-			while(no_sec_comp < 2 && j<params.wots_len){
-				if(lengths[j]==0){
-					sec_comp_idx[no_sec_comp]=j;
-					no_sec_comp++;
-				}
-				j++;
-			}
-			
-			if(no_sec_comp == 2){
-				//printf("Q %d S %d\n",no_iterations,i);
-				//Create the tuple using the secret component keys
-				wots_node = create_node();
-						
-				//Store Key secret component of the wots
-				wots_node->wots_sec_comp1 = malloc(params.n);
-				memcpy(wots_node->wots_sec_comp1, sm + sec_comp_idx[0]*params.n, params.n);
-			
-				//Store second secret component of the wots
-				wots_node->wots_sec_comp2 = malloc(params.n);
-				memcpy(wots_node->wots_sec_comp2, sm + sec_comp_idx[1]*params.n, params.n);
-			
-				//Store index of second secret component of the wots
-				wots_node->index = sec_comp_idx[1];
-				
-				//Store ots_addr of the wots
-				memcpy(wots_node->ots_addr, ots_addr, 32);
-
-				//Store pk of the wots
-				wots_node->ots_pk = malloc(params.wots_sig_bytes);
-				memcpy(wots_node->ots_pk, wots_pk, params.wots_sig_bytes);
-
-				//printf("\n    here %d\n", no_iterations);
-				//store the node in the sec_comp_idx[0]-th SCKTables BST
-
-				if(SCKTables[sec_comp_idx[0]]==NULL)
-					SCKTables[sec_comp_idx[0]] = insert_node(SCKTables[sec_comp_idx[0]], wots_node, &params);
-				else insert_node(SCKTables[sec_comp_idx[0]], wots_node, &params);
-
-				//printf("\n   here %d\n", no_iterations);
-				no_wots_nodes++;
-			}
+		//const unsigned char *pub_root = pk;
+	    	const unsigned char *pub_seed = pk + params.n + XMSS_OID_LEN;
 
-			sm += params.wots_sig_bytes;
+		// The query phase re-verifies the same upper-layer WOTS instances and L-trees for 2^tree_height
+		// queries in a row, so their keys and bitmasks are cached. Layer 0 changes on every query.
+		bitmask_table btable;
+		bitmask_table_init(&params, &btable, BITMASK_TABLE_LOG_ENTRIES, 1);
 
-        		// Compute the leaf node using the WOTS public key.
-        		set_ltree_addr(ltree_addr, idx_leaf);
-        		l_tree(&params, leaf, wots_pk, pub_seed, ltree_addr);
+		// Consecutive queries sign under the same subtrees, so each subtree is built once per layer
+		subtree_cache scache;
+		subtree_cache_init(&params, &scache, params.d);
 
-        		// Compute the root node of this subtree.
-        		compute_root(&params, root, leaf, idx_leaf, sm, pub_seed, node_addr);
-        		sm += params.tree_height*params.n;
-		}
-		
-        }
-	if (debug) {
-		printf("\nQuery Phase Ends\n");
-	}
-
-	if (debug) {
-		printf("\nGuess Phase starts\n");
-	}
+		harvest.target = t;
+	
+		//Initialize success of attack to failure
+		attack_results[t].success_guess = -1;
 
-	unsigned char ots_seed_g[params.n];
-	bst *found_element;
-	int found;
+		clock_t temp_time;
+		clock_t uncounted_time = 0;
+		clock_t attack_start_time = clock();
 
-	for(i=0;i<params.n;i++)
-		ots_seed_g[i]= 0;
+		//query phase
+		if (debug) {
+			printf("\nQuery Phase Starts\n");
+		}
+		for(no_iterations=0; no_iterations<que; no_iterations++){
 
-	if (debug) {
-		printf("\nGuess ots seed initialization Done.\n");
-	}
+			temp_time = clock();
+			sm = sm_buf;
+			//choose a random message m
+			randombytes(m, XMSS_MLEN);
+		
+	
+			//sign message m and get signature sm
+			xmssmt_core_sign_cached(&params, sk + XMSS_OID_LEN, sm, &smlen, m, XMSS_MLEN, &scache);
 
-	no_iterations=0;
-	has_succeeded = 0;
-	next_checkpoint_index = 0;
+			uncounted_time += clock() - temp_time;
 
-	while (no_iterations < num_sk_guesses[num_runtime_checkpoints-1] && !has_succeeded){
-		expand_seed(&params, sigf, ots_seed_g);
+			// Only the WOTS instances that are new with this query are harvested; the instances of
+			// layer i only change every 2^(i*tree_height) queries
+			temp_no_iterations = no_iterations;
+			temp_d=1;
 
-		found_element = NULL;
-		found = -1;
-		j=0;
-		
-		//Find the BST node where first matching happens
-		while (found==-1 && j<params.wots_len){
-			found_element = find_node(SCKTables[j], sigf+j*params.n, &params);
-			if(found_element!=NULL){
-				found = j;
+			for(j=1;j<params.d;j++){
+				if (temp_no_iterations%no_nodes==0){
+					temp_d++;
+					temp_no_iterations = temp_no_iterations / no_nodes;
+				}	
 			}
-			else j++;
-		}
-
-		while((found_element!=NULL) && (has_succeeded == 0)){
-			//Check the second component
-			if(memcmp(found_element->wots_sec_comp2, sigf+found_element->index*params.n, params.n)==0){
-				// Choose a random message
-				randombytes(mf, params.n);
-				
-				wots_sign(&params, sigf, mf, ots_seed_g, pub_seed, found_element->ots_addr);
-
-				//Compute the wots_pk from the forged signature
-				wots_pk_from_sig(&params, wots_pkf, sigf, mf, pub_seed, found_element->ots_addr);
-
-				
-				//printf("====================================\n");
-				//Check the pk from forged signature and the pk from the BST node
-				if (memcmp(found_element->ots_pk, wots_pkf, params.wots_sig_bytes)==0) {
-					//printf("\nSuccessful wots_pk Comparison\n");
-        				has_succeeded = 1;
-					attack_result->success_guess = no_iterations;
-     				}//else printf("\nUn-Successful wots_pk Comparison\n");
-			}//else printf("\nUn-Successful 2nd component Comparison\n");
-			
-			found_element = found_element->next;
-			expand_seed(&params, sigf, ots_seed_g);
-		}
+			harvest.num_new_layers = temp_d;
+			harvest.num_pending = 0;
+			harvest_start = mem->used;
 
-		increment_bytes(ots_seed_g, params.n);
-		no_iterations++;
-
-		//If this iteration is a checkpoint or the attack succeeded then we record the current 
-		//runtime
-		if (no_iterations == num_sk_guesses[next_checkpoint_index] || has_succeeded) {
-			//Current runtime
-			temp_time = (clock() - attack_start_time) - uncounted_time;
+			// Verify the signature and harvest its WOTS instances in one hyper tree walk
+			if (xmssmt_core_sign_open_harvest(&params, mout, &mlen, sm, smlen, pk + XMSS_OID_LEN,
+			                                  &btable, harvest_layer, &harvest)) {
+				if (debug) {
+	  				printf("  X verification failed!\n");
+				}
+				mem->used = harvest_start;
+				continue;
+			}
+			if (debug) {
+				printf("    verification succeeded.\n");
+				printf("Q%d done\n",no_iterations);
+			}
 
-			// If attack succeeded, the runtime of all the remaining checkpoints is the current
-			// runtime
-			if (has_succeeded) {
-				for (int i = next_checkpoint_index; i < num_runtime_checkpoints; i++) {
-					attack_result->intermediate_runtimes[i] = temp_time;
+			//store the tuples in SCKTables keyed by (position, first component), or in the runs
+			if (ext_budget) {
+				for (i = 0; i < harvest.num_pending; i++) {
+					ext_join_check(ext_sorter_add(&ext_tuples, harvest.pending[i]));
 				}
-			//Otherwise, we only record the intermediate runtime at this iteration and move on
+				num_ext_tuples += harvest.num_pending;
+				mem->used = harvest_start;
 			} else {
-				attack_result->intermediate_runtimes[next_checkpoint_index] = temp_time;
-				next_checkpoint_index++;
+				for (i = 0; i < harvest.num_pending; i++) {
+					sck_table_insert(&SCKTables, harvest.pending[i]);
+				}
 			}
+	        }
+		if (debug) {
+			printf("\nQuery Phase Ends\n");
+		}
+		bitmask_table_free(&btable);
+		subtree_cache_free(&scache);
+
+		// The bitmask table is not thread-safe, so the workers get a context without one
+		hash_ctx_init(&params, &targets[t].hash, pub_seed);
+		targets[t].attack_result = &attack_results[t];
+		targets[t].query_time = (clock() - attack_start_time) - uncounted_time;
+		targets[t].next_checkpoint_index = 0;
+		atomic_init(&targets[t].success_guess, LONG_MAX);
+
+		// Memory usage is the arena space taken by the keypair's tuples and its share of the slots,
+		// or out of core the bytes of its tuples in the runs
+		if (ext_budget) {
+			attack_results[t].memory_usage = num_ext_tuples * ext_tuple_size;
+		} else {
+			attack_results[t].memory_usage = mem->used - tuples_start + slots_size / num_targets;
 		}
-	}
 
-	for(i=0;i<params.wots_len;i++)
-		free_tree(SCKTables[i]);
+		// Record number of checkpoints
+		attack_results[t].num_runtime_checkpoints = num_runtime_checkpoints;
+	}
 
-	// Memory usage is the size of 
-	attack_result->memory_usage =no_wots_nodes * (sizeof(bst)+params.n*2+32+params.wots_sig_bytes);
+	if (debug) {
+		printf("\nGuess Phase starts%s\n", ext_budget ? " (external sort-merge join)" :
+		                                     dict != NULL ? " (dictionary join)" : "");
+	}
 
-	// Record number of checkpoints
-	attack_result->num_runtime_checkpoints = num_runtime_checkpoints;
+	guess_phase gp;
+	guess_worker workers[num_threads];
+	pthread_t threads[num_threads];
+
+	gp.params = &params;
+	gp.table = ext_budget ? NULL : &SCKTables;
+	gp.targets = targets;
+	gp.num_targets = num_targets;
+	gp.num_sk_guesses = num_sk_guesses;
+	gp.num_runtime_checkpoints = num_runtime_checkpoints;
+	gp.next_guess = 0;
+	gp.done = 0;
+	gp.workers = workers;
+	gp.num_workers = num_threads;
+	pthread_mutex_init(&gp.lock, NULL);
+	gp.guess_start_time = clock();
+
+	// Worker 0 runs on the calling thread, so a single-threaded attack never spawns a thread
+	for (int w = 0; w < num_threads; w++) {
+		workers[w].gp = &gp;
+		workers[w].chunk_start = -1;
+	}
+	if (ext_budget) {
+		guess_phase_external(&gp, &ext_tuples, ext_budget);
+		ext_sorter_free(&ext_tuples);
+	} else if (dict != NULL) {
+		// The join is cheap next to expanding guesses, so it runs on the calling thread only
+		guess_phase_join(&gp, dict);
+	} else {
+		for (int w = 1; w < num_threads; w++) {
+			pthread_create(&threads[w], NULL, guess_worker_run, &workers[w]);
+		}
+		guess_worker_run(&workers[0]);
+		for (int w = 1; w < num_threads; w++) {
+			pthread_join(threads[w], NULL);
+		}
+	}
+	pthread_mutex_destroy(&gp.lock);
 
 	if (debug) {
-		printf("\t---ATTACK COMPLETE---\n");
-		printf("\tPrinting attack results:\n");
-		printf("\t\tNumber of checkpoints:\t%d\n", attack_result->num_runtime_checkpoints);
-		printf("\t\tIntermediate runtimes:\t%ld\n", attack_result->intermediate_runtimes[0]);
-		for (int i = 1; i < attack_result->num_runtime_checkpoints; i++) {
-			printf("\t\t\t\t\t%ld\n", attack_result->intermediate_runtimes[i]);
+		for (int t = 0; t < num_targets; t++) {
+			ISG_Attack_Result *attack_result = &attack_results[t];
+			printf("\t---ATTACK COMPLETE---\n");
+			printf("\tPrinting attack results:\n");
+			printf("\t\tNumber of checkpoints:\t%d\n", attack_result->num_runtime_checkpoints);
+			printf("\t\tIntermediate runtimes:\t%ld\n", attack_result->intermediate_runtimes[0]);
+			for (int i = 1; i < attack_result->num_runtime_checkpoints; i++) {
+				printf("\t\t\t\t\t%ld\n", attack_result->intermediate_runtimes[i]);
+			}
+			printf("\t\tSuccess guess (-1 indicates failure):\t%ld\n", attack_result->success_guess);
+			printf("\t\tMemory usage:\t%ld\n", attack_result->memory_usage);
 		}
-		printf("\t\tSuccess guess (-1 indicates failure):\t%ld\n", attack_result->success_guess);
-		printf("\t\tMemory usage:\t%ld\n", attack_result->memory_usage);
 	}
 
 	return;
 }
 
+void isg_attack_xmss(ISG_Attack_Result* attack_result, long que, long num_sk_guesses[],
+                  int num_runtime_checkpoints, int num_threads, const guess_dict *dict,
+                  size_t ext_budget, arena *mem, int debug) {
+	isg_attack_xmss_shared(attack_result, 1, que, num_sk_guesses, num_runtime_checkpoints,
+	                       num_threads, dict, ext_budget, mem, debug);
+}
+
 void isg_attack_test(ISG_Attack_Test_Result* test_result, long num_oracle_queries, long num_sk_guesses[], int num_runtime_checkpoints,
-                       int num_attack_iterations, int debug){
+                       int num_attack_iterations, int num_threads, int shared_guess_pass,
+                       const guess_dict *dict, size_t ext_budget, int debug){
 	//Set up K2SN-MSS implementation before it can be used
 	//Seed the random number generator
 	//(Note - srand is not cryptographically suitable, but for the purpose of this test it is 
@@ -440,8 +876,8 @@ void isg_attack_test(ISG_Attack_Test_Result* test_result, long num_oracle_querie
 	//Set value of global variable for secret ots key size
 	//chopped_key_size = reduced_sk_size;
 
-	//Ensure compiler does not optimize away pointer
-	ISG_Attack_Result single_attack_results;
+	//Results of every attack iteration
+	ISG_Attack_Result *attack_results = malloc(num_attack_iterations * sizeof(ISG_Attack_Result));
 	//Running runtimes at each checkpoint, number of successes before each checkpoint, and memory 
 	//usage
 	long long intermediate_runtime_sums[num_runtime_checkpoints];
@@ -453,28 +889,43 @@ void isg_attack_test(ISG_Attack_Test_Result* test_result, long num_oracle_querie
 		intermediate_success_sums[i] = 0;
 	}
 	long long memory_usage_sum = 0;
+	//One arena serves every attack iteration; it is reset in between instead of freed
+	arena mem;
+	arena_init(&mem);
+
+	//Invoke ISG Attack num_attack_iterations times, or once on num_attack_iterations keypairs
+	if (shared_guess_pass) {
+		isg_attack_xmss_shared(attack_results, num_attack_iterations, num_oracle_queries,
+		                       num_sk_guesses, num_runtime_checkpoints, num_threads, dict,
+		                       ext_budget, &mem, debug);
+	} else {
+		for (int i = 0; i < num_attack_iterations; i++) {
+			if (debug) {
+				printf("\n---START ATTACK No. %d---\n", i);
+			}
 
-	//Invoke ISG Attack num_attack_iterations times and keep running total of results
-	for (int i = 0; i < num_attack_iterations; i++) {
-		if (debug) {
-			printf("\n---START ATTACK No. %d---\n", i);
+			arena_reset(&mem);
+			isg_attack_xmss(&attack_results[i], num_oracle_queries, num_sk_guesses, 
+					     num_runtime_checkpoints, num_threads, dict, ext_budget, &mem, debug);
+			if (debug) {
+				printf("---END ATTACK No. %d---\n", i);
+			}
 		}
+	}
+	arena_free(&mem);
 
-		isg_attack_xmss(&single_attack_results, num_oracle_queries, num_sk_guesses, 
-				     num_runtime_checkpoints,debug);
-		if (debug) {
-			printf("---END ATTACK No. %d---\n", i);
-		}
-		//Add to running totals of results
-		for (int i = 0; i < num_runtime_checkpoints; i++) {
-			intermediate_runtime_sums[i] += single_attack_results.intermediate_runtimes[i];
-			if (single_attack_results.success_guess < num_sk_guesses[i] && 
-			      single_attack_results.success_guess >= 0) {
-				intermediate_success_sums[i]++;
+	//Keep running total of results
+	for (int i = 0; i < num_attack_iterations; i++) {
+		for (int j = 0; j < num_runtime_checkpoints; j++) {
+			intermediate_runtime_sums[j] += attack_results[i].intermediate_runtimes[j];
+			if (attack_results[i].success_guess < num_sk_guesses[j] && 
+			      attack_results[i].success_guess >= 0) {
+				intermediate_success_sums[j]++;
 			}
 		}
-		memory_usage_sum += single_attack_results.memory_usage;
-	} 
+		memory_usage_sum += attack_results[i].memory_usage;
+	}
+	free(attack_results);
 
 	//Calculate average runtimes, success probabilities, and memory usage
 	test_result->num_runtime_checkpoints = num_runtime_checkpoints;
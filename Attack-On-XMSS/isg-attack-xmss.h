@@ -6,6 +6,10 @@
 #include <gdsl.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "xmss.h"
 #include "params.h"
@@ -16,10 +20,23 @@
 #include "utils.h"
 #include "xmss_commons.h"
 #include "xmss_core.h"
+#include "guess_dict.h"
+#include "ext_sort.h"
 
 // Maximum number of checkpoints to record intermediate runtime of attack
 #define MAX_NUM_CHECKPOINTS 64
 
+// Number of consecutive guesses a Secret-Guessing phase worker claims at a time
+#define GUESS_CHUNK_SIZE 1024
+
+// log2 of the number of entries of the query phase's key and bitmask cache
+#define BITMASK_TABLE_LOG_ENTRIES 14
+
+// Default number of Secret-Guessing phase worker threads
+#ifndef ISG_NUM_THREADS
+    #define ISG_NUM_THREADS 1
+#endif
+
 #define XMSS_MLEN 32
     #define XMSS_PARSE_OID xmssmt_parse_oid
     #define XMSS_STR_TO_OID xmssmt_str_to_oid
@@ -60,43 +77,189 @@ typedef struct {
     long double average_memory_usage;
 } ISG_Attack_Test_Result;
 
-// Secret component key table. Essentially an array of length \ell of binary search trees. The i^th
-// tree contains an ordered set of tuples. The first element of the tuple is the i^th secret 
-// component key of a wots instance. The next element is another secret component key of the same
-// wots instance. The remaining elements contain enough information to determine: 1. the location of
-// the wots instance in the hyper tree, and 2. the index of the other secret component key. The 
-// tuple is keyed by the value of the i^th secret component key.
-// Feel free to modify, add or remove elements, or to remove or replace this struct altogether
-//typedef struct SCKTables {
-//
-//} SCKTable;
-
-// A tuple in the secret component key table. The first element of the tuple is the i^th secret 
-// component key of a wots instance. The next element is another secret component key of the same
-// wots instance. The remaining elements contain enough information to determine: 1. the location of
-// the wots instance in the hyper tree, and 2. the index of the other secret component key. The 
-// tuple is keyed by the value of the i^th secret component key.
+// Bump allocator backing every allocation of an attack: the oracle query buffers, the slots of the
+// secret component key table and the harvested tuples. Allocations are never freed one by one;
+// arena_reset() releases all of them at once and keeps the memory for the next attack.
+typedef struct {
+	unsigned char *base;
+	size_t capacity;
+	size_t used;
+} arena;
+
+// Number of leading bytes of a WOTS instance's L-tree leaf kept in its tuple. A forged signature
+// is accepted if the leaf computed from it agrees on these bytes.
+#define SCK_LEAF_BYTES 16
+
+// A tuple in the secret component key table, describing one harvested wots instance. The tuple is
+// keyed by (position, value of the position^th secret component key), of which only the 64-bit
+// fingerprint is kept. wots_sec_comp2 is the index^th secret component key of the same instance,
+// stored inline (params->n bytes). target is the index of the attacked keypair the instance belongs
+// to, ots_addr locates the instance in that keypair's hyper tree, and leaf holds the first
+// SCK_LEAF_BYTES bytes of its L-tree leaf. Tuples with equal keys are chained through next.
 // Feel free to modify, add or remove elements, or to remove or replace this struct altogether
-typedef struct bst{
-	unsigned char *wots_sec_comp1;
-    	unsigned char *wots_sec_comp2;
+typedef struct sck_tuple{
+	uint64_t fingerprint;
+	struct sck_tuple *next;
+	int position;
 	int index;
+	int target;
 	uint32_t ots_addr[8];
-	unsigned char *ots_pk;
+	unsigned char leaf[SCK_LEAF_BYTES];
+	unsigned char wots_sec_comp2[];
+}sck_tuple;
+
+// A slot of the secret component key table. fingerprint is 0 if the slot is empty.
+typedef struct {
+	uint64_t fingerprint;
+	sck_tuple *tuple;
+} sck_slot;
+
+// Secret component key table. A single open-addressed hash table (linear probing) holding every
+// harvested tuple, keyed by (position, secret component key). Each slot stores the 64-bit
+// fingerprint of the key next to the tuple pointer, so a probe usually touches one cache line and
+// only dereferences the tuple to confirm the position once the fingerprint matches. The table is
+// sized up front from the number of oracle queries and is never resized.
+typedef struct SCKTable {
+	sck_slot *slots;
+	unsigned long long mask;
+	unsigned long long num_tuples;
+} SCKTable;
+
+// Harvest of one oracle query, filled in by the verification callback. pending has room for one tuple
+// per hyper tree layer; only the num_new_layers lowest layers are harvested.
+typedef struct {
+	arena *mem;
+	int target;
+	unsigned int num_new_layers;
+	sck_tuple **pending;
+	unsigned int num_pending;
+} query_harvest;
+
+// A keypair attacked by the Secret-Guessing phase. hash is keyed with the keypair's pub_seed and
+// query_time is the counted runtime of its query phase, which every checkpoint runtime of the
+// keypair includes. success_guess is the smallest guess index known to forge for the keypair.
+typedef struct {
+	hash_ctx hash;
+	ISG_Attack_Result *attack_result;
+	clock_t query_time;
+
+	// Protected by the lock of the guess phase, except success_guess
+	int next_checkpoint_index;
+	atomic_long success_guess;
+} attack_target;
+
+struct guess_phase;
+
+// A Secret-Guessing phase worker. chunk_start is the first guess index of the chunk the worker is
+// currently trying, or -1 if it is between chunks.
+typedef struct {
+	struct guess_phase *gp;
+	long chunk_start;
+} guess_worker;
 
-	struct bst *left;
-	struct bst *right;
-	struct bst *next;
-}bst;
+// Shared state of the Secret-Guessing phase. Chunks of consecutive guesses are handed out to the
+// workers in increasing order, so idle workers always pick up the lowest untried guesses and the
+// tried guesses form a prefix of the guess space up to the chunks still in flight. Checkpoint
+// runtimes are recorded as that prefix grows, so they are reported in guess-index order regardless
+// of the number of workers. The guessed secret component keys do not depend on the keypair, so
+// every guess is expanded once and probed against the tuples of all targets, which share table.
+// A guess is only tried for the targets whose success_guess lies above it; workers stop once no
+// target is left.
+typedef struct guess_phase {
+	const xmss_params *params;
+	const SCKTable *table;
+	attack_target *targets;
+	int num_targets;
+	const long *num_sk_guesses;
+	int num_runtime_checkpoints;
+	clock_t guess_start_time;
+
+	// Everything below is protected by lock
+	pthread_mutex_t lock;
+	guess_worker *workers;
+	int num_workers;
+	long next_guess;
+	int done;
+} guess_phase;
+
+// A guess whose secret component key at the tuple's position has the fingerprint of the tuple's key,
+// found by the dictionary or the out-of-core join of the Secret-Guessing phase
+typedef struct {
+	long guess;
+	sck_tuple *tuple;
+} guess_candidate;
+
+// A record of the guess side of the out-of-core join: the fingerprint of the position^th secret
+// component key expand_seed() derives from the guess-th guess. The tuple side is made of sck_tuple
+// records, which also start with their fingerprint. guess is 64 bits wide so that guess indices past
+// 2^32 do not wrap when seeds are chopped to more than 4 bytes.
+typedef struct {
+	uint64_t fingerprint;
+	uint64_t guess;
+	uint32_t position;
+} guess_record;
 
 int increment_bytes(u8 *bytes, int num_bytes);
 
+void guess_to_bytes(u8 *bytes, int num_bytes, long guess);
+
+void *guess_worker_run(void *arg);
+
+void arena_init(arena *mem);
+
+void arena_reserve(arena *mem, size_t capacity);
+
+void *arena_alloc(arena *mem, size_t bytes);
+
+void arena_reset(arena *mem);
+
+void arena_free(arena *mem);
+
+size_t arena_size(size_t bytes);
+
+unsigned long long sck_table_capacity(unsigned long long max_tuples);
+
+void sck_table_init(SCKTable *table, unsigned long long max_tuples, arena *mem);
+
+void sck_table_insert(SCKTable *table, sck_tuple *tuple);
+
+uint64_t sck_fingerprint(unsigned int position, const unsigned char *wots_sec_comp);
+
+sck_tuple *sck_table_find(const SCKTable *table, unsigned int position,
+                          const unsigned char *wots_sec_comp);
+
+// num_threads is the number of Secret-Guessing phase worker threads. The query phase always runs
+// on the calling thread. All allocations of the attack come from mem, which must be empty; they stay
+// valid until mem is reset. If dict is not NULL, the Secret-Guessing phase is a join of the
+// harvested tuples against it on the calling thread, instead of expanding every guess; the
+// dictionary is shared precomputation and is not counted in the memory usage.
+// If ext_budget is not 0, the attack runs out of core in about ext_budget bytes of memory: the
+// harvested tuples are sorted into runs on disk instead of a table, and the Secret-Guessing phase
+// is a sort-merge join of them against the sorted secret component keys of the guesses, on the
+// calling thread. dict must then be NULL, and the memory usage is the bytes of the tuples on disk.
+// The budget covers the run buffers of the sorts and merges only; the candidates a join finds and
+// the copies of their matched tuples are allocated on top of it, which is small as long as few
+// keys match.
 void isg_attack_xmss(ISG_Attack_Result* attack_result, long num_oracle_queries, long num_sk_guesses[],
-                  int num_runtime_checkpoints, int debug);
+                  int num_runtime_checkpoints, int num_threads, const guess_dict *dict,
+                  size_t ext_budget, arena *mem, int debug);
+
+// Attacks num_targets fresh keypairs at once: each gets its own query phase, harvesting into one
+// table, and a single Secret-Guessing phase enumerates every guess once for all of them. The
+// results of the i-th keypair are stored in attack_results[i]; their checkpoint runtimes add the
+// keypair's own query phase to the shared guessing time, and their memory usage is the keypair's
+// tuples plus its share of the table's slots. isg_attack_xmss() is the case of one keypair.
+void isg_attack_xmss_shared(ISG_Attack_Result attack_results[], int num_targets,
+                  long num_oracle_queries, long num_sk_guesses[], int num_runtime_checkpoints,
+                  int num_threads, const guess_dict *dict, size_t ext_budget, arena *mem, int debug);
 
+// If shared_guess_pass is set, the num_attack_iterations keypairs are attacked by a single call of
+// isg_attack_xmss_shared() instead of one isg_attack_xmss() each. dict and ext_budget are as for
+// isg_attack_xmss().
 void isg_attack_test(ISG_Attack_Test_Result* test_result,
                        long num_oracle_queries, long num_sk_guesses[], int num_runtime_checkpoints,
-                       int num_attack_iterations, int debug);
+                       int num_attack_iterations, int num_threads, int shared_guess_pass,
+                       const guess_dict *dict, size_t ext_budget, int debug);
 
 //ISGAttackResult isg_attack_xmss(unsigned int que, unsigned int gue);
 
@@ -0,0 +1,380 @@
+/* Multi-buffer SHA-256 and SHA-512 following FIPS 180-4.
+ *
+ * The compression functions are written against GCC vector types; lane j of
+ * every vector belongs to message j. They are instantiated for AVX2 and for
+ * AVX-512, which adds native rotates and holds all 8 SHA-512 lanes in one
+ * register, and the AVX-512 instance is used when the CPU supports it. */
+
+#include <string.h>
+
+#include "sha2x8.h"
+
+typedef uint32_t u32x8 __attribute__((vector_size(32)));
+typedef uint64_t u64x4 __attribute__((vector_size(32)));
+typedef uint64_t u64x8 __attribute__((vector_size(64)));
+
+#define ROR(x, c, bits) (((x) >> (c)) | ((x) << ((bits) - (c))))
+
+static const uint32_t sha256_iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static const uint64_t sha512_iv[8] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+    0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+    0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+static const uint32_t K256[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint64_t K512[80] = {
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL,
+    0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+    0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL,
+    0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
+    0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+    0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL, 0x2de92c6f592b0275ULL,
+    0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL,
+    0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+    0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL,
+    0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL,
+    0x92722c851482353bULL, 0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+    0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
+    0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL,
+    0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+    0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL,
+    0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL,
+    0xc67178f2e372532bULL, 0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+    0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL,
+    0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
+    0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+    0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+static uint32_t load_bigendian_32(const unsigned char *x)
+{
+    return (uint32_t)x[3] | ((uint32_t)x[2] << 8) |
+           ((uint32_t)x[1] << 16) | ((uint32_t)x[0] << 24);
+}
+
+static uint64_t load_bigendian_64(const unsigned char *x)
+{
+    return (uint64_t)load_bigendian_32(x + 4) |
+           ((uint64_t)load_bigendian_32(x) << 32);
+}
+
+static void store_bigendian_32(unsigned char *x, uint32_t u)
+{
+    x[3] = (unsigned char)u;
+    x[2] = (unsigned char)(u >> 8);
+    x[1] = (unsigned char)(u >> 16);
+    x[0] = (unsigned char)(u >> 24);
+}
+
+static void store_bigendian_64(unsigned char *x, uint64_t u)
+{
+    store_bigendian_32(x, (uint32_t)(u >> 32));
+    store_bigendian_32(x + 4, (uint32_t)u);
+}
+
+static inline __attribute__((always_inline))
+void sha256x8_compress(u32x8 s[8], const unsigned char *in[8],
+                       unsigned long long nblocks)
+{
+    u32x8 w[16];
+    u32x8 a, b, c, d, e, f, g, h, s0, s1, t1, t2;
+    unsigned long long blk;
+    unsigned int t, j;
+
+    for (blk = 0; blk < nblocks; blk++) {
+        for (t = 0; t < 16; t++) {
+            for (j = 0; j < 8; j++) {
+                w[t][j] = load_bigendian_32(in[j] + blk*SHA256_BLOCK_BYTES + 4*t);
+            }
+        }
+        a = s[0]; b = s[1]; c = s[2]; d = s[3];
+        e = s[4]; f = s[5]; g = s[6]; h = s[7];
+
+        for (t = 0; t < 64; t++) {
+            if (t >= 16) {
+                s0 = w[(t + 1) & 15];
+                s0 = ROR(s0, 7, 32) ^ ROR(s0, 18, 32) ^ (s0 >> 3);
+                s1 = w[(t + 14) & 15];
+                s1 = ROR(s1, 17, 32) ^ ROR(s1, 19, 32) ^ (s1 >> 10);
+                w[t & 15] += s0 + w[(t + 9) & 15] + s1;
+            }
+            t1 = h + (ROR(e, 6, 32) ^ ROR(e, 11, 32) ^ ROR(e, 25, 32))
+                   + ((e & f) ^ (~e & g)) + K256[t] + w[t & 15];
+            t2 = (ROR(a, 2, 32) ^ ROR(a, 13, 32) ^ ROR(a, 22, 32))
+                   + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        s[0] += a; s[1] += b; s[2] += c; s[3] += d;
+        s[4] += e; s[5] += f; s[6] += g; s[7] += h;
+    }
+}
+
+static inline __attribute__((always_inline))
+void sha512x8_compress(u64x8 s[8], const unsigned char *in[8],
+                       unsigned long long nblocks)
+{
+    u64x8 w[16];
+    u64x8 a, b, c, d, e, f, g, h, s0, s1, t1, t2;
+    unsigned long long blk;
+    unsigned int t, j;
+
+    for (blk = 0; blk < nblocks; blk++) {
+        for (t = 0; t < 16; t++) {
+            for (j = 0; j < 8; j++) {
+                w[t][j] = load_bigendian_64(in[j] + blk*SHA512_BLOCK_BYTES + 8*t);
+            }
+        }
+        a = s[0]; b = s[1]; c = s[2]; d = s[3];
+        e = s[4]; f = s[5]; g = s[6]; h = s[7];
+
+        for (t = 0; t < 80; t++) {
+            if (t >= 16) {
+                s0 = w[(t + 1) & 15];
+                s0 = ROR(s0, 1, 64) ^ ROR(s0, 8, 64) ^ (s0 >> 7);
+                s1 = w[(t + 14) & 15];
+                s1 = ROR(s1, 19, 64) ^ ROR(s1, 61, 64) ^ (s1 >> 6);
+                w[t & 15] += s0 + w[(t + 9) & 15] + s1;
+            }
+            t1 = h + (ROR(e, 14, 64) ^ ROR(e, 18, 64) ^ ROR(e, 41, 64))
+                   + ((e & f) ^ (~e & g)) + K512[t] + w[t & 15];
+            t2 = (ROR(a, 28, 64) ^ ROR(a, 34, 64) ^ ROR(a, 39, 64))
+                   + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        s[0] += a; s[1] += b; s[2] += c; s[3] += d;
+        s[4] += e; s[5] += f; s[6] += g; s[7] += h;
+    }
+}
+
+static inline __attribute__((always_inline))
+void sha512x4_compress(u64x4 s[8], const unsigned char *in[4],
+                       unsigned long long nblocks)
+{
+    u64x4 w[16];
+    u64x4 a, b, c, d, e, f, g, h, s0, s1, t1, t2;
+    unsigned long long blk;
+    unsigned int t, j;
+
+    for (blk = 0; blk < nblocks; blk++) {
+        for (t = 0; t < 16; t++) {
+            for (j = 0; j < 4; j++) {
+                w[t][j] = load_bigendian_64(in[j] + blk*SHA512_BLOCK_BYTES + 8*t);
+            }
+        }
+        a = s[0]; b = s[1]; c = s[2]; d = s[3];
+        e = s[4]; f = s[5]; g = s[6]; h = s[7];
+
+        for (t = 0; t < 80; t++) {
+            if (t >= 16) {
+                s0 = w[(t + 1) & 15];
+                s0 = ROR(s0, 1, 64) ^ ROR(s0, 8, 64) ^ (s0 >> 7);
+                s1 = w[(t + 14) & 15];
+                s1 = ROR(s1, 19, 64) ^ ROR(s1, 61, 64) ^ (s1 >> 6);
+                w[t & 15] += s0 + w[(t + 9) & 15] + s1;
+            }
+            t1 = h + (ROR(e, 14, 64) ^ ROR(e, 18, 64) ^ ROR(e, 41, 64))
+                   + ((e & f) ^ (~e & g)) + K512[t] + w[t & 15];
+            t2 = (ROR(a, 28, 64) ^ ROR(a, 34, 64) ^ ROR(a, 39, 64))
+                   + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        s[0] += a; s[1] += b; s[2] += c; s[3] += d;
+        s[4] += e; s[5] += f; s[6] += g; s[7] += h;
+    }
+}
+
+__attribute__((target("avx2")))
+static void sha256x8_blocks_avx2(u32x8 s[8], const unsigned char *in[8],
+                                 unsigned long long nblocks)
+{
+    sha256x8_compress(s, in, nblocks);
+}
+
+__attribute__((target("avx512f,avx512vl")))
+static void sha256x8_blocks_avx512(u32x8 s[8], const unsigned char *in[8],
+                                   unsigned long long nblocks)
+{
+    sha256x8_compress(s, in, nblocks);
+}
+
+/* Under AVX2 the 8 SHA-512 lanes do not fit in the register file at once, so
+   they are hashed as two groups of 4. */
+__attribute__((target("avx2")))
+static void sha512x8_blocks_avx2(u64x8 s[8], const unsigned char *in[8],
+                                 unsigned long long nblocks)
+{
+    u64x4 half[8];
+    unsigned int i, j, k;
+
+    for (k = 0; k < 8; k += 4) {
+        for (i = 0; i < 8; i++) {
+            for (j = 0; j < 4; j++) {
+                half[i][j] = s[i][k + j];
+            }
+        }
+        sha512x4_compress(half, in + k, nblocks);
+        for (i = 0; i < 8; i++) {
+            for (j = 0; j < 4; j++) {
+                s[i][k + j] = half[i][j];
+            }
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+static void sha512x8_blocks_avx512(u64x8 s[8], const unsigned char *in[8],
+                                   unsigned long long nblocks)
+{
+    sha512x8_compress(s, in, nblocks);
+}
+
+static void sha256x8_blocks(u32x8 s[8], const unsigned char *in[8],
+                            unsigned long long nblocks)
+{
+    if (__builtin_cpu_supports("avx512vl")) {
+        sha256x8_blocks_avx512(s, in, nblocks);
+    }
+    else {
+        sha256x8_blocks_avx2(s, in, nblocks);
+    }
+}
+
+static void sha512x8_blocks(u64x8 s[8], const unsigned char *in[8],
+                            unsigned long long nblocks)
+{
+    if (__builtin_cpu_supports("avx512f")) {
+        sha512x8_blocks_avx512(s, in, nblocks);
+    }
+    else {
+        sha512x8_blocks_avx2(s, in, nblocks);
+    }
+}
+
+void sha256x8_from_state(unsigned char *out[8],
+                         const uint32_t state[8], unsigned long long offset,
+                         const unsigned char *in[8], unsigned long long inlen)
+{
+    unsigned long long full_blocks = inlen / SHA256_BLOCK_BYTES;
+    unsigned int rem = inlen % SHA256_BLOCK_BYTES;
+    /* The padding adds 0x80 and an 8-byte bit length. */
+    unsigned int tail_blocks = rem + 9 > SHA256_BLOCK_BYTES ? 2 : 1;
+    unsigned char tail[8][2 * SHA256_BLOCK_BYTES];
+    const unsigned char *ptr[8];
+    u32x8 s[8];
+    unsigned int i, j;
+
+    for (i = 0; i < 8; i++) {
+        for (j = 0; j < 8; j++) {
+            s[i][j] = state[i];
+        }
+    }
+
+    if (full_blocks > 0) {
+        sha256x8_blocks(s, in, full_blocks);
+    }
+
+    for (j = 0; j < 8; j++) {
+        memset(tail[j], 0, sizeof(tail[j]));
+        memcpy(tail[j], in[j] + full_blocks*SHA256_BLOCK_BYTES, rem);
+        tail[j][rem] = 0x80;
+        store_bigendian_64(tail[j] + tail_blocks*SHA256_BLOCK_BYTES - 8,
+                           (offset + inlen) * 8);
+        ptr[j] = tail[j];
+    }
+    sha256x8_blocks(s, ptr, tail_blocks);
+
+    for (j = 0; j < 8; j++) {
+        for (i = 0; i < 8; i++) {
+            store_bigendian_32(out[j] + 4*i, s[i][j]);
+        }
+    }
+}
+
+void sha512x8_from_state(unsigned char *out[8],
+                         const uint64_t state[8], unsigned long long offset,
+                         const unsigned char *in[8], unsigned long long inlen)
+{
+    unsigned long long full_blocks = inlen / SHA512_BLOCK_BYTES;
+    unsigned int rem = inlen % SHA512_BLOCK_BYTES;
+    /* The padding adds 0x80 and a 16-byte bit length. */
+    unsigned int tail_blocks = rem + 17 > SHA512_BLOCK_BYTES ? 2 : 1;
+    unsigned char tail[8][2 * SHA512_BLOCK_BYTES];
+    const unsigned char *ptr[8];
+    u64x8 s[8];
+    unsigned int i, j;
+
+    for (i = 0; i < 8; i++) {
+        for (j = 0; j < 8; j++) {
+            s[i][j] = state[i];
+        }
+    }
+
+    if (full_blocks > 0) {
+        sha512x8_blocks(s, in, full_blocks);
+    }
+
+    for (j = 0; j < 8; j++) {
+        memset(tail[j], 0, sizeof(tail[j]));
+        memcpy(tail[j], in[j] + full_blocks*SHA512_BLOCK_BYTES, rem);
+        tail[j][rem] = 0x80;
+        /* Messages are far shorter than 2^64 bits; the high half stays 0. */
+        store_bigendian_64(tail[j] + tail_blocks*SHA512_BLOCK_BYTES - 8,
+                           (offset + inlen) * 8);
+        ptr[j] = tail[j];
+    }
+    sha512x8_blocks(s, ptr, tail_blocks);
+
+    for (j = 0; j < 8; j++) {
+        for (i = 0; i < 8; i++) {
+            store_bigendian_64(out[j] + 8*i, s[i][j]);
+        }
+    }
+}
+
+void sha256x8(unsigned char *out[8],
+              const unsigned char *in[8], unsigned long long inlen)
+{
+    sha256x8_from_state(out, sha256_iv, 0, in, inlen);
+}
+
+void sha512x8(unsigned char *out[8],
+              const unsigned char *in[8], unsigned long long inlen)
+{
+    sha512x8_from_state(out, sha512_iv, 0, in, inlen);
+}
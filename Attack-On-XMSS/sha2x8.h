@@ -0,0 +1,42 @@
+#ifndef XMSS_SHA2X8_H
+#define XMSS_SHA2X8_H
+
+#include <stdint.h>
+
+#define SHA256_BLOCK_BYTES 64
+#define SHA512_BLOCK_BYTES 128
+
+/* Multi-buffer SHA-2. Every function hashes 8 independent messages of the
+ * same length at once, one per vector lane. The compression function is
+ * compiled for AVX2 and for AVX-512; the widest one the CPU supports is
+ * picked at run time (SHA-512 then fills a single 512-bit register).
+ */
+
+/* Evaluates SHA-256 on the `inlen' bytes in each of `in[0..7]'.
+ * Writes the 32-byte digests to `out[0..7]'.
+ */
+void sha256x8(unsigned char *out[8],
+              const unsigned char *in[8], unsigned long long inlen);
+
+/* Evaluates SHA-512 on the `inlen' bytes in each of `in[0..7]'.
+ * Writes the 64-byte digests to `out[0..7]'.
+ */
+void sha512x8(unsigned char *out[8],
+              const unsigned char *in[8], unsigned long long inlen);
+
+/* As sha256x8, but all 8 messages start with the same `offset' bytes that
+ * have already been compressed into `state'; only the remaining `inlen'
+ * bytes are passed. offset must be a multiple of SHA256_BLOCK_BYTES.
+ */
+void sha256x8_from_state(unsigned char *out[8],
+                         const uint32_t state[8], unsigned long long offset,
+                         const unsigned char *in[8], unsigned long long inlen);
+
+/* As sha512x8, continuing from `state' after `offset' bytes. offset must be
+ * a multiple of SHA512_BLOCK_BYTES.
+ */
+void sha512x8_from_state(unsigned char *out[8],
+                         const uint64_t state[8], unsigned long long offset,
+                         const unsigned char *in[8], unsigned long long inlen);
+
+#endif
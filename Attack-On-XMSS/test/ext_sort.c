@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../ext_sort.h"
+
+/* A budget of a few records, so that many runs are written and merged in several passes. */
+#define BUDGET (5 * sizeof(test_record))
+#define NRECORDS 10000
+
+typedef struct {
+    uint64_t key;
+    uint64_t index;
+} test_record;
+
+int main()
+{
+    ext_sorter sorter;
+    ext_merge merge;
+    test_record record;
+    const test_record *r;
+    unsigned char *seen;
+    uint64_t i, count = 0, last_key = 0;
+    int ret = 0;
+
+    fprintf(stderr, "Testing if the external sort returns every record in key order.. ");
+
+    seen = calloc(NRECORDS, 1);
+    if (ext_sorter_init(&sorter, sizeof(test_record), BUDGET) < 0) {
+        fprintf(stderr, "could not start the sort!\n");
+        return -1;
+    }
+    for (i = 0; i < NRECORDS; i++) {
+        /* Few distinct keys, so that equal keys meet in every merge. */
+        record.key = ((uint64_t)rand() << 32 | rand()) % 1000;
+        record.index = i;
+        if (ext_sorter_add(&sorter, &record) < 0) {
+            fprintf(stderr, "could not add record %llu!\n", (unsigned long long)i);
+            ext_sorter_free(&sorter);
+            return -1;
+        }
+    }
+    if (ext_sorter_finish(&sorter, BUDGET) < 0 || ext_merge_open(&merge, &sorter, BUDGET) < 0) {
+        fprintf(stderr, "could not merge the runs!\n");
+        ext_sorter_free(&sorter);
+        return -1;
+    }
+
+    while ((r = ext_merge_peek(&merge)) != NULL && !ret) {
+        if (r->key < last_key || r->index >= NRECORDS || seen[r->index]) {
+            fprintf(stderr, "record %llu is out of place!\n", (unsigned long long)count);
+            ret = -1;
+        }
+        else {
+            seen[r->index] = 1;
+            last_key = r->key;
+            count++;
+        }
+        if (ext_merge_next(&merge) < 0) {
+            fprintf(stderr, "could not read record %llu!\n", (unsigned long long)count);
+            ret = -1;
+        }
+    }
+    if (!ret && count != NRECORDS) {
+        fprintf(stderr, "%llu of %d records returned!\n", (unsigned long long)count, NRECORDS);
+        ret = -1;
+    }
+
+    ext_merge_close(&merge);
+    ext_sorter_free(&sorter);
+    free(seen);
+
+    if (!ret) {
+        fprintf(stderr, "OK!\n");
+    }
+    return ret;
+}
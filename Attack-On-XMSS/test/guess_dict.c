@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../isg-attack-xmss.h"
+
+/* Several shards, so that the streaming build and the shard offsets are exercised. */
+#define LOG_GUESSES_PER_SHARD (8*XMSS_CHOP_BYTES - 2)
+#define NGUESSES 200
+
+int main()
+{
+    xmss_params params;
+    char *oidstr = "XMSSMT-SHA2_20/4_256";
+    char path[] = "/tmp/guess_dict_XXXXXX";
+    guess_dict dict;
+    uint32_t oid;
+    uint64_t s, k, shard, fp;
+    unsigned int i, j;
+    int fd, found, ret = 0;
+    FILE *f;
+
+    fprintf(stderr, "Testing if the guess dictionary finds every guess of %s.. ", oidstr);
+
+    xmssmt_str_to_oid(&oid, oidstr);
+    xmssmt_parse_oid(&params, oid);
+
+    unsigned char seed[params.n];
+    unsigned char comps[params.wots_sig_bytes];
+
+    fd = mkstemp(path);
+    if (fd < 0 || (f = fdopen(fd, "wb")) == NULL) {
+        perror(path);
+        return -1;
+    }
+    if (guess_dict_write(f, &params, XMSS_CHOP_BYTES, LOG_GUESSES_PER_SHARD, NULL) < 0 ||
+        fclose(f) != 0 || guess_dict_open(&dict, path, &params) < 0) {
+        fprintf(stderr, "could not write and open %s!\n", path);
+        unlink(path);
+        return -1;
+    }
+
+    for (s = 0; s < dict.header->num_shards && !ret; s++) {
+        const uint64_t *fingerprints = guess_dict_fingerprints(&dict, s);
+        const uint32_t *guesses = guess_dict_guesses(&dict, s);
+
+        for (k = 0; k < dict.shard_entries && !ret; k++) {
+            if ((k > 0 && fingerprints[k-1] > fingerprints[k]) ||
+                guesses[k] >> LOG_GUESSES_PER_SHARD != s) {
+                fprintf(stderr, "shard %llu entry %llu is out of place!\n",
+                        (unsigned long long)s, (unsigned long long)k);
+                ret = -1;
+            }
+        }
+    }
+
+    /* Every secret component key of a random guess leads back to the guess. */
+    for (i = 0; i < NGUESSES && !ret; i++) {
+        long guess = rand() % dict.header->num_guesses;
+
+        guess_to_bytes(seed, params.n, guess);
+        expand_seed(&params, comps, seed);
+        shard = guess >> LOG_GUESSES_PER_SHARD;
+        for (j = 0; j < params.wots_len && !ret; j++) {
+            const uint64_t *fingerprints = guess_dict_fingerprints(&dict, shard);
+            const uint32_t *guesses = guess_dict_guesses(&dict, shard);
+
+            fp = sck_fingerprint(j, comps + j*params.n);
+            found = 0;
+            for (k = guess_dict_lower_bound(&dict, shard, fp);
+                 k < dict.shard_entries && fingerprints[k] == fp; k++) {
+                found |= guesses[k] == guess;
+            }
+            if (!found) {
+                fprintf(stderr, "guess %ld position %u not found!\n", guess, j);
+                ret = -1;
+            }
+        }
+    }
+
+    guess_dict_close(&dict);
+    unlink(path);
+
+    if (!ret) {
+        fprintf(stderr, "OK!\n");
+    }
+    return ret;
+}
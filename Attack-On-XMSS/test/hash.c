@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../hash.h"
+#include "../hash_address.h"
+#include "../randombytes.h"
+#include "../params.h"
+
+/* One parameter set for each of SHA2-256, SHA2-512, SHAKE-128 and SHAKE-256. */
+static const char *variants[] = {
+    "XMSS-SHA2_10_256", "XMSS-SHA2_10_512",
+    "XMSS-SHAKE_10_256", "XMSS-SHAKE_10_512",
+};
+
+static int test_prf_keyed(const xmss_params *params)
+{
+    unsigned char key[params->n];
+    unsigned char in[32];
+    unsigned char out1[params->n];
+    unsigned char out2[params->n];
+    prf_ctx ctx;
+    int i;
+
+    randombytes(key, params->n);
+    prf_keyed_init(params, &ctx, key);
+
+    for (i = 0; i < 16; i++) {
+        randombytes(in, 32);
+        prf(params, out1, in, key);
+        prf_keyed(params, out2, in, &ctx);
+        if (memcmp(out1, out2, params->n)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Hashes a few addresses repeatedly through a small bitmask table, so that
+ * both hits and evictions are exercised. */
+static int test_thash_ctx(const xmss_params *params)
+{
+    unsigned char pub_seed[params->n];
+    unsigned char in[2 * params->n];
+    unsigned char out1[params->n];
+    unsigned char out2[params->n];
+    uint32_t addr1[8] = {0};
+    uint32_t addr2[8] = {0};
+    bitmask_table table;
+    hash_ctx ctx;
+    int i;
+
+    randombytes(pub_seed, params->n);
+    hash_ctx_init(params, &ctx, pub_seed);
+    bitmask_table_init(params, &table, 2, 0);
+    ctx.table = &table;
+
+    for (i = 0; i < 64; i++) {
+        randombytes(in, 2 * params->n);
+        set_layer_addr(addr1, i % 3);
+        set_tree_addr(addr1, i % 5);
+        set_type(addr1, i % 3);
+        set_ots_addr(addr1, i % 7);
+        set_chain_addr(addr1, i % 2);
+        memcpy(addr2, addr1, sizeof(addr1));
+
+        thash_f(params, out1, in, pub_seed, addr1);
+        thash_f_ctx(params, out2, in, &ctx, addr2);
+        if (memcmp(out1, out2, params->n) || memcmp(addr1, addr2, sizeof(addr1))) {
+            bitmask_table_free(&table);
+            return -1;
+        }
+        thash_h(params, out1, in, pub_seed, addr1);
+        thash_h_ctx(params, out2, in, &ctx, addr2);
+        if (memcmp(out1, out2, params->n) || memcmp(addr1, addr2, sizeof(addr1))) {
+            bitmask_table_free(&table);
+            return -1;
+        }
+    }
+    bitmask_table_free(&table);
+    return 0;
+}
+
+/* Compares every lane of the batched thash against thash, with and without a
+ * bitmask table. Layer 1 addresses go through the table, layer 0 ones do not. */
+static int test_thash_x8(const xmss_params *params)
+{
+    unsigned char pub_seed[params->n];
+    unsigned char in[8][2 * params->n];
+    unsigned char out[8][params->n];
+    unsigned char expected[params->n];
+    const unsigned char *inp[8];
+    unsigned char *outp[8];
+    uint32_t addr[8][8];
+    uint32_t lane_addr[8][8];
+    bitmask_table table;
+    hash_ctx ctx;
+    int i, j, ret = 0;
+
+    randombytes(pub_seed, params->n);
+    hash_ctx_init(params, &ctx, pub_seed);
+    bitmask_table_init(params, &table, 2, 1);
+
+    for (i = 0; i < 8 && !ret; i++) {
+        ctx.table = i & 2 ? &table : NULL;
+        for (j = 0; j < 8; j++) {
+            randombytes(in[j], 2 * params->n);
+            memset(addr[j], 0, sizeof(addr[j]));
+            set_layer_addr(addr[j], i & 1);
+            set_tree_addr(addr[j], i);
+            set_ots_addr(addr[j], j);
+            set_chain_addr(addr[j], i + j);
+            inp[j] = in[j];
+            outp[j] = out[j];
+        }
+
+        memcpy(lane_addr, addr, sizeof(addr));
+        thash_f_x8(params, outp, inp, &ctx, lane_addr);
+        for (j = 0; j < 8; j++) {
+            thash_f(params, expected, in[j], pub_seed, addr[j]);
+            if (memcmp(out[j], expected, params->n) ||
+                memcmp(lane_addr[j], addr[j], sizeof(addr[j]))) {
+                ret = -1;
+            }
+        }
+
+        memcpy(lane_addr, addr, sizeof(addr));
+        thash_h_x8(params, outp, inp, &ctx, lane_addr);
+        for (j = 0; j < 8; j++) {
+            thash_h(params, expected, in[j], pub_seed, addr[j]);
+            if (memcmp(out[j], expected, params->n) ||
+                memcmp(lane_addr[j], addr[j], sizeof(addr[j]))) {
+                ret = -1;
+            }
+        }
+    }
+    bitmask_table_free(&table);
+    return ret;
+}
+
+int main()
+{
+    xmss_params params;
+    uint32_t oid;
+    unsigned int i;
+    int ret = 0;
+
+    for (i = 0; i < sizeof(variants) / sizeof(variants[0]); i++) {
+        xmss_str_to_oid(&oid, variants[i]);
+        xmss_parse_oid(&params, oid);
+
+        printf("Testing keyed PRF against PRF for %s.. ", variants[i]);
+        if (test_prf_keyed(&params)) {
+            printf("failed!\n");
+            ret = -1;
+        }
+        else {
+            printf("successful.\n");
+        }
+
+        printf("Testing cached thash against thash for %s.. ", variants[i]);
+        if (test_thash_ctx(&params)) {
+            printf("failed!\n");
+            ret = -1;
+        }
+        else {
+            printf("successful.\n");
+        }
+
+        printf("Testing batched thash against thash for %s.. ", variants[i]);
+        if (test_thash_x8(&params)) {
+            printf("failed!\n");
+            ret = -1;
+        }
+        else {
+            printf("successful.\n");
+        }
+    }
+    return ret;
+}
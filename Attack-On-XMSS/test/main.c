@@ -20,6 +20,51 @@ int main(int argc, char *argv[]) {
 	*/
 
 	int num_attack_iterations, log_q, log_g_s[MAX_NUM_CHECKPOINTS], num_checkpoints,debug = 0;
+	int shared_guess_pass = 0;
+	guess_dict dict_file;
+	const guess_dict *dict = NULL;
+	size_t ext_budget = 0;
+
+	//-s attacks all iterations' keypairs with a single shared Secret-Guessing phase
+	//-d <file> runs the Secret-Guessing phase as a join against a guess dictionary built by
+	//  ui/guess_dict
+	//-e <MiB> runs the attack out of core in a memory budget of that many MiB, as a sort-merge join
+	//  of tuples and guesses sorted into runs on disk
+	while (argc >= 2 && argv[1][0] == '-') {
+		int num_option_args = 1;
+
+		if (strcmp(argv[1], "-s") == 0) {
+			shared_guess_pass = 1;
+		} else if (strcmp(argv[1], "-d") == 0 && argc >= 3) {
+			xmss_params params;
+			uint32_t oid;
+
+			XMSS_STR_TO_OID(&oid, XMSS_VARIANT);
+			XMSS_PARSE_OID(&params, oid);
+			if (guess_dict_open(&dict_file, argv[2], &params) < 0) {
+				return 1;
+			}
+			dict = &dict_file;
+			num_option_args = 2;
+		} else if (strcmp(argv[1], "-e") == 0 && argc >= 3) {
+			ext_budget = (size_t)atol(argv[2]) << 20;
+			if (ext_budget == 0) {
+				fprintf(stderr, "The memory budget must be at least 1 MiB\n");
+				return 1;
+			}
+			num_option_args = 2;
+		} else {
+			break;
+		}
+		argv[num_option_args] = argv[0];
+		argv += num_option_args;
+		argc -= num_option_args;
+	}
+
+	if (dict != NULL && ext_budget) {
+		fprintf(stderr, "The guess dictionary join cannot run out of core\n");
+		return 1;
+	}
 
 	//Set test parameters with command line arguments, otherwise use default parameters
 	if (argc >= 5) {
@@ -58,6 +103,12 @@ int main(int argc, char *argv[]) {
 	}
 	printf("\n");
 	printf("\tNumber of attack iterations:\t%d\n", num_attack_iterations);
+	printf("\tNumber of guessing threads:\t%d\n", ISG_NUM_THREADS);
+	printf("\tShared guess pass:\t\t%s\n", shared_guess_pass ? "yes" : "no");
+	printf("\tGuess dictionary join:\t\t%s\n", dict != NULL ? "yes" : "no");
+	if (ext_budget) {
+		printf("\tExternal join budget (MiB):\t%zu\n", ext_budget >> 20);
+	}
 
 	printf("\n---STARTING TEST---\n");
 	//Record the real time of the test
@@ -65,7 +116,8 @@ int main(int argc, char *argv[]) {
 
 	//Run test
 	isg_attack_test(&test_result, num_oracle_queries, num_sk_guesses, 
-					  num_checkpoints, num_attack_iterations,debug);
+					  num_checkpoints, num_attack_iterations, ISG_NUM_THREADS, shared_guess_pass,
+					  dict, ext_budget, debug);
 
 	int test_end_time = clock();
 
@@ -87,5 +139,8 @@ int main(int argc, char *argv[]) {
 	printf("\tTest real time (seconds):\t%lf\n", ((double) (test_end_time - test_start_time)) / 
 	         (double) CLOCKS_PER_SEC);
 
+	if (dict != NULL) {
+		guess_dict_close(&dict_file);
+	}
 	return 0;
 }
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../params.h"
+#include "../xmss.h"
+#include "../xmss_core.h"
+#include "../randombytes.h"
+
+#define MLEN 32
+
+/* Enough signatures to cross into a second bottom-layer subtree. */
+#define NSIGS 40
+
+int main()
+{
+    xmss_params params;
+    char *oidstr = "XMSSMT-SHA2_20/4_256";
+    subtree_cache cache;
+    uint32_t oid;
+    unsigned int i;
+    int ret = 0;
+
+    fprintf(stderr, "Testing if cached %s signing matches signing.. ", oidstr);
+
+    xmssmt_str_to_oid(&oid, oidstr);
+    xmssmt_parse_oid(&params, oid);
+
+    unsigned char pk[XMSS_OID_LEN + params.pk_bytes];
+    unsigned char sk[XMSS_OID_LEN + params.sk_bytes];
+    unsigned char sk2[XMSS_OID_LEN + params.sk_bytes];
+
+    unsigned char m[MLEN];
+    unsigned char sm[params.sig_bytes + MLEN];
+    unsigned char sm2[params.sig_bytes + MLEN];
+    unsigned long long smlen;
+
+    xmssmt_keypair(pk, sk, oid);
+
+    /* Duplicate the key, because the original will be modified. */
+    memcpy(sk2, sk, XMSS_OID_LEN + params.sk_bytes);
+
+    /* Fewer entries than layers, so that entries also get evicted. */
+    subtree_cache_init(&params, &cache, params.d - 1);
+
+    for (i = 0; i < NSIGS && !ret; i++) {
+        randombytes(m, MLEN);
+
+        xmssmt_sign(sk, sm, &smlen, m, MLEN);
+        xmssmt_core_sign_cached(&params, sk2 + XMSS_OID_LEN, sm2, &smlen,
+                                m, MLEN, &cache);
+
+        if (memcmp(sm, sm2, params.sig_bytes + MLEN)) {
+            fprintf(stderr, "signature %u differs!\n", i);
+            ret = -1;
+        }
+    }
+    subtree_cache_free(&cache);
+
+    if (!ret) {
+        fprintf(stderr, "signatures are identical.\n");
+    }
+    return ret;
+}
@@ -0,0 +1,60 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../params.h"
+#include "../guess_dict.h"
+#include "../isg-attack-xmss.h"
+
+static void print_progress(uint64_t shard, uint64_t num_shards)
+{
+    fprintf(stderr, "Wrote shard %llu of %llu\n", (unsigned long long)shard + 1,
+            (unsigned long long)num_shards);
+}
+
+int main(int argc, char **argv)
+{
+    xmss_params params;
+    uint32_t oid = 0;
+    unsigned int chop_bytes = XMSS_CHOP_BYTES;
+    unsigned int log_guesses_per_shard;
+    FILE *f;
+
+    if (argc < 2 || argc > 4) {
+        fprintf(stderr, "Expected the path of the dictionary to write, optionally followed by\n"
+                        "the chop width in bytes (default %d) and the log2 of the number of\n"
+                        "guesses per shard (default at most 16).\n"
+                        "The dictionary is built for " XMSS_VARIANT ".\n", XMSS_CHOP_BYTES);
+        return -1;
+    }
+    if (argc >= 3) {
+        chop_bytes = atoi(argv[2]);
+    }
+    log_guesses_per_shard = 8*chop_bytes < 16 ? 8*chop_bytes : 16;
+    if (argc >= 4) {
+        log_guesses_per_shard = atoi(argv[3]);
+    }
+
+    XMSS_STR_TO_OID(&oid, XMSS_VARIANT);
+    if (XMSS_PARSE_OID(&params, oid) != 0) {
+        fprintf(stderr, "Error parsing oid.\n");
+        return -1;
+    }
+
+    f = fopen(argv[1], "wb");
+    if (f == NULL) {
+        perror(argv[1]);
+        return -1;
+    }
+    if (guess_dict_write(f, &params, chop_bytes, log_guesses_per_shard, print_progress) < 0) {
+        fprintf(stderr, "%s: could not write guess dictionary\n", argv[1]);
+        fclose(f);
+        return -1;
+    }
+    if (fclose(f) != 0) {
+        perror(argv[1]);
+        return -1;
+    }
+
+    return 0;
+}
@@ -15,7 +15,7 @@ void chop(const xmss_params *params, unsigned char *outseeds)
     //outseeds[0] &= 0x0F;
     //outseeds[1] = 0x00;
 
-    for (j = 2; j < params->n; j++)
+    for (j = XMSS_CHOP_BYTES; j < params->n; j++)
 	outseeds[j] = 0x00;
 }
 
@@ -23,16 +23,20 @@ void chop(const xmss_params *params, unsigned char *outseeds)
 /**
  * Helper method for pseudorandom key generation.
  * Expands an n-byte array into a len*n byte array using the `prf` function.
+ * All len PRF calls share the key inseed, so its first block is compressed
+ * only once.
  */
 void expand_seed(const xmss_params *params,
                         unsigned char *outseeds, const unsigned char *inseed)
 {
     uint32_t i;
     unsigned char ctr[32];
+    prf_ctx ctx;
 
+    prf_keyed_init(params, &ctx, inseed);
     for (i = 0; i < params->wots_len; i++) {
         ull_to_bytes(ctr, 32, i);
-        prf(params, outseeds + i*params->n, ctr, inseed);
+        prf_keyed(params, outseeds + i*params->n, ctr, &ctx);
 	//chop(params, outseeds + i*params->n);
     }
 }
@@ -47,7 +51,7 @@ void expand_seed(const xmss_params *params,
 static void gen_chain(const xmss_params *params,
                       unsigned char *out, const unsigned char *in,
                       unsigned int start, unsigned int steps,
-                      const unsigned char *pub_seed, uint32_t addr[8])
+                      const hash_ctx *ctx, uint32_t addr[8])
 {
     uint32_t i;
 
@@ -57,11 +61,116 @@ static void gen_chain(const xmss_params *params,
     /* Iterate 'steps' calls to the hash function. */
     for (i = start; i < (start+steps) && i < params->wots_w; i++) {
         set_hash_addr(addr, i);
-        thash_f(params, out, out, pub_seed, addr);
+        thash_f_ctx(params, out, out, ctx, addr);
 	chop(params, out);
     }
 }
 
+/* Chains are hashed 8 at a time while at least this many are unfinished;
+   the last few are finished one by one. */
+#define WOTS_MIN_BATCH 4
+
+/**
+ * Computes the chaining function on all wots_len chains, up to 8 at a time.
+ * out and in have to be len*n-byte arrays and may be equal.
+ *
+ * Interprets chain i of in as the start[i]-th value of the chain and takes
+ * steps[i] steps. Each of the 8 lanes works on one chain and takes the next
+ * one when it is done, longest chains first, so that the batches stay full.
+ * addr has to contain the address of the WOTS key pair.
+ */
+static void gen_chains(const xmss_params *params,
+                       unsigned char *out, const unsigned char *in,
+                       const int *start, const int *steps,
+                       const hash_ctx *ctx, uint32_t addr[8])
+{
+    uint32_t lane_addr[8][8];
+    unsigned char *lane_out[8];
+    const unsigned char *lane_in[8];
+    unsigned int order[params->wots_len];
+    unsigned int end[params->wots_len];
+    unsigned int pos[8], lane_end[8];
+    int busy[8];
+    unsigned int num_chains = 0, next = 0, first, i, j, s;
+
+    if (out != in) {
+        memcpy(out, in, params->wots_len*params->n);
+    }
+
+    for (i = 0; i < params->wots_len; i++) {
+        end[i] = start[i] + steps[i];
+        if (end[i] > params->wots_w) {
+            end[i] = params->wots_w;
+        }
+    }
+    for (s = params->wots_w - 1; s > 0; s--) {
+        for (i = 0; i < params->wots_len; i++) {
+            if (end[i] - start[i] == s) {
+                order[num_chains++] = i;
+            }
+        }
+    }
+
+    for (j = 0; j < 8; j++) {
+        busy[j] = 0;
+    }
+
+    for (;;) {
+        /* Give every idle lane the next chain. */
+        first = 8;
+        s = 0;
+        for (j = 0; j < 8; j++) {
+            if (!busy[j] && next < num_chains) {
+                i = order[next++];
+                memcpy(lane_addr[j], addr, 32);
+                set_chain_addr(lane_addr[j], i);
+                lane_out[j] = out + i*params->n;
+                pos[j] = start[i];
+                lane_end[j] = end[i];
+                busy[j] = 1;
+            }
+            if (busy[j]) {
+                s++;
+                first = first < j ? first : j;
+            }
+        }
+        if (s < WOTS_MIN_BATCH) {
+            break;
+        }
+
+        /* Idle lanes repeat the first busy one, which writes the same value. */
+        for (j = 0; j < 8; j++) {
+            if (busy[j]) {
+                set_hash_addr(lane_addr[j], pos[j]);
+            }
+        }
+        for (j = 0; j < 8; j++) {
+            if (!busy[j]) {
+                memcpy(lane_addr[j], lane_addr[first], 32);
+                lane_out[j] = lane_out[first];
+            }
+            lane_in[j] = lane_out[j];
+        }
+        thash_f_x8(params, lane_out, lane_in, ctx, lane_addr);
+
+        for (j = 0; j < 8; j++) {
+            if (busy[j]) {
+                chop(params, lane_out[j]);
+                if (++pos[j] == lane_end[j]) {
+                    busy[j] = 0;
+                }
+            }
+        }
+    }
+
+    for (j = 0; j < 8; j++) {
+        if (busy[j]) {
+            gen_chain(params, lane_out[j], lane_out[j],
+                      pos[j], lane_end[j] - pos[j], ctx, lane_addr[j]);
+        }
+    }
+}
+
 /**
  * base_w algorithm as described in draft.
  * Interprets an array of bytes as integers in base w.
@@ -119,37 +228,40 @@ void chain_lengths(const xmss_params *params,
 /**
  * WOTS key generation. Takes a 32 byte seed for the private key, expands it to
  * a full WOTS private key and computes the corresponding public key.
- * It requires the seed pub_seed (used to generate bitmasks and hash keys)
- * and the address of this WOTS key pair.
+ * It requires the hash context of pub_seed (used to generate bitmasks and
+ * hash keys) and the address of this WOTS key pair.
  *
  * Writes the computed public key to 'pk'.
  */
-void wots_pkgen(const xmss_params *params,
-                unsigned char *pk, const unsigned char *seed,
-                const unsigned char *pub_seed, uint32_t addr[8])
+void wots_pkgen_ctx(const xmss_params *params,
+                    unsigned char *pk, const unsigned char *seed,
+                    const hash_ctx *ctx, uint32_t addr[8])
 {
+    int start[params->wots_len];
+    int steps[params->wots_len];
     uint32_t i;
 
     /* The WOTS+ private key is derived from the seed. */
     expand_seed(params, pk, seed);
 
     for (i = 0; i < params->wots_len; i++) {
-        set_chain_addr(addr, i);
-        gen_chain(params, pk + i*params->n, pk + i*params->n,
-                  0, params->wots_w - 1, pub_seed, addr);
+        start[i] = 0;
+        steps[i] = params->wots_w - 1;
     }
+    gen_chains(params, pk, pk, start, steps, ctx, addr);
 }
 
 /**
  * Takes a n-byte message and the 32-byte seed for the private key to compute a
  * signature that is placed at 'sig'.
  */
-void wots_sign(const xmss_params *params,
-               unsigned char *sig, const unsigned char *msg,
-               const unsigned char *seed, const unsigned char *pub_seed,
-               uint32_t addr[8])
+void wots_sign_ctx(const xmss_params *params,
+                   unsigned char *sig, const unsigned char *msg,
+                   const unsigned char *seed, const hash_ctx *ctx,
+                   uint32_t addr[8])
 {
     int lengths[params->wots_len];
+    int start[params->wots_len];
     uint32_t i;
 
     chain_lengths(params, lengths, msg);
@@ -158,10 +270,9 @@ void wots_sign(const xmss_params *params,
     expand_seed(params, sig, seed);
 
     for (i = 0; i < params->wots_len; i++) {
-        set_chain_addr(addr, i);
-        gen_chain(params, sig + i*params->n, sig + i*params->n,
-                  0, lengths[i], pub_seed, addr);
+        start[i] = 0;
     }
+    gen_chains(params, sig, sig, start, lengths, ctx, addr);
 }
 
 /**
@@ -169,18 +280,49 @@ void wots_sign(const xmss_params *params,
  *
  * Writes the computed public key to 'pk'.
  */
-void wots_pk_from_sig(const xmss_params *params, unsigned char *pk,
-                      const unsigned char *sig, const unsigned char *msg,
-                      const unsigned char *pub_seed, uint32_t addr[8])
+void wots_pk_from_sig_ctx(const xmss_params *params, unsigned char *pk,
+                          const unsigned char *sig, const unsigned char *msg,
+                          const hash_ctx *ctx, uint32_t addr[8])
 {
     int lengths[params->wots_len];
+    int steps[params->wots_len];
     uint32_t i;
 
     chain_lengths(params, lengths, msg);
 
     for (i = 0; i < params->wots_len; i++) {
-        set_chain_addr(addr, i);
-        gen_chain(params, pk + i*params->n, sig + i*params->n,
-                  lengths[i], params->wots_w - 1 - lengths[i], pub_seed, addr);
+        steps[i] = params->wots_w - 1 - lengths[i];
     }
+    gen_chains(params, pk, sig, lengths, steps, ctx, addr);
+}
+
+void wots_pkgen(const xmss_params *params,
+                unsigned char *pk, const unsigned char *seed,
+                const unsigned char *pub_seed, uint32_t addr[8])
+{
+    hash_ctx ctx;
+
+    hash_ctx_init(params, &ctx, pub_seed);
+    wots_pkgen_ctx(params, pk, seed, &ctx, addr);
+}
+
+void wots_sign(const xmss_params *params,
+               unsigned char *sig, const unsigned char *msg,
+               const unsigned char *seed, const unsigned char *pub_seed,
+               uint32_t addr[8])
+{
+    hash_ctx ctx;
+
+    hash_ctx_init(params, &ctx, pub_seed);
+    wots_sign_ctx(params, sig, msg, seed, &ctx, addr);
+}
+
+void wots_pk_from_sig(const xmss_params *params, unsigned char *pk,
+                      const unsigned char *sig, const unsigned char *msg,
+                      const unsigned char *pub_seed, uint32_t addr[8])
+{
+    hash_ctx ctx;
+
+    hash_ctx_init(params, &ctx, pub_seed);
+    wots_pk_from_sig_ctx(params, pk, sig, msg, &ctx, addr);
 }
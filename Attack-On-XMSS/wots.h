@@ -3,7 +3,13 @@
 
 #include <stdint.h>
 #include "params.h"
+#include "hash.h"
 
+/* Number of leading bytes chop() keeps; the attacked seeds and chain values
+   have 2^(8*XMSS_CHOP_BYTES) possible values. */
+#ifndef XMSS_CHOP_BYTES
+    #define XMSS_CHOP_BYTES 2
+#endif
 
 void chop(const xmss_params *params, unsigned char *outseeds);
 
@@ -49,4 +55,19 @@ void wots_pk_from_sig(const xmss_params *params, unsigned char *pk,
                       const unsigned char *sig, const unsigned char *msg,
                       const unsigned char *pub_seed, uint32_t addr[8]);
 
+/* As above, but taking the hash context of pub_seed instead of pub_seed. */
+
+void wots_pkgen_ctx(const xmss_params *params,
+                    unsigned char *pk, const unsigned char *seed,
+                    const hash_ctx *ctx, uint32_t addr[8]);
+
+void wots_sign_ctx(const xmss_params *params,
+                   unsigned char *sig, const unsigned char *msg,
+                   const unsigned char *seed, const hash_ctx *ctx,
+                   uint32_t addr[8]);
+
+void wots_pk_from_sig_ctx(const xmss_params *params, unsigned char *pk,
+                          const unsigned char *sig, const unsigned char *msg,
+                          const hash_ctx *ctx, uint32_t addr[8]);
+
 #endif
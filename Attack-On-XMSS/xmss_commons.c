@@ -9,28 +9,47 @@
 #include "utils.h"
 #include "xmss_commons.h"
 
+/* The nodes of an L-tree level are hashed 8 at a time while at least this
+   many remain; the rest are hashed one by one. */
+#define L_TREE_MIN_BATCH 4
+
 /**
  * Computes a leaf node from a WOTS public key using an L-tree.
  * Note that this destroys the used WOTS public key.
  */
-void l_tree(const xmss_params *params,
-                   unsigned char *leaf, unsigned char *wots_pk,
-                   const unsigned char *pub_seed, uint32_t addr[8])
+void l_tree_ctx(const xmss_params *params,
+                unsigned char *leaf, unsigned char *wots_pk,
+                const hash_ctx *ctx, uint32_t addr[8])
 {
     unsigned int l = params->wots_len;
     unsigned int parent_nodes;
-    uint32_t i;
+    uint32_t lane_addr[8][8];
+    unsigned char *lane_out[8];
+    const unsigned char *lane_in[8];
+    uint32_t i, j, k;
     uint32_t height = 0;
 
     set_tree_height(addr, height);
 
     while (l > 1) {
         parent_nodes = l >> 1;
-        for (i = 0; i < parent_nodes; i++) {
+        /* Node i only reads nodes 2i and 2i+1, which no earlier batch has
+           overwritten. Lanes past the end of the level repeat node i. */
+        for (i = 0; i + L_TREE_MIN_BATCH <= parent_nodes; i += 8) {
+            for (j = 0; j < 8; j++) {
+                k = i + j < parent_nodes ? i + j : i;
+                memcpy(lane_addr[j], addr, 32);
+                set_tree_index(lane_addr[j], k);
+                lane_out[j] = wots_pk + k*params->n;
+                lane_in[j] = wots_pk + (k*2)*params->n;
+            }
+            thash_h_x8(params, lane_out, lane_in, ctx, lane_addr);
+        }
+        for (; i < parent_nodes; i++) {
             set_tree_index(addr, i);
             /* Hashes the nodes at (i*2)*params->n and (i*2)*params->n + 1 */
-            thash_h(params, wots_pk + i*params->n,
-                           wots_pk + (i*2)*params->n, pub_seed, addr);
+            thash_h_ctx(params, wots_pk + i*params->n,
+                        wots_pk + (i*2)*params->n, ctx, addr);
         }
         /* If the row contained an odd number of nodes, the last node was not
            hashed. Instead, we pull it up to the next layer. */
@@ -51,10 +70,10 @@ void l_tree(const xmss_params *params,
 /**
  * Computes a root node given a leaf and an auth path
  */
-void compute_root(const xmss_params *params, unsigned char *root,
-                         const unsigned char *leaf, unsigned long leafidx,
-                         const unsigned char *auth_path,
-                         const unsigned char *pub_seed, uint32_t addr[8])
+void compute_root_ctx(const xmss_params *params, unsigned char *root,
+                      const unsigned char *leaf, unsigned long leafidx,
+                      const unsigned char *auth_path,
+                      const hash_ctx *ctx, uint32_t addr[8])
 {
     uint32_t i;
     unsigned char buffer[2*params->n];
@@ -78,11 +97,11 @@ void compute_root(const xmss_params *params, unsigned char *root,
 
         /* Pick the right or left neighbor, depending on parity of the node. */
         if (leafidx & 1) {
-            thash_h(params, buffer + params->n, buffer, pub_seed, addr);
+            thash_h_ctx(params, buffer + params->n, buffer, ctx, addr);
             memcpy(buffer, auth_path, params->n);
         }
         else {
-            thash_h(params, buffer, buffer, pub_seed, addr);
+            thash_h_ctx(params, buffer, buffer, ctx, addr);
             memcpy(buffer + params->n, auth_path, params->n);
         }
         auth_path += params->n;
@@ -92,7 +111,28 @@ void compute_root(const xmss_params *params, unsigned char *root,
     set_tree_height(addr, params->tree_height - 1);
     leafidx >>= 1;
     set_tree_index(addr, leafidx);
-    thash_h(params, root, buffer, pub_seed, addr);
+    thash_h_ctx(params, root, buffer, ctx, addr);
+}
+
+void l_tree(const xmss_params *params,
+                   unsigned char *leaf, unsigned char *wots_pk,
+                   const unsigned char *pub_seed, uint32_t addr[8])
+{
+    hash_ctx ctx;
+
+    hash_ctx_init(params, &ctx, pub_seed);
+    l_tree_ctx(params, leaf, wots_pk, &ctx, addr);
+}
+
+void compute_root(const xmss_params *params, unsigned char *root,
+                         const unsigned char *leaf, unsigned long leafidx,
+                         const unsigned char *auth_path,
+                         const unsigned char *pub_seed, uint32_t addr[8])
+{
+    hash_ctx ctx;
+
+    hash_ctx_init(params, &ctx, pub_seed);
+    compute_root_ctx(params, root, leaf, leafidx, auth_path, &ctx, addr);
 }
 
 
@@ -101,17 +141,29 @@ void compute_root(const xmss_params *params, unsigned char *root,
  * then computes leaf using l_tree. As this happens position independent, we
  * only require that addr encodes the right ltree-address.
  */
-void gen_leaf_wots(const xmss_params *params, unsigned char *leaf,
-                   const unsigned char *sk_seed, const unsigned char *pub_seed,
-                   uint32_t ltree_addr[8], uint32_t ots_addr[8])
+void gen_leaf_wots_ctx(const xmss_params *params, unsigned char *leaf,
+                       const prf_ctx *seed_prf, const hash_ctx *ctx,
+                       uint32_t ltree_addr[8], uint32_t ots_addr[8])
 {
     unsigned char seed[params->n];
     unsigned char pk[params->wots_sig_bytes];
 
-    get_seed(params, seed, sk_seed, ots_addr);
-    wots_pkgen(params, pk, seed, pub_seed, ots_addr);
+    get_seed_keyed(params, seed, seed_prf, ots_addr);
+    wots_pkgen_ctx(params, pk, seed, ctx, ots_addr);
 
-    l_tree(params, leaf, pk, pub_seed, ltree_addr);
+    l_tree_ctx(params, leaf, pk, ctx, ltree_addr);
+}
+
+void gen_leaf_wots(const xmss_params *params, unsigned char *leaf,
+                   const unsigned char *sk_seed, const unsigned char *pub_seed,
+                   uint32_t ltree_addr[8], uint32_t ots_addr[8])
+{
+    prf_ctx seed_prf;
+    hash_ctx ctx;
+
+    prf_keyed_init(params, &seed_prf, sk_seed);
+    hash_ctx_init(params, &ctx, pub_seed);
+    gen_leaf_wots_ctx(params, leaf, &seed_prf, &ctx, ltree_addr, ots_addr);
 }
 
 /**
@@ -122,6 +174,15 @@ void gen_leaf_wots(const xmss_params *params, unsigned char *leaf,
  */
 void get_seed(const xmss_params *params, unsigned char *seed,
               const unsigned char *sk_seed, uint32_t addr[8])
+{
+    prf_ctx seed_prf;
+
+    prf_keyed_init(params, &seed_prf, sk_seed);
+    get_seed_keyed(params, seed, &seed_prf, addr);
+}
+
+void get_seed_keyed(const xmss_params *params, unsigned char *seed,
+                    const prf_ctx *seed_prf, uint32_t addr[8])
 {
     unsigned char bytes[32];
 
@@ -132,7 +193,7 @@ void get_seed(const xmss_params *params, unsigned char *seed,
 
     /* Generate seed. */
     addr_to_bytes(bytes, addr);
-    prf(params, seed, bytes, sk_seed);
+    prf_keyed(params, seed, bytes, seed_prf);
     chop(params, seed);
 }
 
@@ -160,15 +221,37 @@ int xmssmt_core_sign_open(const xmss_params *params,
                           unsigned char *m, unsigned long long *mlen,
                           const unsigned char *sm, unsigned long long smlen,
                           const unsigned char *pk)
+{
+    return xmssmt_core_sign_open_harvest(params, m, mlen, sm, smlen, pk,
+                                         NULL, NULL, NULL);
+}
+
+/**
+ * Verifies a given message signature pair under a given public key, passing
+ * every layer of the hypertree walk to harvest (if not NULL).
+ * Note that this assumes a pk without an OID, i.e. [root || PUB_SEED]
+ */
+int xmssmt_core_sign_open_harvest(const xmss_params *params,
+                                  unsigned char *m, unsigned long long *mlen,
+                                  const unsigned char *sm,
+                                  unsigned long long smlen,
+                                  const unsigned char *pk,
+                                  bitmask_table *table,
+                                  xmss_harvest_fn harvest, void *arg)
 {
     const unsigned char *pub_root = pk;
     const unsigned char *pub_seed = pk + params->n;
+    hash_ctx ctx;
     unsigned char wots_pk[params->wots_sig_bytes];
+    unsigned char ltree_in[params->wots_sig_bytes];
     unsigned char leaf[params->n];
     unsigned char root[params->n];
     unsigned char *mhash = root;
+    int lengths[params->wots_len];
+    unsigned int zero_chains[params->wots_len];
+    unsigned int num_zero_chains;
     unsigned long long idx = 0;
-    unsigned int i;
+    unsigned int i, j;
     uint32_t idx_leaf;
 
     uint32_t ots_addr[8] = {0};
@@ -179,6 +262,9 @@ int xmssmt_core_sign_open(const xmss_params *params,
     set_type(ltree_addr, XMSS_ADDR_TYPE_LTREE);
     set_type(node_addr, XMSS_ADDR_TYPE_HASHTREE);
 
+    hash_ctx_init(params, &ctx, pub_seed);
+    ctx.table = table;
+
     *mlen = smlen - params->sig_bytes;
 
     /* Convert the index bytes from the signature to an integer. */
@@ -210,20 +296,33 @@ int xmssmt_core_sign_open(const xmss_params *params,
         set_ots_addr(ots_addr, idx_leaf);
         /* Initially, root = mhash, but on subsequent iterations it is the root
            of the subtree below the currently processed subtree. */
-	//printf("\nPub Seed from XMSS verify----------------------------\n");
-	//for(int i1=0; i1<params->n; i1++)
-	//	printf("%hhu ",pub_seed[i1]);
-	//printf("\n");
-	//printf("pk = %p\n",pk);
-        wots_pk_from_sig(params, wots_pk, sm, root, pub_seed, ots_addr);
-        sm += params->wots_sig_bytes;
+        wots_pk_from_sig_ctx(params, wots_pk, sm, root, &ctx, ots_addr);
 
-        /* Compute the leaf node using the WOTS public key. */
+        /* Compute the leaf node using the WOTS public key. The L-tree destroys
+           its input, so it works on a copy if the key is passed on. */
         set_ltree_addr(ltree_addr, idx_leaf);
-        l_tree(params, leaf, wots_pk, pub_seed, ltree_addr);
+        if (harvest != NULL) {
+            memcpy(ltree_in, wots_pk, params->wots_sig_bytes);
+            l_tree_ctx(params, leaf, ltree_in, &ctx, ltree_addr);
+
+            /* Chains of length 0 reveal a secret key component. */
+            chain_lengths(params, lengths, root);
+            num_zero_chains = 0;
+            for (j = 0; j < params->wots_len; j++) {
+                if (lengths[j] == 0) {
+                    zero_chains[num_zero_chains++] = j;
+                }
+            }
+            harvest(arg, params, i, ots_addr, sm, wots_pk, leaf,
+                    lengths, zero_chains, num_zero_chains);
+        }
+        else {
+            l_tree_ctx(params, leaf, wots_pk, &ctx, ltree_addr);
+        }
+        sm += params->wots_sig_bytes;
 
         /* Compute the root node of this subtree. */
-        compute_root(params, root, leaf, idx_leaf, sm, pub_seed, node_addr);
+        compute_root_ctx(params, root, leaf, idx_leaf, sm, &ctx, node_addr);
         sm += params->tree_height*params->n;
     }
 
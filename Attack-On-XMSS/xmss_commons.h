@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "params.h"
+#include "hash.h"
 
 /**
  * Computes a leaf node from a WOTS public key using an L-tree.
@@ -29,6 +30,22 @@ void gen_leaf_wots(const xmss_params *params, unsigned char *leaf,
                    const unsigned char *sk_seed, const unsigned char *pub_seed,
                    uint32_t ltree_addr[8], uint32_t ots_addr[8]);
 
+/* As above, but taking the hash context of pub_seed instead of pub_seed, and
+   the PRF keyed with sk_seed instead of sk_seed. */
+
+void l_tree_ctx(const xmss_params *params,
+                unsigned char *leaf, unsigned char *wots_pk,
+                const hash_ctx *ctx, uint32_t addr[8]);
+
+void compute_root_ctx(const xmss_params *params, unsigned char *root,
+                      const unsigned char *leaf, unsigned long leafidx,
+                      const unsigned char *auth_path,
+                      const hash_ctx *ctx, uint32_t addr[8]);
+
+void gen_leaf_wots_ctx(const xmss_params *params, unsigned char *leaf,
+                       const prf_ctx *seed_prf, const hash_ctx *ctx,
+                       uint32_t ltree_addr[8], uint32_t ots_addr[8]);
+
 /**
  * Used for pseudo-random key generation.
  * Generates the seed for the WOTS key pair at address 'addr'.
@@ -38,6 +55,11 @@ void gen_leaf_wots(const xmss_params *params, unsigned char *leaf,
 void get_seed(const xmss_params *params, unsigned char *seed,
               const unsigned char *sk_seed, uint32_t addr[8]);
 
+/* As get_seed, but with the PRF keyed with sk_seed once, so that every seed
+   of a keypair only costs the compression of the block holding the address. */
+void get_seed_keyed(const xmss_params *params, unsigned char *seed,
+                    const prf_ctx *seed_prf, uint32_t addr[8]);
+
 /**
  * Verifies a given message signature pair under a given public key.
  * Note that this assumes a pk without an OID, i.e. [root || PUB_SEED]
@@ -55,4 +77,34 @@ int xmssmt_core_sign_open(const xmss_params *params,
                           unsigned char *m, unsigned long long *mlen,
                           const unsigned char *sm, unsigned long long smlen,
                           const unsigned char *pk);
+
+/**
+ * Receives one layer of the hypertree walk of xmssmt_core_sign_open_harvest:
+ * the layer, the address of its WOTS key pair, the WOTS signature and the
+ * public key recovered from it, the L-tree leaf of that key, the wots_len
+ * chain lengths of the signed value, and the indices of the chains of
+ * length 0, whose signature values are secret key components.
+ */
+typedef void (*xmss_harvest_fn)(void *arg, const xmss_params *params,
+                                uint32_t layer, const uint32_t ots_addr[8],
+                                const unsigned char *wots_sig,
+                                const unsigned char *wots_pk,
+                                const unsigned char *leaf,
+                                const int *lengths,
+                                const unsigned int *zero_chains,
+                                unsigned int num_zero_chains);
+
+/**
+ * As xmssmt_core_sign_open, but also calls harvest(arg, ...) (if not NULL)
+ * for every layer, bottom up, in the same pass. The layers are reported
+ * before the root is checked, so their data is only authentic if 0 is
+ * returned. table is an optional bitmask table for the hash context.
+ */
+int xmssmt_core_sign_open_harvest(const xmss_params *params,
+                                  unsigned char *m, unsigned long long *mlen,
+                                  const unsigned char *sm,
+                                  unsigned long long smlen,
+                                  const unsigned char *pk,
+                                  bitmask_table *table,
+                                  xmss_harvest_fn harvest, void *arg);
 #endif
@@ -19,13 +19,14 @@
  */
 static void treehash(const xmss_params *params,
                      unsigned char *root, unsigned char *auth_path,
-                     const unsigned char *sk_seed,
+                     const prf_ctx *seed_prf,
                      const unsigned char *pub_seed,
                      uint32_t leaf_idx, const uint32_t subtree_addr[8])
 {
     unsigned char stack[(params->tree_height+1)*params->n];
     unsigned int heights[params->tree_height+1];
     unsigned int offset = 0;
+    hash_ctx ctx;
 
     /* The subtree has at most 2^20 leafs, so uint32_t suffices. */
     uint32_t idx;
@@ -45,12 +46,14 @@ static void treehash(const xmss_params *params,
     set_type(ltree_addr, XMSS_ADDR_TYPE_LTREE);
     set_type(node_addr, XMSS_ADDR_TYPE_HASHTREE);
 
+    hash_ctx_init(params, &ctx, pub_seed);
+
     for (idx = 0; idx < (uint32_t)(1 << params->tree_height); idx++) {
         /* Add the next leaf node to the stack. */
         set_ltree_addr(ltree_addr, idx);
         set_ots_addr(ots_addr, idx);
-        gen_leaf_wots(params, stack + offset*params->n,
-                      sk_seed, pub_seed, ltree_addr, ots_addr);
+        gen_leaf_wots_ctx(params, stack + offset*params->n,
+                          seed_prf, &ctx, ltree_addr, ots_addr);
         offset++;
         heights[offset - 1] = 0;
 
@@ -70,8 +73,8 @@ static void treehash(const xmss_params *params,
                from the fact that we address the hash function calls. */
             set_tree_height(node_addr, heights[offset - 1]);
             set_tree_index(node_addr, tree_idx);
-            thash_h(params, stack + (offset-2)*params->n,
-                           stack + (offset-2)*params->n, pub_seed, node_addr);
+            thash_h_ctx(params, stack + (offset-2)*params->n,
+                        stack + (offset-2)*params->n, &ctx, node_addr);
             offset--;
             /* Note that the top-most node is now one layer higher. */
             heights[offset - 1]++;
@@ -86,6 +89,140 @@ static void treehash(const xmss_params *params,
     memcpy(root, stack, params->n);
 }
 
+/* Number of nodes of a subtree, leaves and root included. */
+static unsigned long long subtree_num_nodes(const xmss_params *params)
+{
+    return (2ULL << params->tree_height) - 1;
+}
+
+/**
+ * Computes every node of the subtree selected by subtree_addr, level by level
+ * starting at the leaves, using the same addresses as treehash. The root is
+ * the last node.
+ * Expects the layer and tree parts of subtree_addr to be set.
+ */
+static void build_subtree(const xmss_params *params, unsigned char *nodes,
+                          const prf_ctx *seed_prf,
+                          const unsigned char *pub_seed,
+                          const uint32_t subtree_addr[8])
+{
+    unsigned char *level = nodes;
+    uint32_t width = 1 << params->tree_height;
+    uint32_t idx;
+    unsigned int height;
+    hash_ctx ctx;
+
+    uint32_t ots_addr[8] = {0};
+    uint32_t ltree_addr[8] = {0};
+    uint32_t node_addr[8] = {0};
+
+    copy_subtree_addr(ots_addr, subtree_addr);
+    copy_subtree_addr(ltree_addr, subtree_addr);
+    copy_subtree_addr(node_addr, subtree_addr);
+
+    set_type(ots_addr, XMSS_ADDR_TYPE_OTS);
+    set_type(ltree_addr, XMSS_ADDR_TYPE_LTREE);
+    set_type(node_addr, XMSS_ADDR_TYPE_HASHTREE);
+
+    hash_ctx_init(params, &ctx, pub_seed);
+
+    for (idx = 0; idx < width; idx++) {
+        set_ltree_addr(ltree_addr, idx);
+        set_ots_addr(ots_addr, idx);
+        gen_leaf_wots_ctx(params, nodes + idx*params->n,
+                          seed_prf, &ctx, ltree_addr, ots_addr);
+    }
+
+    /* The parents of a level directly follow it, so node idx of the next
+       level is node width + idx counted from the start of this one. */
+    for (height = 0; height < params->tree_height; height++) {
+        set_tree_height(node_addr, height);
+        for (idx = 0; idx < width / 2; idx++) {
+            set_tree_index(node_addr, idx);
+            thash_h_ctx(params, level + (width + idx)*params->n,
+                        level + 2*idx*params->n, &ctx, node_addr);
+        }
+        level += width*params->n;
+        width >>= 1;
+    }
+}
+
+/**
+ * Reads the root and the authentication path of leaf_idx from the nodes of a
+ * subtree built by build_subtree.
+ */
+static void subtree_auth_path(const xmss_params *params,
+                              unsigned char *root, unsigned char *auth_path,
+                              const unsigned char *nodes, uint32_t leaf_idx)
+{
+    uint32_t width = 1 << params->tree_height;
+    unsigned int height;
+
+    for (height = 0; height < params->tree_height; height++) {
+        memcpy(auth_path + height*params->n,
+               nodes + ((leaf_idx >> height) ^ 0x1)*params->n, params->n);
+        nodes += width*params->n;
+        width >>= 1;
+    }
+    memcpy(root, nodes, params->n);
+}
+
+void subtree_cache_init(const xmss_params *params, subtree_cache *cache,
+                        unsigned int num_entries)
+{
+    unsigned long long entry_bytes = (2 + subtree_num_nodes(params)) * params->n;
+    unsigned char *buf = malloc(num_entries * entry_bytes);
+    unsigned int i;
+
+    cache->entries = malloc(num_entries * sizeof(subtree_cache_entry));
+    cache->num_entries = num_entries;
+    for (i = 0; i < num_entries; i++) {
+        cache->entries[i].valid = 0;
+        cache->entries[i].seeds = buf + i * entry_bytes;
+        cache->entries[i].nodes = buf + i * entry_bytes + 2*params->n;
+    }
+}
+
+void subtree_cache_free(subtree_cache *cache)
+{
+    if (cache->num_entries > 0) {
+        free(cache->entries[0].seeds);
+    }
+    free(cache->entries);
+    cache->entries = NULL;
+    cache->num_entries = 0;
+}
+
+/**
+ * Returns the nodes of the subtree selected by subtree_addr, building them
+ * into the cache on a miss. Entries built from other seeds never match.
+ * seed_prf is keyed with the sk_seed of the subtree.
+ */
+static const unsigned char *subtree_cache_get(const xmss_params *params,
+                                              subtree_cache *cache,
+                                              const prf_ctx *seed_prf,
+                                              const unsigned char *pub_seed,
+                                              uint32_t layer,
+                                              unsigned long long tree,
+                                              const uint32_t subtree_addr[8])
+{
+    subtree_cache_entry *entry =
+        &cache->entries[(tree * params->d + layer) % cache->num_entries];
+    const unsigned char *sk_seed = seed_prf->key;
+
+    if (!entry->valid || entry->layer != layer || entry->tree != tree ||
+            memcmp(entry->seeds, sk_seed, params->n) ||
+            memcmp(entry->seeds + params->n, pub_seed, params->n)) {
+        build_subtree(params, entry->nodes, seed_prf, pub_seed, subtree_addr);
+        memcpy(entry->seeds, sk_seed, params->n);
+        memcpy(entry->seeds + params->n, pub_seed, params->n);
+        entry->layer = layer;
+        entry->tree = tree;
+        entry->valid = 1;
+    }
+    return entry->nodes;
+}
+
 /**
  * Given a set of parameters, this function returns the size of the secret key.
  * This is implementation specific, as varying choices in tree traversal will
@@ -139,6 +276,7 @@ int xmssmt_core_keypair(const xmss_params *params,
        in one function. */
     unsigned char auth_path[params->tree_height * params->n];
     uint32_t top_tree_addr[8] = {0};
+    prf_ctx seed_prf;
     set_layer_addr(top_tree_addr, params->d - 1);
 
     /* Initialize index to 0. */
@@ -153,7 +291,8 @@ int xmssmt_core_keypair(const xmss_params *params,
     memcpy(pk + params->n, sk + 3*params->n, params->n);
 
     /* Compute root node of the top-most subtree. */
-    treehash(params, pk, auth_path, sk, pk + params->n, 0, top_tree_addr);
+    prf_keyed_init(params, &seed_prf, sk);
+    treehash(params, pk, auth_path, &seed_prf, pk + params->n, 0, top_tree_addr);
     memcpy(sk + 2*params->n, pk, params->n);
 
     return 0;
@@ -167,6 +306,20 @@ int xmssmt_core_sign(const xmss_params *params,
                      unsigned char *sk,
                      unsigned char *sm, unsigned long long *smlen,
                      const unsigned char *m, unsigned long long mlen)
+{
+    return xmssmt_core_sign_cached(params, sk, sm, smlen, m, mlen, NULL);
+}
+
+/**
+ * As xmssmt_core_sign, but takes the roots and authentication paths from
+ * cache, building each subtree only the first time a signature touches it.
+ * Without a cache (NULL), every subtree is rebuilt with treehash.
+ */
+int xmssmt_core_sign_cached(const xmss_params *params,
+                            unsigned char *sk,
+                            unsigned char *sm, unsigned long long *smlen,
+                            const unsigned char *m, unsigned long long mlen,
+                            subtree_cache *cache)
 {
     const unsigned char *sk_seed = sk + params->index_bytes;
     const unsigned char *sk_prf = sk + params->index_bytes + params->n;
@@ -176,14 +329,20 @@ int xmssmt_core_sign(const xmss_params *params,
     unsigned char root[params->n];
     unsigned char *mhash = root;
     unsigned char ots_seed[params->n];
+    const unsigned char *nodes;
     unsigned long long idx;
     unsigned char idx_bytes_32[32];
     unsigned int i;
     uint32_t idx_leaf;
+    prf_ctx seed_prf;
 
     uint32_t ots_addr[8] = {0};
     set_type(ots_addr, XMSS_ADDR_TYPE_OTS);
 
+    /* Every WOTS seed of the signature is a PRF of sk_seed, so it is keyed
+       once for all of them. */
+    prf_keyed_init(params, &seed_prf, sk_seed);
+
     /* Already put the message in the right place, to make it easier to prepend
      * things when computing the hash over the message. */
     memcpy(sm + params->sig_bytes, m, mlen);
@@ -219,7 +378,7 @@ int xmssmt_core_sign(const xmss_params *params,
         set_ots_addr(ots_addr, idx_leaf);
 
         /* Get a seed for the WOTS keypair. */
-        get_seed(params, ots_seed, sk_seed, ots_addr);
+        get_seed_keyed(params, ots_seed, &seed_prf, ots_addr);
 	//printf("\nPub Seed from XMSS sign----------------------------\n");
 	//for(int i1=0; i1<params->n; i1++)
 	//	printf("%hhu ",pub_seed[i1]);
@@ -232,7 +391,14 @@ int xmssmt_core_sign(const xmss_params *params,
         sm += params->wots_sig_bytes;
 
         /* Compute the authentication path for the used WOTS leaf. */
-        treehash(params, root, sm, sk_seed, pub_seed, idx_leaf, ots_addr);
+        if (cache) {
+            nodes = subtree_cache_get(params, cache, &seed_prf, pub_seed,
+                                      i, idx, ots_addr);
+            subtree_auth_path(params, root, sm, nodes, idx_leaf);
+        }
+        else {
+            treehash(params, root, sm, &seed_prf, pub_seed, idx_leaf, ots_addr);
+        }
         sm += params->tree_height*params->n;
     }
 
@@ -1,6 +1,7 @@
 #ifndef XMSS_CORE_H
 #define XMSS_CORE_H
 
+#include <stdint.h>
 #include "params.h"
 
 /**
@@ -55,6 +56,45 @@ int xmssmt_core_sign(const xmss_params *params,
                      unsigned char *sm, unsigned long long *smlen,
                      const unsigned char *m, unsigned long long mlen);
 
+/* One built subtree: every node from the leaves up to the root, stored level
+ * by level, and the seeds it was built from. */
+typedef struct {
+    uint32_t layer;
+    unsigned long long tree;
+    int valid;
+    unsigned char *seeds;
+    unsigned char *nodes;
+} subtree_cache_entry;
+
+/* Direct-mapped cache of subtrees keyed by (layer, tree). Subtree (layer, tree)
+ * goes to entry (tree * d + layer) mod num_entries, so with at least d entries
+ * the current subtrees of all layers are cached at once. A miss builds the
+ * subtree and overwrites the entry. xmss_core_fast.c keeps the authentication
+ * paths in its BDS state instead, so there the cache stays empty. */
+typedef struct {
+    subtree_cache_entry *entries;
+    unsigned int num_entries;
+} subtree_cache;
+
+/*
+ * Allocates an empty subtree cache of num_entries entries.
+ */
+void subtree_cache_init(const xmss_params *params, subtree_cache *cache,
+                        unsigned int num_entries);
+
+void subtree_cache_free(subtree_cache *cache);
+
+/**
+ * As xmssmt_core_sign, but takes the roots and authentication paths from
+ * cache, building each subtree only the first time a signature touches it.
+ * Produces the same signature as xmssmt_core_sign.
+ */
+int xmssmt_core_sign_cached(const xmss_params *params,
+                            unsigned char *sk,
+                            unsigned char *sm, unsigned long long *smlen,
+                            const unsigned char *m, unsigned long long mlen,
+                            subtree_cache *cache);
+
 /**
  * Verifies a given message signature pair under a given public key.
  * Note that this assumes a pk without an OID, i.e. [root || PUB_SEED]
@@ -950,3 +950,34 @@ int xmssmt_core_sign(const xmss_params *params,
 
     return 0;
 }
+
+/*
+ * The BDS state in sk already keeps the authentication paths between
+ * signatures, so the fast variant needs no subtree cache: it stays empty.
+ */
+void subtree_cache_init(const xmss_params *params, subtree_cache *cache,
+                        unsigned int num_entries)
+{
+    (void)params;
+    (void)num_entries;
+
+    cache->entries = NULL;
+    cache->num_entries = 0;
+}
+
+void subtree_cache_free(subtree_cache *cache)
+{
+    cache->entries = NULL;
+    cache->num_entries = 0;
+}
+
+int xmssmt_core_sign_cached(const xmss_params *params,
+                            unsigned char *sk,
+                            unsigned char *sm, unsigned long long *smlen,
+                            const unsigned char *m, unsigned long long mlen,
+                            subtree_cache *cache)
+{
+    (void)cache;
+
+    return xmssmt_core_sign(params, sk, sm, smlen, m, mlen);
+}